@@ -0,0 +1,217 @@
+/*-----------------------------------------------------------------------------
+| File: gentraj.c [ANSI-C conforming source code]                             |
+| Description:                                                                |
+|       Generator of synthetic Stokes parameter trajectories, for the         |
+|       benchmarks of poincare (see bench/README.md and 'make bench'). The    |
+|       trajectories are written to stdout in the trajectory file format of   |
+|       poincare, and are fully determined by the parameters given on the     |
+|       command line, so that every run gives the very same file.             |
+|                                                                             |
+| Copyright (C) 1997-2025, Fredrik Jonsson, under Gnu General Public License  |
+| (GPL) v3. See the enclosed LICENSE for details.                             |
+|                                                                             |
+| Compile with:                                                               |
+|                                                                             |
+|        gcc -O2 -Wall -pedantic -ansi ./gentraj.c -o ./gentraj -lm           |
+|                                                                             |
+| Each trajectory runs along the horizon of the view given by --psi and      |
+| --phi (the great circle separating the visible and hidden halves of the    |
+| sphere, as seen by poincare with --rotatepsi and --rotatephi), while       |
+| oscillating across it, so that it crosses the horizon exactly the number   |
+| of times given by --crossings. Without crossings, the trajectories stay    |
+| entirely on the visible side of the sphere.                                |
+-----------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define VERSION_NUMBER "1.0"
+
+#ifndef PI
+#define PI (3.14159265358979323846)
+#endif
+
+#define SUCCESS 0  /* Return code for successful program termination */
+#define FAILURE 1  /* Return code for unsuccessful program termination */
+
+#define DEFAULT_NUM_POINTS (1000)       /* points per trajectory */
+#define DEFAULT_NUM_TRAJECTORIES (1)
+#define DEFAULT_NUM_CROSSINGS (4)       /* horizon crossings per trajectory */
+#define DEFAULT_TICK_DENSITY (0.0)      /* fraction of points with ticks */
+#define DEFAULT_LABEL_DENSITY (0.0)     /* fraction of points with labels */
+#define DEFAULT_ROT_PSI (-40.0)         /* degrees, as in poincare */
+#define DEFAULT_ROT_PHI (15.0)          /* degrees, as in poincare */
+#define DEFAULT_AMPLITUDE (20.0)        /* degrees off the horizon */
+#define DEFAULT_ARC (300.0)             /* degrees along the horizon */
+
+/*---------------------------------------------------------------------
+| The only global variable allowed is `progname`, which simply is the
+| string containing the name of the program, as it was invoked from the
+| command line.
+---------------------------------------------------------------------*/
+char *progname;
+
+typedef struct {
+   long numpoints,numtrajectories,numcrossings;
+   double tickdensity,labeldensity;
+   double rot_psi,rot_phi,amplitude,arc; /* all in degrees */
+} genparams;
+
+void showsomehelp(void) {
+   fprintf(stdout,"Usage: %s [options] > file.dat\n",progname);
+   fprintf(stdout,
+ "where [options] include:\n"
+ " -h, --help              Show this help-message and exit clean.\n"
+ " --points <n>            Points per trajectory. Default: 1000.\n"
+ " --trajectories <n>      Number of trajectories. Default: 1.\n"
+ " --crossings <n>         Horizon crossings per trajectory. Default: 4.\n"
+ " --tickdensity <d>       Fraction 0..1 of points with tick marks.\n"
+ "                         Default: 0.\n"
+ " --labeldensity <d>      Fraction 0..1 of points with labels. Default: 0.\n");
+   fprintf(stdout,
+ " --psi <val>, --phi <val> The view (degrees) whose horizon is crossed, as\n"
+ "                         given to poincare by --rotatepsi and --rotatephi.\n"
+ "                         Default: -40.0 and 15.0.\n"
+ " --amplitude <val>       Largest distance (degrees) of the trajectories\n"
+ "                         from the horizon. Default: 20.0.\n"
+ " --arc <val>             Extent (degrees) of each trajectory along the\n"
+ "                         horizon. Default: 300.0.\n");
+}
+
+void get_long_argument(char *optstr,char *argstr,long *v,long min) {
+   if ((argstr==NULL)||(sscanf(argstr,"%ld",v)!=1)||(*v<min)) {
+      fprintf(stderr,"%s: Error: Invalid argument of %s.\n",progname,optstr);
+      exit(FAILURE);
+   }
+}
+
+void get_double_argument(char *optstr,char *argstr,double *v) {
+   if ((argstr==NULL)||(sscanf(argstr,"%lf",v)!=1)) {
+      fprintf(stderr,"%s: Error: Invalid argument of %s.\n",progname,optstr);
+      exit(FAILURE);
+   }
+}
+
+genparams parse_command_line(int argc,char *argv[]) {
+   genparams p;
+   int k;
+
+   p.numpoints=DEFAULT_NUM_POINTS;
+   p.numtrajectories=DEFAULT_NUM_TRAJECTORIES;
+   p.numcrossings=DEFAULT_NUM_CROSSINGS;
+   p.tickdensity=DEFAULT_TICK_DENSITY;
+   p.labeldensity=DEFAULT_LABEL_DENSITY;
+   p.rot_psi=DEFAULT_ROT_PSI;
+   p.rot_phi=DEFAULT_ROT_PHI;
+   p.amplitude=DEFAULT_AMPLITUDE;
+   p.arc=DEFAULT_ARC;
+   for (k=1;k<argc;k++) {
+      if (!strcmp(argv[k],"-h")||!strcmp(argv[k],"--help")) {
+         showsomehelp();
+         exit(SUCCESS);
+      } else if (!strcmp(argv[k],"--points")) {
+         get_long_argument(argv[k],argv[k+1],&p.numpoints,2);
+         k++;
+      } else if (!strcmp(argv[k],"--trajectories")) {
+         get_long_argument(argv[k],argv[k+1],&p.numtrajectories,1);
+         k++;
+      } else if (!strcmp(argv[k],"--crossings")) {
+         get_long_argument(argv[k],argv[k+1],&p.numcrossings,0);
+         k++;
+      } else if (!strcmp(argv[k],"--tickdensity")) {
+         get_double_argument(argv[k],argv[k+1],&p.tickdensity);
+         k++;
+      } else if (!strcmp(argv[k],"--labeldensity")) {
+         get_double_argument(argv[k],argv[k+1],&p.labeldensity);
+         k++;
+      } else if (!strcmp(argv[k],"--psi")) {
+         get_double_argument(argv[k],argv[k+1],&p.rot_psi);
+         k++;
+      } else if (!strcmp(argv[k],"--phi")) {
+         get_double_argument(argv[k],argv[k+1],&p.rot_phi);
+         k++;
+      } else if (!strcmp(argv[k],"--amplitude")) {
+         get_double_argument(argv[k],argv[k+1],&p.amplitude);
+         k++;
+      } else if (!strcmp(argv[k],"--arc")) {
+         get_double_argument(argv[k],argv[k+1],&p.arc);
+         k++;
+      } else {
+         fprintf(stderr,"%s: Unknown option '%s'.\n",progname,argv[k]);
+         showsomehelp();
+         exit(FAILURE);
+      }
+   }
+   if ((p.tickdensity<0.0)||(p.tickdensity>1.0)
+         ||(p.labeldensity<0.0)||(p.labeldensity>1.0)) {
+      fprintf(stderr,"%s: Error: Densities must be within 0..1.\n",progname);
+      exit(FAILURE);
+   }
+   if (p.numcrossings>=p.numpoints) {
+      fprintf(stderr,"%s: Error: More crossings than points of the "
+         "trajectories.\n",progname);
+      exit(FAILURE);
+   }
+   return(p);
+}
+
+/*
+ * The marked() routine tells whether point No |k| (counting from zero) is
+ * to get a tick mark or label of the given |density|, spreading the marked
+ * points evenly over the trajectory.
+ */
+int marked(long k,double density) {
+   return(floor((k+1)*density)>floor(k*density));
+}
+
+/*-----------------------------------------------------------------------------
+| The trajectories are generated in the orthonormal basis (e0,e1,n) of the
+| view, with |n| pointing towards the viewer, being the rows of the view
+| transform of poincare. Point No |k| of trajectory No |j| is located at
+| the angle u=u0+t*arc along the horizon, with t=(k+1/2)/numpoints, and at
+| the angle amplitude*cos(pi*numcrossings*t) off the horizon, whose sign
+| changes exactly numcrossings times over the trajectory. The starting
+| angles |u0| of the trajectories are spread evenly around the horizon.
+-----------------------------------------------------------------------------*/
+void write_trajectories(genparams p) {
+   double e0[3],e1[3],n[3],s[3];
+   double cpsi,spsi,cphi,sphi,t,u,lat,amp,arc;
+   long j,k,numlabels=0;
+   int i;
+
+   cpsi=cos(p.rot_psi*PI/180);
+   spsi=sin(p.rot_psi*PI/180);
+   cphi=cos(p.rot_phi*PI/180);
+   sphi=sin(p.rot_phi*PI/180);
+   e0[0]=spsi;       e0[1]=cpsi;       e0[2]=0.0;
+   e1[0]=-cpsi*sphi; e1[1]=spsi*sphi;  e1[2]=cphi;
+   n[0]=cpsi*cphi;   n[1]=-spsi*cphi;  n[2]=sphi;
+   amp=p.amplitude*PI/180;
+   arc=p.arc*PI/180;
+   for (j=0;j<p.numtrajectories;j++) {
+      fprintf(stdout,"p\n");
+      for (k=0;k<p.numpoints;k++) {
+         t=(k+0.5)/p.numpoints;
+         u=2*PI*j/p.numtrajectories+t*arc;
+         lat=amp*((p.numcrossings>0)?cos(PI*p.numcrossings*t):1.0);
+         for (i=0;i<3;i++)
+            s[i]=cos(lat)*(cos(u)*e0[i]+sin(u)*e1[i])+sin(lat)*n[i];
+         fprintf(stdout,"%.6f %.6f %.6f",s[0],s[1],s[2]);
+         if (marked(k,p.tickdensity)) fprintf(stdout," t");
+         if (marked(k,p.labeldensity))
+            fprintf(stdout," l top \"$t_{%ld}$\"",++numlabels);
+         fprintf(stdout,"\n");
+      }
+      fprintf(stdout,"q\n");
+   }
+}
+
+int main(int argc,char *argv[]) {
+   genparams p;
+
+   progname=argv[0];
+   p=parse_command_line(argc,argv);
+   write_trajectories(p);
+   return(SUCCESS);
+}
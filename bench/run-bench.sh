@@ -0,0 +1,114 @@
+#!/bin/sh
+#
+# run-bench.sh: Benchmarks of poincare on synthetic trajectories
+#
+# Copyright (C) 1997-2025 under GPLv3, Fredrik Jonsson
+#
+# Usage: sh bench/run-bench.sh <total points> [<total points> ...]
+#
+# For each size of the sweep, a dataset is generated by bench/gentraj and
+# mapped by ./poincare --stats json, and one line of JSON is written to
+# stdout with the timings of the run, as reported by --stats:
+#
+#    parse_s, parse_points_per_s, parse_mb_per_s
+#        The scanning of the trajectory file (scan_trajectory_file), with
+#        the throughput in points and in megabytes of input per second.
+#    map_s, map_points_per_s, map_mb_per_s
+#        The projection, visibility split and writing of the trajectories
+#        (write_figure_overlay), with the throughput in points and in
+#        megabytes of MetaPost code per second.
+#    total_s, peak_memory_kb
+#        The whole run of poincare, and its peak memory.
+#    mpost_s
+#        The compilation of the MetaPost code by mpost, or null if mpost
+#        is not installed.
+#
+# The shape of the datasets is set by the environment variables
+# BENCH_TRAJECTORIES, BENCH_CROSSINGS, BENCH_TICKDENSITY and
+# BENCH_LABELDENSITY, and every size is run BENCH_REPEAT times.
+#
+POINCARE=${POINCARE:-./poincare}
+GENTRAJ=${GENTRAJ:-bench/gentraj}
+WORKDIR=${BENCH_WORKDIR:-bench/work}
+TRAJECTORIES=${BENCH_TRAJECTORIES:-10}
+CROSSINGS=${BENCH_CROSSINGS:-8}
+TICKDENSITY=${BENCH_TICKDENSITY:-0.01}
+LABELDENSITY=${BENCH_LABELDENSITY:-0.001}
+REPEAT=${BENCH_REPEAT:-3}
+
+if [ $# -eq 0 ]; then
+   echo "Usage: $0 <total points> [<total points> ...]" 1>&2
+   exit 1
+fi
+mkdir -p "$WORKDIR" || exit 1
+case $POINCARE in
+   /*) ;;
+   *) POINCARE=`pwd`/$POINCARE ;;
+esac
+if command -v mpost >/dev/null 2>&1; then HAVE_MPOST=1; else HAVE_MPOST=0; fi
+
+# field <name> <file>: value of the number |"name": value| of the stats
+field() {
+   tr -d '\n' < "$2" | sed -n "s/.*\"$1\": \([-+0-9.eE]*\).*/\1/p"
+}
+
+# phase <name> <file>: seconds of the phase |name| of the stats, or 0
+phase() {
+   v=`tr -d '\n' < "$2" | sed -n \
+      "s/.*\"name\": \"$1\", \"calls\": [0-9]*, \"seconds\": \([-+0-9.eE]*\).*/\1/p"`
+   echo ${v:-0}
+}
+
+for size in "$@"; do
+   points=`expr $size / $TRAJECTORIES`
+   [ $points -lt 2 ] && points=2
+   data="$WORKDIR/bench-$size.dat"
+   $GENTRAJ --points $points --trajectories $TRAJECTORIES \
+      --crossings $CROSSINGS --tickdensity $TICKDENSITY \
+      --labeldensity $LABELDENSITY > "$data" || exit 1
+   r=1
+   while [ $r -le $REPEAT ]; do
+      stats="$WORKDIR/bench-$size.json"
+      if [ $HAVE_MPOST -eq 1 ]; then
+         (cd "$WORKDIR" && $POINCARE --stats json \
+            --inputfile bench-$size.dat --outputfile bench-$size.mp \
+            --epsoutput bench-$size > /dev/null 2> bench-$size.json) || exit 1
+         mpost_s=`phase "system: mpost" "$stats"`
+      else
+         $POINCARE --stats json --inputfile "$data" \
+            --outputfile "$WORKDIR/bench-$size.mp" 2> "$stats" || exit 1
+         mpost_s=null
+      fi
+      awk -v size=$size -v repeat=$r -v trajectories=$TRAJECTORIES \
+         -v crossings=$CROSSINGS -v mpost_s=$mpost_s \
+         -v points=`field points "$stats"` \
+         -v bytes_read=`field bytes_read "$stats"` \
+         -v bytes_written=`field bytes_written "$stats"` \
+         -v hidden=`field hidden_segments "$stats"` \
+         -v visible=`field visible_segments "$stats"` \
+         -v parse_s=`phase scan_trajectory_file "$stats"` \
+         -v map_s=`phase write_figure_overlay "$stats"` \
+         -v total_s=`field total_seconds "$stats"` \
+         -v peak=`field peak_memory_kb "$stats"` \
+         'function rate(n,s) { return (s>0)?n/s:0 }
+         BEGIN {
+            printf("{\"size\": %d, \"repeat\": %d, \"trajectories\": %d, ",
+               size,repeat,trajectories);
+            printf("\"crossings\": %d, \"points\": %d, ",crossings,points);
+            printf("\"bytes_read\": %d, \"bytes_written\": %d, ",
+               bytes_read,bytes_written);
+            printf("\"hidden_segments\": %d, \"visible_segments\": %d, ",
+               hidden,visible);
+            printf("\"parse_s\": %.6f, \"parse_points_per_s\": %.0f, ",
+               parse_s,rate(points,parse_s));
+            printf("\"parse_mb_per_s\": %.3f, ",rate(bytes_read/1e6,parse_s));
+            printf("\"map_s\": %.6f, \"map_points_per_s\": %.0f, ",
+               map_s,rate(points,map_s));
+            printf("\"map_mb_per_s\": %.3f, ",rate(bytes_written/1e6,map_s));
+            printf("\"total_s\": %.6f, \"peak_memory_kb\": %s, ",
+               total_s,(peak=="")?"null":peak);
+            printf("\"mpost_s\": %s}\n",mpost_s);
+         }'
+      r=`expr $r + 1`
+   done
+done
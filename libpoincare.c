@@ -0,0 +1,8619 @@
+/*-----------------------------------------------------------------------------
+| File: libpoincare.c [ANSI-C conforming source code]                         |
+| Description:                                                                |
+|       The routines of libpoincare, as declared in libpoincare.h, doing all  |
+|       the work of the poincare program (see poincare.c for the revision     |
+|       history of the program and the library), followed by the routines     |
+|       of the poincarefigure interface of poincare.h, for drawing            |
+|       trajectories kept in the memory of the calling program.               |
+|                                                                             |
+| Copyright (C) 1997-2025, Fredrik Jonsson, under Gnu General Public License  |
+| (GPL) v3. See the enclosed LICENSE for details.                             |
+-----------------------------------------------------------------------------*/
+
+/*-----------------------------------------------------------------------------
+| On POSIX systems, some facilities beyond ISO C90 are used, such as memory
+| mapping of input files, threads for the mapping of trajectories, and the
+| clocks and resource usage reported by --stats. The library still compiles
+| in strict ANSI mode, since these are requested through _POSIX_C_SOURCE
+| prior to the inclusion of any system headers, here rather than in any
+| header, so as to leave the programs including poincare.h as they are. On
+| other systems, or if the library is compiled with -DNO_POSIX, it falls
+| back on plain ISO C90 facilities.
+-----------------------------------------------------------------------------*/
+#if !defined(NO_POSIX) && (defined(__unix__) || defined(__unix) || \
+   (defined(__APPLE__) && defined(__MACH__)))
+#define _POSIX_C_SOURCE 200809L
+#define POSIX_SYSTEM
+#endif
+
+#include "libpoincare.h"
+#ifdef POSIX_SYSTEM
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <pthread.h>
+#endif
+
+char *progname="poincare"; /* until set by parse_command_line() */
+
+int isnan(double x);
+
+/*-----------------------------------------------------------------------------
+| The |trajectoryworker| struct keeps the share of work of one of the threads
+| of the --threads option, namely to map the trajectories |first..last| of
+| the store |ts| into the buffers |hidden| and |visible|, both kept in
+| memory, for the hidden and visible layers of the figure respectively.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   pmap *map;
+   trajectorystore *ts;
+   long first,last;
+   mpbuffer hidden,visible;
+} trajectoryworker;
+
+/*-----------------------------------------------------------------------------
+| The |frameworker| struct keeps the work of one of the threads of the
+| rotation sweep (--sweeppsi, --sweepphi), namely to write the frame given by
+| the parameters |map| to the buffer |text|, kept in memory, with the shaded
+| sphere taken from |sphere| and the trajectories from |view|, which shares
+| the Stokes parameters of the trajectory store while having screen
+| coordinates of its own, as set up by |share_trajectory_store()|.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   pmap map;
+   trajectorystore view;
+   mpbuffer *sphere;
+   mpbuffer text;
+} frameworker;
+
+/*----------------------------------------------------------------------------
+| The |svector| routine allocates a vector of short integer precision,
+| with vector index ranging from |nl| to |nh|.
+----------------------------------------------------------------------------*/
+short *svector(long nl, long nh) {
+   short *v;
+   v=(short *)malloc((size_t) ((nh-nl+2)*sizeof(short)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in svector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+/*----------------------------------------------------------------------------
+| The |ivector| routine allocates a vector of integer precision,
+| with vector index ranging from |nl| to |nh|.
+----------------------------------------------------------------------------*/
+int *ivector(long nl, long nh) {
+   int *v;
+   v=(int *)malloc((size_t) ((nh-nl+2)*sizeof(int)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in ivector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+/*----------------------------------------------------------------------------
+| The |lvector| routine allocates a vector of long integer precision,
+| with vector index ranging from |nl| to |nh|.
+----------------------------------------------------------------------------*/
+long *lvector(long nl, long nh) {
+   long *v;
+   v=(long *)malloc((size_t) ((nh-nl+2)*sizeof(long)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in lvector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+/*----------------------------------------------------------------------------
+| The |free_svector| routine release the memory occupied by the
+| short integer vector |v[nl..nh]|.
+----------------------------------------------------------------------------*/
+void free_svector(short *v, long nl, long nh) {
+   free((char*) (v+nl-1));
+}
+
+/*----------------------------------------------------------------------------
+| The |free_ivector| routine release the memory occupied by the
+| integer vector |v[nl..nh]|.
+----------------------------------------------------------------------------*/
+void free_ivector(int *v, long nl, long nh) {
+   free((char*) (v+nl-1));
+}
+
+/*----------------------------------------------------------------------------
+| The |free_lvector| routine release the memory occupied by the
+| long integer vector |v[nl..nh]|.
+----------------------------------------------------------------------------*/
+void free_lvector(long *v, long nl, long nh) {
+   free((char*) (v+nl-1));
+}
+
+/*----------------------------------------------------------------------------
+| The |free_dvector| routine release the memory occupied by the
+| real-valued vector |v[nl..nh]|.
+----------------------------------------------------------------------------*/
+void free_dvector(double *v, long nl, long nh) {
+   free((char*) (v+nl-1));
+}
+
+/*----------------------------------------------------------------------------
+| The |dvector| routine allocates a real-valued vector of double precision,
+| with vector index ranging from |nl| to |nh|.
+----------------------------------------------------------------------------*/
+double *dvector(long nl, long nh) {
+   double *v;
+   v=(double *)malloc((size_t) ((nh-nl+2)*sizeof(double)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in dvector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+/*----------------------------------------------------------------------------
+| The |resize_dvector|, |resize_svector|, |resize_ivector| and |resize_lvector|
+| routines change the size of a vector previously allocated by |dvector|,
+| |svector|, |ivector| or |lvector|, respectively, to the index range |nl| to
+| |nh|, keeping the contents of the elements common to the old and new index
+| ranges.
+----------------------------------------------------------------------------*/
+double *resize_dvector(double *v, long nl, long nh) {
+   v=(double *)realloc((char*) (v+nl-1),(size_t) ((nh-nl+2)*sizeof(double)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in resize_dvector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+short *resize_svector(short *v, long nl, long nh) {
+   v=(short *)realloc((char*) (v+nl-1),(size_t) ((nh-nl+2)*sizeof(short)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in resize_svector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+int *resize_ivector(int *v, long nl, long nh) {
+   v=(int *)realloc((char*) (v+nl-1),(size_t) ((nh-nl+2)*sizeof(int)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in resize_ivector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+long *resize_lvector(long *v, long nl, long nh) {
+   v=(long *)realloc((char*) (v+nl-1),(size_t) ((nh-nl+2)*sizeof(long)));
+   if (!v) {
+      fprintf(stderr,"Error: Allocation failure in resize_lvector()\n");
+      exit(1);
+   }
+   return v-nl+1;
+}
+
+/*-------------------------------------------------------------------------
+| The scan_for_boundingbox(infilename,llx,lly,urx,ury) routine takes the
+| name of a regular ASCII text file (infilename) containing Encapsulated
+| PostScript (EPS) as input, and returns the bounding box of the figure,
+| in terms of the corner coordinates given by llx (lower left x), lly
+| (lower left y), urx (upper right x), and ury (upper right y).
+| Typical usage (as a sample program for extraction of bounding box, similar
+| to the UNIX standard program psbb):
+|
+|     #include <stdlib.h>
+|     #include <stdio.h>
+|     #include <string.h>
+|
+|     extern char *optarg;
+|     char *progname;
+|
+|     void scan_for_boundingbox(char infilename[256],
+|        long int *llx,long int *lly,long int *urx,long int *ury) {
+|        ...
+|     }
+|
+|     int main(int argc,char *argv[]) {
+|        char infilename[256];
+|        int no_arg;
+|        long int llx,lly,urx,ury;
+|
+|        progname=argv[0];
+|        no_arg=argc;
+|        if (argc<2) {
+|           fprintf(stderr,"%s: Error! Please specify input (EPS) filename.\n",
+|              progname);
+|           fprintf(stderr,"Usage: %s <filename>\n",progname);
+|           exit(FAILURE);
+|        }
+|        --argc;
+|        strcpy(infilename,argv[no_arg-argc]);
+|        scan_for_boundingbox(infilename,&llx,&lly,&urx,&ury);
+|        fprintf(stdout,"%ld %ld %ld %ld\n",llx,lly,urx,ury);
+|        exit(0);
+|     }
+|
+-------------------------------------------------------------------------*/
+void scan_for_boundingbox(char infilename[256],
+   long int *llx,long int *lly,long int *urx,long int *ury) {
+   short int done;
+   char tmpstr[256];
+   int tmpch;
+   FILE *infile;
+
+   if ((infile=fopen(infilename,"r"))==NULL) {
+      fprintf(stderr,"%s: Error! Could not open file %s for reading.\n",
+         progname,infilename);
+      exit(FAILURE);
+   }
+   fseek(infile,0L,SEEK_SET);
+   done=0;
+   while (((tmpch=getc(infile))!=EOF)&&(!done)) {
+      ungetc(tmpch,infile);
+      if (fscanf(infile,"%s",tmpstr)==0) {
+         exit(FAILURE);
+      }
+      if (!strcmp(tmpstr,"%%BoundingBox:")) {
+         done=1;
+         if (fscanf(infile,"%ld",llx)==0) {
+            fprintf(stderr,"Failed scanning llx in bounding box!\n");
+            exit(FAILURE);
+         }
+         if (fscanf(infile,"%ld",lly)==0) {
+            fprintf(stderr,"Failed scanning lly in bounding box!\n");
+            exit(FAILURE);
+         }
+         if (fscanf(infile,"%ld",urx)==0) {
+            fprintf(stderr,"Failed scanning urx in bounding box!\n");
+            exit(FAILURE);
+         }
+         if (fscanf(infile,"%ld",ury)==0) {
+            fprintf(stderr,"Failed scanning ury in bounding box!\n");
+            exit(FAILURE);
+         }
+      }
+   }
+   if (tmpch==EOF) {
+      fprintf(stderr,"%s: Error! End of file reached without ",progname);
+      fprintf(stderr,"finding any %%%%BoundingBox statement!\n");
+      fprintf(stderr,"%s: (Does %s really contain ",progname,infilename);
+      fprintf(stderr,"Encapsulated PostScript?)\n");
+      exit(FAILURE);
+   }
+} /* end of scan_for_boundingbox() */
+
+double **matrix(long nrl, long nrh, long ncl, long nch) {
+   long i, j, nrow=nrh-nrl+1,ncol=nch-ncl+1;
+   double **m;
+   m=(double **) malloc((size_t)((nrow+1)*sizeof(double*)));
+   if (!m) {
+      printf("%s: Allocation failure 1 in matrix()\n",progname);
+      exit(FAILURE);
+   }
+   m += 1;
+   m -= nrl;
+   m[nrl]=(double *) malloc((size_t)((nrow*ncol+1)*sizeof(double)));
+   if (!m[nrl]) {
+      printf("%s: Allocation failure 2 in matrix()\n",progname);
+      exit(FAILURE);
+   }
+   m[nrl] += 1;
+   m[nrl] -= ncl;
+   for(i=nrl+1;i<=nrh;i++) m[i]=m[i-1]+ncol;
+   for(i=nrl;i<=nrh;i++) for(j=ncl;j<=nch;j++) m[i][j]=0.0;
+   return m;
+}
+
+void free_matrix(double **m, long nrl, long nrh, long ncl, long nch) {
+   free((char*) (m[nrl]+ncl-1));
+   free((char*) (m+nrl-1));
+}
+
+char **cmatrix(long nrl, long nrh, long ncl, long nch) {
+   long i, j, nrow=nrh-nrl+1,ncol=nch-ncl+1;
+   char **m;
+   m=(char **) malloc((size_t)((nrow+1)*sizeof(char*)));
+   if (!m) {
+      printf("%s: Allocation failure 1 in cmatrix()\n",progname);
+      exit(1);
+   }
+   m += 1;
+   m -= nrl;
+   m[nrl]=(char *) malloc((size_t)((nrow*ncol+1)*sizeof(char)));
+   if (!m[nrl]) {
+      printf("%s: Allocation failure 2 in cmatrix()\n",progname);
+      exit(1);
+   }
+   m[nrl] += 1;
+   m[nrl] -= ncl;
+   for(i=nrl+1;i<=nrh;i++) m[i]=m[i-1]+ncol;
+   for(i=nrl;i<=nrh;i++) for(j=ncl;j<=nch;j++) m[i][j]=0.0;
+   return m;
+}
+
+void free_cmatrix(char **m, long nrl, long nrh, long ncl, long nch) {
+   free((char*) (m[nrl]+ncl-1));
+   free((char*) (m+nrl-1));
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the buffered output of MetaPost code. All MetaPost code is
+| written through an |mpbuffer|, which collects the text in a large buffer
+| and hands it over to its file (or sink) in blocks of MP_BUFFER_SIZE
+| characters, or, if neither is attached, keeps all of it in memory. The mp_printf() routine
+| is a replacement for fprintf(), understanding the subset of conversions
+| used in this program, while the numerical work is done by dedicated
+| routines, of which mp_fixed() formats reals with a fixed number of decimals
+| without any help from the C library. The output is character by character
+| identical to what fprintf() gives.
+-----------------------------------------------------------------------------*/
+void initialize_mpbuffer(mpbuffer *out,FILE *fileptr) {
+   (*out).fileptr=fileptr;
+   (*out).sink=NULL;
+   (*out).sinkdata=NULL;
+   (*out).bufsize=MP_BUFFER_SIZE;
+   (*out).len=0;
+   (*out).format=METAPOST_FORMAT;
+   (*out).numwritten=0;
+   (*out).llx=(*out).lly=HUGE_VAL;
+   (*out).urx=(*out).ury=-HUGE_VAL;
+   if (((*out).buf=(char *)malloc((*out).bufsize))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in initialize_mpbuffer()\n",
+         progname);
+      exit(FAILURE);
+   }
+}
+
+/*
+ * The flush_mpbuffer() routine writes the buffered text to the file of the
+ * buffer, if any, and flushes the file, or hands the text over to the sink
+ * of the buffer, if any. For a buffer with neither, the routine does
+ * nothing, since the text then is to be kept in memory.
+ */
+void flush_mpbuffer(mpbuffer *out) {
+   if ((*out).sink!=NULL) {
+      if ((*out).len>0) (*(*out).sink)((*out).buf,(*out).len,(*out).sinkdata);
+      (*out).numwritten+=(unsigned long)(*out).len;
+      (*out).len=0;
+      return;
+   }
+   if ((*out).fileptr==NULL) return;
+   if ((*out).len>0) {
+      if (fwrite((*out).buf,1,(*out).len,(*out).fileptr)!=(*out).len) {
+         fprintf(stderr,"%s: Error: Failed writing MetaPost code.\n",
+            progname);
+         exit(FAILURE);
+      }
+      (*out).numwritten+=(unsigned long)(*out).len;
+      (*out).len=0;
+   }
+   fflush((*out).fileptr);
+}
+
+void free_mpbuffer(mpbuffer *out) {
+   flush_mpbuffer(out);
+   free((*out).buf);
+   (*out).buf=NULL;
+   (*out).len=(*out).bufsize=0;
+}
+
+/*
+ * The reset_mpbuffer() routine empties the buffer, discarding any text not
+ * yet handed over to its file, as well as its bounding box, while keeping
+ * the allocated memory for reuse.
+ */
+void reset_mpbuffer(mpbuffer *out) {
+   (*out).len=0;
+   (*out).llx=(*out).lly=HUGE_VAL;
+   (*out).urx=(*out).ury=-HUGE_VAL;
+}
+
+/*
+ * The reserve_mpbuffer() routine makes room for at least |n| more characters
+ * in the buffer, by handing over the buffered text to the file or sink, or,
+ * for a buffer without either, by growing the buffer.
+ */
+void reserve_mpbuffer(mpbuffer *out,size_t n) {
+   if ((*out).len+n<=(*out).bufsize) return;
+   if (((*out).fileptr!=NULL)||((*out).sink!=NULL)) {
+      flush_mpbuffer(out);
+      if (n<=(*out).bufsize) return;
+   }
+   while ((*out).len+n>(*out).bufsize) (*out).bufsize*=2;
+   if (((*out).buf=(char *)realloc((*out).buf,(*out).bufsize))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in reserve_mpbuffer()\n",
+         progname);
+      exit(FAILURE);
+   }
+}
+
+void mp_write(mpbuffer *out,const char *str,size_t n) {
+   reserve_mpbuffer(out,n);
+   memcpy((*out).buf+(*out).len,str,n);
+   (*out).len+=n;
+}
+
+void mp_putc(mpbuffer *out,int ch) {
+   if ((*out).len>=(*out).bufsize) reserve_mpbuffer(out,1);
+   (*out).buf[(*out).len++]=(char)ch;
+}
+
+void mp_puts(mpbuffer *out,const char *str) {
+   mp_write(out,str,strlen(str));
+}
+
+/*
+ * The mp_long() routine writes the integer |v| in decimal notation, as
+ * fprintf() does with the %ld conversion.
+ */
+void mp_long(mpbuffer *out,long v) {
+   char digits[3*sizeof(long)+2];
+   unsigned long u;
+   int k=(int)sizeof(digits);
+   u=((v<0)?(0UL-(unsigned long)v):(unsigned long)v);
+   do {
+      digits[--k]=(char)('0'+(int)(u%10));
+      u/=10;
+   } while (u>0);
+   if (v<0) digits[--k]='-';
+   mp_write(out,digits+k,sizeof(digits)-(size_t)k);
+}
+
+/*-----------------------------------------------------------------------------
+| The mp_fixed() routine writes the real number |x| with |prec| decimals, as
+| fprintf() does with the %1.<prec>f conversion. Since fprintf() rounds the
+| exact binary value of |x|, with ties to even, so must we; the product
+| |x*10^prec| is for this purpose computed exactly, as the sum p+e of its
+| rounded value |p| and the rounding error |e|, using the splitting of
+| Dekker. As long as |p| is below MP_FIXED_LIMIT, all other operations are
+| then exact, and the rounding decision is taken from the exact fraction.
+| Any other numbers, as well as infinities and NaNs, are handed over to
+| sprintf() instead.
+-----------------------------------------------------------------------------*/
+void mp_fixed(mpbuffer *out,double x,int prec) {
+   static const double pow10[7]={1.0,10.0,100.0,1000.0,1.0e4,1.0e5,1.0e6};
+   static const double negzero=-0.0;
+   char digits[512];
+   double a,p,e,t,f,q,c,ah,al,bh,bl;
+   int k,n;
+
+   if ((prec<0)||(prec>6)||(!(fabs(x)<MP_FIXED_LIMIT))
+         ||((p=fabs(x)*pow10[prec])>=MP_FIXED_LIMIT)) {
+      sprintf(digits,"%.*f",prec,x);
+      mp_puts(out,digits);
+      return;
+   }
+   a=fabs(x);
+   c=134217729.0*a; /* Dekker splitting of a and 10^prec into halves */
+   ah=c-(c-a);
+   al=a-ah;
+   c=134217729.0*pow10[prec];
+   bh=c-(c-pow10[prec]);
+   bl=pow10[prec]-bh;
+   e=((ah*bh-p)+ah*bl+al*bh)+al*bl; /* such that a*10^prec == p+e exactly */
+   f=floor(p);
+   t=(p-f)-0.5;
+   if ((t>0.0)||((t==0.0)&&((e>0.0)||((e==0.0)&&(fmod(f,2.0)!=0.0)))))
+      f+=1.0;
+   k=(int)sizeof(digits);
+   n=0;
+   do { /* extract the digits of the rounded integer f, last digit first */
+      q=floor(f/10.0);
+      digits[--k]=(char)('0'+(int)(f-10.0*q));
+      f=q;
+      if (++n==prec) digits[--k]='.';
+   } while ((f>0.0)||(n<=prec));
+   if ((x<0.0)||((x==0.0)&&(memcmp(&x,&negzero,sizeof(double))==0)))
+      digits[--k]='-';
+   mp_write(out,digits+k,sizeof(digits)-(size_t)k);
+}
+
+/*-----------------------------------------------------------------------------
+| The mp_printf() routine writes formatted text to the buffer |out|, as
+| fprintf() does. Only the conversions used in this program are understood,
+| namely %%, %c, %s, %d, %ld, %f and %<w>.<p>f; any field width is assumed
+| not to exceed the length of the converted text.
+-----------------------------------------------------------------------------*/
+void mp_printf(mpbuffer *out,const char *format,...) {
+   va_list ap;
+   const char *p,*q;
+   int prec;
+
+   va_start(ap,format);
+   for (p=format;*p!='\0';p++) {
+      if (*p!='%') { /* copy plain text up to next conversion in one go */
+         for (q=p;(*q!='\0')&&(*q!='%');q++);
+         mp_write(out,p,(size_t)(q-p));
+         p=q-1;
+         continue;
+      }
+      p++;
+      while (isdigit((int)((unsigned char)(*p)))) p++; /* skip field width */
+      prec=6;
+      if (*p=='.') {
+         prec=0;
+         for (p++;isdigit((int)((unsigned char)(*p)));p++)
+            prec=10*prec+(*p-'0');
+      }
+      if (*p=='%') {
+         mp_putc(out,'%');
+      } else if (*p=='c') {
+         mp_putc(out,va_arg(ap,int));
+      } else if (*p=='s') {
+         mp_puts(out,va_arg(ap,char *));
+      } else if (*p=='d') {
+         mp_long(out,(long)va_arg(ap,int));
+      } else if ((*p=='l')&&(*(p+1)=='d')) {
+         mp_long(out,va_arg(ap,long));
+         p++;
+      } else if (*p=='f') {
+         mp_fixed(out,va_arg(ap,double),prec);
+      } else {
+         fprintf(stderr,"%s: Error: Unsupported conversion in mp_printf() "
+            "of format \"%s\".\n",progname,format);
+         exit(FAILURE);
+      }
+   }
+   va_end(ap);
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the native vector output, as selected by the --format option.
+| Instead of MetaPost code, the buffer then collects the body of an SVG
+| document or of a PDF content stream, in PostScript points (bp) relative to
+| the centre of the sphere, while keeping track of the bounding box
+| |llx..urx|, |lly..ury| of everything drawn. Once the figure is complete,
+| the body is wrapped into a complete file by |write_vector_figure()|. Since
+| the y-axis of SVG points downwards, all y-coordinates are negated in SVG.
+-----------------------------------------------------------------------------*/
+void vec_extend_bbox(mpbuffer *out,double x,double y) {
+   if (x<(*out).llx) (*out).llx=x;
+   if (y<(*out).lly) (*out).lly=y;
+   if (x>(*out).urx) (*out).urx=x;
+   if (y>(*out).ury) (*out).ury=y;
+}
+
+void vec_point(mpbuffer *out,double x,double y) {
+   vec_extend_bbox(out,x,y);
+   mp_fixed(out,x,3);
+   mp_putc(out,' ');
+   mp_fixed(out,((*out).format==SVG_FORMAT)?0.0-y:y,3);
+   mp_putc(out,' ');
+}
+
+void vec_moveto(mpbuffer *out,double x,double y) {
+   if ((*out).format==SVG_FORMAT) mp_putc(out,'M');
+   vec_point(out,x,y);
+   if ((*out).format==PDF_FORMAT) mp_puts(out,"m\n");
+}
+
+void vec_lineto(mpbuffer *out,double x,double y) {
+   if ((*out).format==SVG_FORMAT) mp_putc(out,'L');
+   vec_point(out,x,y);
+   if ((*out).format==PDF_FORMAT) mp_puts(out,"l\n");
+}
+
+void vec_curveto(mpbuffer *out,double x1,double y1,double x2,double y2,
+      double x3,double y3) {
+   if ((*out).format==SVG_FORMAT) mp_putc(out,'C');
+   vec_point(out,x1,y1);
+   vec_point(out,x2,y2);
+   vec_point(out,x3,y3);
+   if ((*out).format==PDF_FORMAT) mp_puts(out,"c\n");
+}
+
+void vec_closepath(mpbuffer *out) {
+   mp_puts(out,((*out).format==SVG_FORMAT)?"Z":"h\n");
+}
+
+/*
+ * The vec_begin_path() and vec_end_path() routines enclose the construction
+ * of a path, to be stroked with the gray tone |gray| ('0.0' <=> 'black';
+ * '1.0' <=> 'white') and line width |width| (bp), dashed evenly if |dashed|
+ * is set, or, if |fill| is set, to be filled with the gray tone instead.
+ */
+void vec_begin_path(mpbuffer *out,double gray,double width,short dashed,
+      short fill) {
+   if ((*out).format==SVG_FORMAT) {
+      mp_puts(out,"<path d=\"");
+   } else if (fill) {
+      mp_printf(out,"q %1.4f g\n",gray);
+   } else {
+      mp_printf(out,"q %1.3f w %1.4f G%s\n",width,gray,
+         (dashed)?" [3 3] 0 d":"");
+   }
+}
+
+void vec_end_path(mpbuffer *out,double gray,double width,short dashed,
+      short fill) {
+   if ((*out).format==PDF_FORMAT) {
+      mp_puts(out,(fill)?"f Q\n":"S Q\n");
+   } else if (fill) {
+      mp_printf(out,"\" fill=\"rgb(%1.2f%%,%1.2f%%,%1.2f%%)\"/>\n",
+         100.0*gray,100.0*gray,100.0*gray);
+   } else {
+      mp_printf(out,"\" fill=\"none\" stroke=\"rgb(%1.2f%%,%1.2f%%,%1.2f%%)\""
+         " stroke-width=\"%1.3f\"%s/>\n",100.0*gray,100.0*gray,100.0*gray,
+         width,(dashed)?" stroke-dasharray=\"3 3\"":"");
+   }
+}
+
+/*
+ * The vec_path() routine constructs the path through the points |x[1..n]|,
+ * |y[1..n]|, closed if |closed| is set. If |smooth| is set, the points are
+ * connected by the cubic Bezier segments of the Catmull-Rom spline through
+ * them, as the counterpart of the '..' connections of MetaPost; otherwise
+ * by straight lines.
+ */
+void vec_path(mpbuffer *out,double *x,double *y,long n,short closed,
+      short smooth) {
+   long i,i0,i2,i3;
+   vec_moveto(out,x[1],y[1]);
+   for (i=1;i<((closed)?n+1:n);i++) {
+      i2=((i<n)?i+1:1);
+      if (smooth) {
+         i0=((i>1)?i-1:((closed)?n:1));
+         i3=((i2<n)?i2+1:((closed)?1:n));
+         vec_curveto(out,x[i]+(x[i2]-x[i0])/6.0,y[i]+(y[i2]-y[i0])/6.0,
+            x[i2]-(x[i3]-x[i])/6.0,y[i2]-(y[i3]-y[i])/6.0,x[i2],y[i2]);
+      } else {
+         vec_lineto(out,x[i2],y[i2]);
+      }
+   }
+   if (closed) vec_closepath(out);
+}
+
+void vec_stroke(mpbuffer *out,double *x,double *y,long n,short smooth,
+      double gray,double width,short dashed) {
+   vec_begin_path(out,gray,width,dashed,0);
+   vec_path(out,x,y,n,0,smooth);
+   vec_end_path(out,gray,width,dashed,0);
+}
+
+void vec_fill(mpbuffer *out,double *x,double *y,long n,short smooth,
+      double gray) {
+   vec_begin_path(out,gray,0.0,0,1);
+   vec_path(out,x,y,n,1,smooth);
+   vec_end_path(out,gray,0.0,0,1);
+}
+
+/*
+ * The vec_circle() routine fills the circle of radius |r| around the origin,
+ * made up of four Bezier arcs.
+ */
+void vec_circle(mpbuffer *out,double r,double gray) {
+   double k=0.5522847498*r;
+   vec_begin_path(out,gray,0.0,0,1);
+   vec_moveto(out,r,0.0);
+   vec_curveto(out,r,k,k,r,0.0,r);
+   vec_curveto(out,-k,r,-r,k,-r,0.0);
+   vec_curveto(out,-r,-k,-k,-r,0.0,-r);
+   vec_curveto(out,k,-r,r,-k,r,0.0);
+   vec_closepath(out);
+   vec_end_path(out,gray,0.0,0,1);
+}
+
+/*
+ * The vec_arrowhead() routine fills an arrow head with its tip at (xt,yt),
+ * pointing in the direction from (xf,yf) towards the tip, of the length
+ * ARROWHEAD_LENGTH and with the angle |angle| (degrees) between its sides,
+ * as MetaPost's drawarrow does with |ahlength| and |ahangle|.
+ */
+void vec_arrowhead(mpbuffer *out,double xt,double yt,double xf,double yf,
+      double angle,double gray) {
+   double x[4],y[4],ux,uy,len,ca,sa;
+   ux=xt-xf;
+   uy=yt-yf;
+   if ((len=sqrt(ux*ux+uy*uy))<=0.0) return;
+   ux=ARROWHEAD_LENGTH*ux/len;
+   uy=ARROWHEAD_LENGTH*uy/len;
+   ca=cos(0.5*angle*(PI/180));
+   sa=sin(0.5*angle*(PI/180));
+   x[1]=xt;
+   y[1]=yt;
+   x[2]=xt-(ca*ux-sa*uy);
+   y[2]=yt-(sa*ux+ca*uy);
+   x[3]=xt-(ca*ux+sa*uy);
+   y[3]=yt-(ca*uy-sa*ux);
+   vec_fill(out,x,y,3,0,gray);
+}
+
+/*-----------------------------------------------------------------------------
+| In the native vector output, labels are set without TeX, as plain text in a
+| Times font (italic for labels in math mode), as read off the TeX source in
+| a simple way: the next_label_run() routine scans the label |str| from
+| |str[*pos]| for the next run of text, copied to |run| (of at most |maxlen|
+| characters), with |*script| set to 0 for ordinary text, to 1 for a
+| subscript ('_') and to 2 for a superscript ('^'), either of a single
+| character or of a {group}. The characters '$', '\', '{' and '}' are
+| dropped. The number of characters of the run is returned.
+-----------------------------------------------------------------------------*/
+int next_label_run(const char *str,int *pos,char *run,int maxlen,
+      int *script) {
+   int ch,n=0;
+   short group=0;
+
+   *script=0;
+   if ((str[*pos]=='_')||(str[*pos]=='^')) {
+      *script=((str[*pos]=='_')?1:2);
+      (*pos)++;
+      if (str[*pos]=='{') {
+         group=1;
+         (*pos)++;
+      }
+   }
+   while ((ch=str[*pos])!='\0') {
+      if ((group)&&(ch=='}')) {
+         (*pos)++;
+         break;
+      }
+      if ((!group)&&(((*script!=0)&&(n>0))||(ch=='_')||(ch=='^'))) break;
+      (*pos)++;
+      if ((ch=='$')||(ch=='\\')||(ch=='{')||(ch=='}')) continue;
+      if (n<maxlen) run[n++]=(char)ch;
+   }
+   run[n]='\0';
+   return n;
+}
+
+/*
+ * The label_position() routine translates the MetaPost suffix |str| of a
+ * label (as in 'label.urt') into the corresponding label position flag.
+ */
+short label_position(const char *str) {
+   if (!strcmp(str,"top")) return TOPLABEL;
+   if (!strcmp(str,"ulft")) return UPPERLEFTLABEL;
+   if (!strcmp(str,"lft")) return LEFTLABEL;
+   if (!strcmp(str,"llft")) return LOWERLEFTLABEL;
+   if (!strcmp(str,"bot")) return BOTTOMLABEL;
+   if ((!strcmp(str,"lrt"))||(!strcmp(str,"lrgt"))) return LOWERRIGHTLABEL;
+   if ((!strcmp(str,"rt"))||(!strcmp(str,"rgt"))) return RIGHTLABEL;
+   if ((!strcmp(str,"urt"))||(!strcmp(str,"urgt"))) return UPPERRIGHTLABEL;
+   return NOLABEL;
+}
+
+/*
+ * The vec_label() routine sets the label |text| at the point (x,y), placed
+ * as MetaPost does for the label position |labelpos|, at the distance
+ * LABEL_OFFSET from the point. Since no font metrics are at hand, the width
+ * of the text is estimated as half the font size per character.
+ */
+void vec_label(mpbuffer *out,const char *text,short math,double x,double y,
+      short labelpos) {
+   char run[MAX_LABEL_TEXTLENGTH+1];
+   int pos,n,j,script;
+   double w=0.0,h=0.7*LABEL_FONTSIZE,bx,by,size,rise,lastrise=0.0;
+
+   for (pos=0;text[pos]!='\0';) {
+      n=next_label_run(text,&pos,run,MAX_LABEL_TEXTLENGTH,&script);
+      w+=0.5*n*((script)?LABEL_SCRIPTSIZE:LABEL_FONTSIZE);
+   }
+   if ((labelpos==UPPERLEFTLABEL)||(labelpos==LEFTLABEL)
+         ||(labelpos==LOWERLEFTLABEL)) {
+      bx=x-LABEL_OFFSET-w;
+   } else if ((labelpos==UPPERRIGHTLABEL)||(labelpos==RIGHTLABEL)
+         ||(labelpos==LOWERRIGHTLABEL)) {
+      bx=x+LABEL_OFFSET;
+   } else {
+      bx=x-0.5*w;
+   }
+   if ((labelpos==TOPLABEL)||(labelpos==UPPERLEFTLABEL)
+         ||(labelpos==UPPERRIGHTLABEL)) {
+      by=y+LABEL_OFFSET;
+   } else if ((labelpos==BOTTOMLABEL)||(labelpos==LOWERLEFTLABEL)
+         ||(labelpos==LOWERRIGHTLABEL)) {
+      by=y-LABEL_OFFSET-h;
+   } else {
+      by=y-0.5*h;
+   }
+   vec_extend_bbox(out,bx,by-0.3*LABEL_FONTSIZE);
+   vec_extend_bbox(out,bx+w,by+LABEL_FONTSIZE);
+   if ((*out).format==SVG_FORMAT) {
+      mp_printf(out,"<text x=\"%1.3f\" y=\"%1.3f\" font-family=\"Times,serif\""
+         " font-size=\"%1.1f\"%s>",bx,0.0-by,LABEL_FONTSIZE,
+         (math)?" font-style=\"italic\"":"");
+   } else {
+      mp_printf(out,"BT %1.3f %1.3f Td\n",bx,by);
+   }
+   for (pos=0;text[pos]!='\0';) {
+      if ((n=next_label_run(text,&pos,run,MAX_LABEL_TEXTLENGTH,&script))==0)
+         continue;
+      size=((script)?LABEL_SCRIPTSIZE:LABEL_FONTSIZE);
+      rise=((script==1)?-0.25:((script==2)?0.35:0.0))*LABEL_FONTSIZE;
+      if ((*out).format==SVG_FORMAT) {
+         mp_printf(out,"<tspan dy=\"%1.2f\" font-size=\"%1.1f\">",
+            lastrise-rise,size);
+      } else {
+         mp_printf(out,"/%s %1.1f Tf %1.2f Ts (",(math)?"F2":"F1",size,rise);
+      }
+      for (j=0;j<n;j++) {
+         if ((*out).format==SVG_FORMAT) {
+            if (run[j]=='&') mp_puts(out,"&amp;");
+            else if (run[j]=='<') mp_puts(out,"&lt;");
+            else if (run[j]=='>') mp_puts(out,"&gt;");
+            else mp_putc(out,run[j]);
+         } else {
+            if ((run[j]=='(')||(run[j]==')')) mp_putc(out,'\\');
+            mp_putc(out,run[j]);
+         }
+      }
+      mp_puts(out,((*out).format==SVG_FORMAT)?"</tspan>":") Tj\n");
+      lastrise=rise;
+   }
+   mp_puts(out,((*out).format==SVG_FORMAT)?"</text>\n":"ET\n");
+}
+
+void show_banner(void) {
+   fprintf(stdout,"This is %s v.%s.  ",progname,VERSION_NUMBER);
+   fprintf(stdout,"Copyright (C) 1997-2005, Fredrik Jonsson\n");
+}
+
+void showsomehelp(void) {
+   fprintf(stdout,"Usage: %s [options]\n",progname);
+   fprintf(stdout,
+ "where [options] include:\n"
+ " -h, --help              Show this help-message and exit clean.\n"
+ " -v, --verbose           Toggle verbose mode; show beautiful ASCII.\n"
+ "                         Default: off.\n"
+ " -s, --save_memory       Toggle memory save mode; draw each trajectory as\n"
+ "                         it is scanned instead of keeping all of them in\n"
+ "                         memory. Default: off.\n"
+ " -V, --version           Show version and exit clean.\n\n");
+   fprintf(stdout,
+ " -f, --inputfile <name>  Read input Stokes-parameters from file <name>.\n"
+ "                         The input file may contain an arbitrary number of\n"
+ "                         separate paths, and the format of the file is\n");
+   fprintf(stdout,
+ "                               p\n"
+ "                               <s1> <s2> <s3>       [1:st triplet, path 1]\n"
+ "                               <s1> <s2> <s3>       [2:nd triplet, path 1]\n"
+ "                                  .  .  .\n"
+ "                               <s1> <s2> <s3>       [M:th triplet, path 1]\n"
+ "                               q\n");
+   fprintf(stdout,
+ "                               p\n"
+ "                               <s1> <s2> <s3>       [1:st triplet, path 2]\n"
+ "                                  .  .  .\n"
+ "                               <s1> <s2> <s3>       [N:th triplet, path 2]\n"
+ "                               q\n"
+ "                                  .  .  .                   [etc.]\n");
+   fprintf(stdout,
+ "                         Thus, each separate path should be defined by an\n"
+ "                         initial 'p', after which each following row con-\n"
+ "                         tains a triplet of Stokes parameters.  After the\n"
+ "                         Stokes parameter triplet, comments and additional\n"
+ "                         information may be written (ignored by program)\n"
+ "                         until linefeed.  Finally, each separate path is\n"
+ "                         is ended with a 'q' on a separate line.\n"
+ "\n");
+   fprintf(stdout,
+ "                         The only exception to the ignoring of the rest of\n"
+ "                         the line as described above is if there is a tick\n"
+ "                         mark and possibly an associated label with the\n"
+ "                         Stokes-triplet. In this case, the triplet will be\n"
+ "                         followed by a single \"t\", with an optional label\n"
+           "                         specified by a following\n");
+   fprintf(stdout,
+ "                               l <position> \"<TeX label>\".\n"
+ "                         This way, positions along the mapped trajectories\n"
+ "                         can be easily indicated in the input data to the\n"
+ "                         Poincare program.\n"
+ "\n");
+   fprintf(stdout,
+ "                         Thus, to summarize, each row of data in the the\n"
+ "                         input file has the format\n"
+ "                               <s1> <s2> <s3> [t [l <pos> \"<TeX label>\"]]\n"
+ "\n");
+   fprintf(stdout,
+ "                         If <name> is '-', the trajectories are read from\n"
+ "                         stdin as a stream, with each trajectory mapped as\n"
+ "                         soon as its closing 'q' has arrived, or for\n"
+ "                         MetaPost output even drawn point by point.\n"
+ "                         Files compressed by gzip or zstd are recognized\n"
+ "                         by their first bytes, and are decompressed by\n"
+ "                         gzip or zstd as they are read, as a stream.\n"
+ "\n");
+   fprintf(stdout,
+ " --paththickness <val>   Specifies the thickness in PostScript points (pt)\n"
+ "                         of the path to draw.  Default: <val> = 1.0 [pt].\n"
+ "                         [1 pt == 1/72 inch]\n"
+ "\n");
+   fprintf(stdout,
+ " --tickevery <arc>       Place tick marks along every trajectory at each\n"
+ "                         <arc> of arc length on the unit sphere (in radians,\n"
+ "                         a great circle being 2*pi long), in addition to any\n"
+ "                         tick marks 't' of the input file, drawn across the\n"
+ "                         path as seen in the figure. Default: none.\n"
+ "\n");
+   fprintf(stdout,
+ " --ticksize <len>        Length of the tick marks, in units of the radius of\n"
+ "                         the sphere. Default: <len> = 0.056426.\n"
+ "\n");
+   fprintf(stdout,
+ " --simplify <tol>        Simplify the paths to draw, by omitting points\n"
+ "                         that deviate less than <tol> PostScript points\n"
+ "                         (pt) from the path as seen in the figure, using\n"
+ "                         the Douglas-Peucker algorithm. Points carrying\n"
+ "                         tick marks or labels are always kept.\n"
+ "                         Default: <tol> = 0 (no simplification).\n"
+ "\n");
+   fprintf(stdout,
+ " --fit <tol>             Draw the paths as a few cubic Bezier segments,\n"
+ "                         fitted by least squares to the projected points,\n"
+ "                         such that no point deviates more than <tol>\n"
+ "                         PostScript points (pt) from the curve. The\n"
+ "                         segments are written with explicit control\n"
+ "                         points (..controls a and b..), so that MetaPost\n");
+   fprintf(stdout,
+ "                         does not have to solve for the spline through\n"
+ "                         every point. Points carrying tick marks or labels\n"
+ "                         are kept as knots of the curve.\n"
+ "                         Default: <tol> = 0 (no fitting).\n"
+ "\n");
+   fprintf(stdout,
+ " --density <n>           Instead of drawing the trajectories as paths, bin\n"
+ "                         their normalized Stokes vectors into a grid of\n"
+ "                         2*<n>*<n> cells of equal area on the sphere, as\n"
+ "                         <n> bands of equal height in S_3, of 2*<n> cells\n"
+ "                         each, and draw each cell as a patch shaded from\n");
+   fprintf(stdout,
+ "                         white (no points) to black (the most points),\n"
+ "                         with the hidden cells lighter. For very large\n"
+ "                         numbers of points, no points are kept in memory.\n"
+ "\n");
+   fprintf(stdout,
+ " --draw_hidden_dashed    Toggles between drawing of hidden parts of the\n"
+ "                         specified path with dashed and solid lines.\n"
+ "                         Default: off. (Solid lines)\n"
+ "\n");
+   fprintf(stdout,
+ " --draw_paths_as_arrows  Draw all specified trajectories as arrowed\n"
+ "                         curves, with arrowheads at the and point.\n"
+ "                         This option is useful whenever one wish to,\n"
+ "                         for example, show on the direction of evolution\n"
+ "                         of a certain trajectory, or the direction of\n"
+ "                         rotation of the Stokes vector in a circular\n");
+   fprintf(stdout,
+ "                         path. With this option it is often useful to\n"
+ "                         chop up the trajectory of the original input\n"
+ "                         file into subtrajectories, so as to create\n"
+ "                         multiple arrow heads in the same trajectory.\n"
+ "                         See also the --reverse_arrow_paths option.\n");
+   fprintf(stdout,
+ " --reverse_arrow_paths   Reverse the direction of all arrows drawn using\n"
+ "                         the --draw_paths_as_arrows option. This is useful\n"
+ "                         if the sampled trajectory data are not ordered in\n"
+ "                         the natural direction of trajectory traversal.\n");
+   fprintf(stdout,
+ " --auxsource <name>      Causes the auxiliary file <name> to be included\n"
+ "                         at the end of the generated MetaPost source.\n"
+ "                         Useful for including additional comments, labels\n"
+ "                         etc. in the figure.\n"
+ "\n");
+   fprintf(stdout,
+ " --arrowthickness <val>  Analogous to the '--paththickness' option, but\n"
+ "                         with the difference that this one applies to\n"
+ "                         (eventually occuring) the thickness of additional\n"
+ "                         arrows to be drawn with the '--arrow' option.\n"
+ "                         Default: <val> = 0.6 [pt].\n"
+ "\n");
+   fprintf(stdout,
+ " --arrowheadangle <deg>  Specifies the head angle of any arrows used in\n"
+ "                         the mapping of Stokes parameters on the Poincare\n"
+ "                         sphere. Notice that this does not affect the\n"
+ "                         head angles of the arrows of the coordinate\n"
+ "                         axes. Default value: 30 degrees.\n");
+   fprintf(stdout,
+ " -b, --bezier            Toggle Bezier mode, in which Bezier interpolation\n"
+ "                         is used in order to obtain smooth paths for the\n"
+ "                         input trajectory(-ies), specified with the '-f'\n"
+ "                         option.  Otherwise regular piecewise stright-line\n"
+ "                         type lines are used.   Default: off.\n"
+ "\n");
+   fprintf(stdout,
+ " --binaryoutput <name>   Convert the trajectories of the input file to the\n"
+ "                         compact binary trajectory format, written to file\n"
+ "                         <name>, and exit without generating any MetaPost\n"
+ "                         code. Binary trajectory files are recognized as\n"
+ "                         such when read with the -f option.\n"
+ "\n");
+   fprintf(stdout,
+ " -o, --outputfile <name> Write output MetaPost-code [1] to file <name>.\n"
+ "                         If <name> is '-', the code is written to stdout\n"
+ "                         (not in combination with --verbose or -e).\n"
+ "\n");
+   fprintf(stdout,
+ " --format <fmt>          Output format, being 'mp' for MetaPost code [1],\n"
+ "                         or 'svg' or 'pdf' for a complete SVG or PDF\n"
+ "                         figure written directly by this program, without\n"
+ "                         MetaPost or TeX. The labels are then set in plain\n"
+ "                         Times fonts, and the sphere is shaded as with\n"
+ "                         --precompute_shading. Default: mp.\n"
+ "\n");
+   fprintf(stdout,
+ " --threads <n>           Map the trajectories in <n> parallel threads, each\n"
+ "                         taking a consecutive share of the trajectories,\n"
+ "                         with the output put together in the order of the\n"
+ "                         input file. Not used when reading from stdin or\n"
+ "                         in verbose mode.  Default: <n> = 1.\n"
+ "\n");
+   fprintf(stdout,
+ " --sweeppsi <a>:<b>:<n>  Rotation sweep for animations, generating <n>\n"
+ "                         frames with psi (--rotatepsi) stepped evenly from\n"
+ "                         <a> to <b> degrees, both included. The input file\n"
+ "                         is parsed and the sphere shaded once only.\n");
+   fprintf(stdout,
+ "                         MetaPost code gets one file with beginfig(1) to\n"
+ "                         beginfig(<n>), SVG and PDF one file per frame,\n"
+ "                         numbered as <name>-001.svg, ... With --threads,\n"
+ "                         frames are rendered in parallel.\n");
+   fprintf(stdout,
+ " --sweepphi <a>:<b>:<n>  As --sweeppsi, for phi (--rotatephi). Both may be\n"
+ "                         given, with the same <n>, to sweep both angles.\n"
+ "\n");
+   fprintf(stdout,
+ " --views \"<psi>,<phi>;...\" Draw the figure in each of the given views\n"
+ "                         (degrees, at most 64), as beginfig(1), ... of a\n"
+ "                         single MetaPost file parsed and shaded once. With\n"
+ "                         -e, the panels are tiled on one page.\n"
+ "\n");
+   fprintf(stdout,
+ " --watch <sec>           Watch the input file, checking every <sec>\n"
+ "                         seconds whether trajectories have been appended\n"
+ "                         to it, in which case only these are parsed and\n"
+ "                         mapped, and the output (and with -e, the EPS\n"
+ "                         figure) is regenerated, reusing the sphere and\n"
+ "                         the code of all previous trajectories. Runs until\n"
+ "                         interrupted.\n"
+ "\n");
+   fprintf(stdout,
+ " --batch <manifest>      Carry out all jobs listed in the file <manifest>,\n"
+ "                         one job per line, each given by options as on the\n"
+ "                         command line, applied after the options of the\n"
+ "                         command line itself. Lines starting with '%%' or\n"
+ "                         '#' are ignored. The shaded sphere and equators\n"
+ "                         are reused for jobs with the same view.\n");
+   fprintf(stdout,
+ " --batchoutput <name>    With --batch, write all figures of the jobs to a\n"
+ "                         single MetaPost file <name>, as beginfig(1),\n"
+ "                         beginfig(2), ..., to be compiled in one run.\n"
+ "\n");
+   fprintf(stdout,
+ " -e, --epsoutput <name>  In addition to just generating MetaPost-code for\n"
+ "                         the figure, also try to generate a complete EPS\n"
+ "                         (Encapsulated PostScript) figure, using <name>\n"
+ "                         as the base name for the job. This option relies\n"
+ "                         on MetaPost, TeX, and DVIPS being properly\n"
+ "                         installed in the system environment, and stops\n"
+ "                         at the first of them that fails.\n");
+   fprintf(stdout,
+ "                         The EPS output is named <name>.eps, while the\n"
+ "                         intermediate files are kept in the directory\n"
+ "                         <name>.tmp, where any of MetaPost, TeX and DVIPS\n"
+ "                         is skipped whose output is newer than its input.\n"
+ "\n");
+   fprintf(stdout,
+ " --cache <dir>           With -e, keep the generated EPS figures in the\n"
+ "                         cache directory <dir>, keyed by a SHA-256 digest\n"
+ "                         of the MetaPost code (comments left out) and any\n"
+ "                         --auxsource file. If the same figure is found in\n"
+ "                         the cache, it is linked or copied to <name>.eps,\n"
+ "                         without running MetaPost, TeX or DVIPS at all.\n"
+ "\n");
+   fprintf(stdout,
+ " --jobs <n>              With --batch and -e, run the toolchains of up to\n"
+ "                         <n> EPS figures at the same time. Default: 1.\n"
+ "\n");
+   fprintf(stdout,
+ " --stats <format>        Report, to stderr, the wall time of each phase of\n"
+ "                         the run (parsing, scanning, writing, MetaPost, TeX\n"
+ "                         and DVIPS), the bytes read and written, the number\n"
+ "                         of trajectories, points, tick marks, labels, and\n"
+ "                         hidden and visible segments, and the peak memory,\n"
+ "                         with <format> being text or json.\n"
+ "\n");
+   fprintf(stdout,
+ "--psi, --rotatepsi <val> When mapping Poincare-sphere and corresponding\n"
+ "                         coordinate-system (S_1,S_2,S_3), first rotate\n"
+ "                         angle psi == <val> around the 'z'-axis (S_3).\n"
+ "                         Default: -40.0 (Degrees)\n"
+ "\n");
+   fprintf(stdout,
+ "--phi, --rotatephi <val> When mapping Poincare-sphere and corresponding\n"
+ "                         coordinate-system (S_1,S_2,S_3), after the first\n"
+ "                         rotation (psi above), rotate angle phi == <val>\n"
+ "                         around the 'y'-axis (S_2).\n"
+ "                         Default: 15.0 (Degrees)\n"
+ "\n");
+   fprintf(stdout,
+ " --rhodivisor  <val>     Number of segments in radial direction of the 2D-\n"
+ "                         mapped Poincare sphere.  Default: 50.\n"
+ "\n");
+   fprintf(stdout,
+ " --phidivisor  <val>     Number of segments in tangential direction of the\n"
+ "                         2D-mapped Poincare sphere.  Default: 80.\n"
+ "\n");
+   fprintf(stdout,
+ " --scalefactor <val>     Specifies the radius of the printed Poincare\n"
+ "                         sphere (Encapsulated PostScript) in millimetres.\n"
+ "\n");
+   fprintf(stdout,
+ " --precompute_shading    Toggle precomputed shading of the sphere, in which\n"
+ "                         the Phong shading is computed by this program and\n"
+ "                         written as one fill per gray level, rather than\n"
+ "                         as MetaPost loops over all cells of the sphere.\n"
+ "                         The outlines of the fills are then traced with\n"
+ "                         --phidivisor points each.  Default: off.\n"
+ "\n");
+   fprintf(stdout,
+ " --shading_levels <n>    Number of gray levels of the precomputed shading.\n"
+ "                         Default: <n> = 64.\n"
+ "\n");
+   fprintf(stdout,
+ " --shading <w1> <w2>     Specifies the minimum (<w1>) and maximum (<w2>)\n"
+ "                         whiteness values of the Poincare sphere to draw\n"
+ "                         (using the Phong shading algorithm).\n"
+ "                         Here:\n"
+ "                             <wx> == 0.0  corresponds to 'white'\n"
+ "                             <wx> == 1.0  corresponds to 'white'\n"
+ "                         Default values:  <w1> == 0.65,  <w2> == 0.99\n"
+ "\n");
+   fprintf(stdout,
+ " --hiddengraytone <w>    Specifies the whiteness to be used in drawing\n"
+ "                         trajectory parts that are hidden behind the\n"
+ "                         Poincare sphere.\n"
+ "                             <w> == 0.0  corresponds to black,\n"
+ "                             <w> == 1.0  corresponds to white,\n");
+   fprintf(stdout,
+ " --axislengths <v>       Specifies the lengths of negative and positive\n"
+ "                         parts of the coordinate axes, on the form\n"
+ "                           <v> = <xmin> <xmax> <ymin> <ymax> <zmin> <zmax>\n"
+ "                         with 'x' as the s1-axis, 'y' as the s2-axis, and\n"
+ "                         'z' as the s3-axis. All values are taken relative\n"
+ "                         to the radius of the Poincare sphere; thus <v>=1\n");
+   fprintf(stdout,
+ "                         correspond to the radius, while <v>=1.5 corre-\n"
+ "                         spond to an axis length such that 50 percent of\n"
+ "                         the axis is showed outside the Poincare sphere.\n"
+ "                         Default:  <xmin> = <ymin> = <zmin> = 0.3 (30 %%)\n"
+ "                                   <xmax> = <ymax> = <zmax> = 1.5 (150 %%)\n"
+ "\n");
+   fprintf(stdout,
+ " --axisthickness <t>     Specifies the thickness of the drawn coordinate\n"
+ "                         axes, in units of points (pt). Default: 0.6 pt\n"
+ "                         (Internally of the Poincare program specified by\n"
+ "                         the DEFAULT_ARROW_THICKNESS constant.)");
+   fprintf(stdout,
+ " --axislabels <s>        Specifies the labels of the coordinate axes, on\n"
+ "                         the form\n"
+ "                           <s> = <s1> <p1> <s2> <p2> <s3> <p3>\n"
+ "                         where <s1>, <s2>, and <s3> are strings to use for\n"
+ "                         the s1-, s2-, and s3-labels, respectively, and\n");
+   fprintf(stdout,
+ "                         where the strings <p1>, <p2>, <p3> determine the\n"
+ "                         position of respective label, relative the end\n"
+ "                         point of the arrow of respective axis. The label\n"
+ "                         position is determined by the following syntax:\n");
+   fprintf(stdout,
+ "                              lft    Left\n"
+ "                              rt     Right\n"
+ "                              top    Top\n"
+ "                              bot    Bottom\n"
+ "                              ulft   Upper left\n"
+ "                              urt    Upper Right\n"
+ "                              llft   Lower left\n"
+ "                              lrt    Lower right\n");
+   fprintf(stdout,
+ "                         The label strings should be expressed in plain\n"
+ "                         TeX [2] mathmode syntax.\n");
+   fprintf(stdout,
+ "                         Default: <s1> = $S_1$, <s2> = $S_2$, <s3> = $S_3$\n"
+ "                         Important note:  No blank spaces are allowed in\n"
+ "                         the label strings.\n"
+ "\n");
+   fprintf(stdout,
+ " --draw_axes_inside      Toggles drawing (with dashed lines) of coordinate\n"
+ "                         axes inside Poincare sphere.  Default: off.\n"
+ "\n");
+   fprintf(stdout,
+ " -n, --normalize         Instead of making a trajectory plot of the para-\n"
+ "                         meters (s1,s2,s3), contained in the file speci-\n"
+ "                         fied by the '-f' option, instead use the norma-\n");
+   fprintf(stdout,
+ "                         lized parameter (s1/s0,s2/s0,s3/s0), which for\n"
+ "                         completely polarized light corresponds to a tra-\n"
+ "                         jectory mapped directly on the Poincare sphere,\n"
+ "                         without any deviations fromthe spheres surface.\n");
+   fprintf(stdout,
+ "                         This option is particularly useful when only the\n"
+ "                         state of polarization (and not the intensity) of\n"
+ "                         the light is of interest.\n"
+ "\n");
+   fprintf(stdout,
+ " --arrow <pa> <pb> <v>   Display an arrow, in Stokes parameter space, from\n"
+ "                         point <pa>, at the command-line specified as the\n"
+ "                         triple of floats <s1a> <s2a> <s3a>, to the point\n"
+ "                         <pb>, similarly specified as <s1b> <s2b> <s3b>.\n");
+   fprintf(stdout,
+ "                         Useful for pointing out certain operation cycles\n"
+ "                         in polarization domain, or just as an easy direct\n"
+ "                         way of creating paths on the Poincare sphere\n"
+ "                         without having to use external input files.\n");
+   fprintf(stdout,
+ "                         The arrow is drawn as a circular arc onto the\n"
+ "                         Poincare sphere, through the closest path between\n"
+ "                         the points.  The '--arrow' statement may appear\n"
+ "                         repeated times,for producing multiple arrows.\n"
+ "                         Currently there is a limit of 24 arrows in one\n"
+ "                         single Poincare map (which should do for most\n"
+ "                         people).\n");
+   fprintf(stdout,
+ "                           The last argument <v> is a pair of float values\n"
+ "                         which determines the style of the drawn arrow.\n"
+ "                         The pair <v> should be specified as <v1> <v2> on\n"
+ "                         the command-line.\n");
+   fprintf(stdout,
+ "                         The first parameter <v1> determines the line-type\n"
+ "                         of the arrow to draw.  The rules are:\n"
+ "                            -0.5 <= <v1> < 0.5   -   Solid line\n"
+ "                             0.5 <= <v1> < 1.5   -   Dashed line\n"
+ "                         The second parameter, <v2>, determines the black-\n"
+ "                         ness of the arrow to draw, where <v2> == 0 corre-\n"
+ "                         sponds to white and <v2> == 1 to black.\n"
+ "\n");
+   fprintf(stdout,
+ "Suffix conventions of the files:\n\n"
+ "    .mp    - MetaPost source code (ASCII) [1]\n"
+ "    .tex   - TeX source code (ASCII) [2]\n"
+ "    .dvi   - Device independent output file from TeX [2]\n"
+ "    .ps    - PostScript [3]\n"
+ "    .eps   - Encapsulated PostScript [3]\n\n");
+   fprintf(stdout,"References\n\n");
+   fprintf(stdout,
+ " [1] For information on the MetaPost program for typesetting figures,\n"
+ "     see for example John Hobbys page, at\n"
+ "     http://cm.bell-labs.com/who/hobby/MetaPost.html.\n\n");
+   fprintf(stdout,
+ " [2] For information on the TeX typesetting system, as well as references\n"
+ "     to the dvips program, see for example the homepage of the TeX Users\n"
+ "     Group, at http://www.tug.org.\n\n");
+   fprintf(stdout,
+ " [3] For information on the PostScript programming language, see for\n"
+ "     example the homepage of Adobe Systems Inc., at\n"
+ "     http://www.adobe.com/products/postscript/main.html,\n"
+ "     or 'PostScript Language - Tutorial and Cookbook' (Addison-Wesley,\n"
+ "     Reading, Massachusetts, 1985), ISBN 0-201-10179-3.\n\n");
+   fprintf(stdout,
+ "Please report bugs to Fredrik Jonsson <fredrik@physics.kth.se>\n"
+ "Copyright (C) 1997-2005, Fredrik Jonsson <fredrik@physics.kth.se>\n");
+} /* end of showsomehelp() */
+
+void initialize_variables(pmap *map) {
+   (*map).arrows=NULL;
+   (*map).numarrows=0;
+   (*map).save_memory=0;
+   (*map).use_normalized_stokes_params=0;
+   (*map).use_bezier_curves=0;
+   (*map).user_specified_inputfile=0;
+   (*map).stream_input=0;
+   (*map).input_compression=NO_COMPRESSION;
+   (*map).stream_output=0;
+   (*map).user_specified_binaryfile=0;
+   (*map).user_specified_batchfile=0;
+   (*map).user_specified_batchoutput=0;
+   (*map).user_specified_auxfile=0;
+   (*map).user_specified_cachedir=0;
+   (*map).user_specified_axislabels=0;
+   (*map).user_specified_additional_coordinate_system=0;
+   (*map).user_specified_xtra_axislabel_x=0;
+   (*map).user_specified_xtra_axislabel_y=0;
+   (*map).user_specified_xtra_axislabel_z=0;
+   (*map).draw_hidden_dashed=0;
+   (*map).draw_paths_as_arrows=0;
+   (*map).reverse_arrow_paths=0;
+   (*map).last_point_infront=1;
+   (*map).current_point_is_a_beginlabelpoint=0;
+   (*map).current_point_is_an_endlabelpoint=0;
+   (*map).draw_axes_inside_sphere=0;
+   (*map).currently_drawing_path=0;
+   (*map).generate_eps_output=0;
+   (*map).stats_format=NO_STATS;
+   (*map).stats=NULL;
+   (*map).density_bands=0;
+   (*map).density=NULL;
+   (*map).xtra_neg_axis_length_x=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).xtra_neg_axis_length_y=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).xtra_neg_axis_length_z=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).xtra_pos_axis_length_x=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).xtra_pos_axis_length_y=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).xtra_pos_axis_length_z=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).scalefactor=6.0;
+   (*map).rot_psi=DEFAULT_ROT_PSI;
+   (*map).rot_phi=DEFAULT_ROT_PHI;
+   (*map).delta_rot_psi=0.0;
+   (*map).delta_rot_phi=0;
+   (*map).phi_source=DEFAULT_PHI_SOURCE;
+   (*map).theta_source=DEFAULT_THETA_SOURCE;
+   (*map).upper_whiteness_value=DEFAULT_MAX_WHITENESS;
+   (*map).lower_whiteness_value=DEFAULT_MIN_WHITENESS;
+   (*map).hiddengraytone=DEFAULT_HIDDEN_GRAYTONE;
+   (*map).rho_divisor=DEFAULT_RHO_DIVISOR;
+   (*map).phi_divisor=DEFAULT_PHI_DIVISOR;
+   (*map).xpos_beginpoint=0.0;
+   (*map).ypos_beginpoint=0.0;
+   (*map).xpos_endpoint=0.0;
+   (*map).ypos_endpoint=0.0;
+   (*map).neg_axis_length_s1=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).neg_axis_length_s2=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).neg_axis_length_s3=DEFAULT_NEGATIVE_AXIS_LENGTH;
+   (*map).pos_axis_length_s1=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).pos_axis_length_s2=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).pos_axis_length_s3=DEFAULT_POSITIVE_AXIS_LENGTH;
+   (*map).paththickness=DEFAULT_PATH_THICKNESS;
+   (*map).arrowthickness=DEFAULT_ARROW_THICKNESS;
+   (*map).arrowheadangle=DEFAULT_ARROW_HEADANGLE;
+   (*map).coordaxisthickness=DEFAULT_ARROW_THICKNESS;
+   (*map).ticksize=DEFAULT_TICKSIZE;
+   (*map).tickevery=0.0;
+   (*map).simplify_tolerance=0.0;
+   (*map).fit_tolerance=0.0;
+   (*map).precompute_shading=0;
+   (*map).shading_levels=DEFAULT_SHADING_LEVELS;
+   (*map).output_format=METAPOST_FORMAT;
+   (*map).num_threads=1;
+   (*map).num_jobs=1;
+   (*map).figure_number=1;
+   (*map).sweep_psi=0;
+   (*map).sweep_phi=0;
+   (*map).sweep_psi_start=(*map).sweep_psi_stop=0.0;
+   (*map).sweep_phi_start=(*map).sweep_phi_stop=0.0;
+   (*map).num_sweep_frames=0;
+   (*map).num_views=0;
+   (*map).watch_interval=0.0;
+   strcpy((*map).outfilename,DEFAULT_OUTFILENAME);
+   strcpy((*map).epsjobname,DEFAULT_EPSJOBNAME);
+   strcpy((*map).cachedirname,"");
+   strcpy((*map).axislabel_s1,DEFAULT_AXISLABEL_S1);
+   strcpy((*map).axislabel_s2,DEFAULT_AXISLABEL_S2);
+   strcpy((*map).axislabel_s3,DEFAULT_AXISLABEL_S3);
+   strcpy((*map).axislabelposition_s1,DEFAULT_AXISLABELPOSITION_S1);
+   strcpy((*map).axislabelposition_s2,DEFAULT_AXISLABELPOSITION_S2);
+   strcpy((*map).axislabelposition_s3,DEFAULT_AXISLABELPOSITION_S3);
+   strcpy((*map).xtra_axislabel_x,"");
+   strcpy((*map).xtra_axislabel_y,"");
+   strcpy((*map).xtra_axislabel_z,"");
+   strcpy((*map).labelstr_beginpoint,"");
+   strcpy((*map).labelstr_endpoint,"");
+} /* end of initialize_variables() */
+
+/*
+ * The allocate_stoke_segments() and free_stoke_segments() routines allocate
+ * and free the arrays of the visibility segments of the trajectory |tr|,
+ * as set up by |segment_stokes_trajectory()| for the current view, and of
+ * the tick marks placed by |place_arc_length_tickmarks()|.
+ */
+void allocate_stoke_segments(stoketraject *tr) {
+   (*tr).numsegments=0;
+   (*tr).maxsegments=INITIAL_NUM_SEGMENTS;
+   (*tr).segfirst=lvector(1,INITIAL_NUM_SEGMENTS);
+   (*tr).seglast=lvector(1,INITIAL_NUM_SEGMENTS);
+   (*tr).segfrom=lvector(1,INITIAL_NUM_SEGMENTS);
+   (*tr).segto=lvector(1,INITIAL_NUM_SEGMENTS);
+   (*tr).segvisible=svector(1,INITIAL_NUM_SEGMENTS);
+   (*tr).numautoticks=0;
+   (*tr).maxautoticks=INITIAL_NUM_TICKMARKS;
+   (*tr).autotick=lvector(1,INITIAL_NUM_TICKMARKS);
+}
+
+void free_stoke_segments(stoketraject *tr) {
+   free_lvector((*tr).segfirst,1,(*tr).maxsegments);
+   free_lvector((*tr).seglast,1,(*tr).maxsegments);
+   free_lvector((*tr).segfrom,1,(*tr).maxsegments);
+   free_lvector((*tr).segto,1,(*tr).maxsegments);
+   free_svector((*tr).segvisible,1,(*tr).maxsegments);
+   free_lvector((*tr).autotick,1,(*tr).maxautoticks);
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the |labelarena|. The arena is allocated as its first label
+| is added by |add_label()|, which returns the number of the new record, to
+| which |add_label_char()| appends the characters of the text. The routine
+| |drop_last_label()| removes the last record again, freeing its text, while
+| |reset_label_arena()| empties the arena, keeping its memory for reuse.
+-----------------------------------------------------------------------------*/
+void initialize_label_arena(labelarena *a) {
+   (*a).numlabels=(*a).maxlabels=0;
+   (*a).coord=(*a).offset=NULL;
+   (*a).length=NULL;
+   (*a).pos=NULL;
+   (*a).text=NULL;
+   (*a).textlength=(*a).textsize=0;
+}
+
+void free_label_arena(labelarena *a) {
+   if ((*a).maxlabels>0) {
+      free_lvector((*a).coord,1,(*a).maxlabels);
+      free_lvector((*a).offset,1,(*a).maxlabels);
+      free_ivector((*a).length,1,(*a).maxlabels);
+      free_svector((*a).pos,1,(*a).maxlabels);
+   }
+   free((*a).text);
+   initialize_label_arena(a);
+}
+
+void reset_label_arena(labelarena *a) {
+   (*a).numlabels=0;
+   (*a).textlength=0;
+}
+
+long add_label(labelarena *a,long coord,short pos) {
+   if ((*a).maxlabels==0) {
+      (*a).maxlabels=INITIAL_NUM_LABELS;
+      (*a).coord=lvector(1,(*a).maxlabels);
+      (*a).offset=lvector(1,(*a).maxlabels);
+      (*a).length=ivector(1,(*a).maxlabels);
+      (*a).pos=svector(1,(*a).maxlabels);
+   } else if ((*a).numlabels>=(*a).maxlabels) {
+      (*a).coord=resize_lvector((*a).coord,1,2*(*a).maxlabels);
+      (*a).offset=resize_lvector((*a).offset,1,2*(*a).maxlabels);
+      (*a).length=resize_ivector((*a).length,1,2*(*a).maxlabels);
+      (*a).pos=resize_svector((*a).pos,1,2*(*a).maxlabels);
+      (*a).maxlabels *= 2;
+   }
+   (*a).numlabels++;
+   (*a).coord[(*a).numlabels]=coord;
+   (*a).offset[(*a).numlabels]=(*a).textlength;
+   (*a).length[(*a).numlabels]=0;
+   (*a).pos[(*a).numlabels]=pos;
+   return((*a).numlabels);
+}
+
+void add_label_char(labelarena *a,int ch) {
+   if ((*a).textlength>=(*a).textsize) {
+      (*a).textsize=(((*a).textsize>0)?2*(*a).textsize:INITIAL_LABEL_TEXTSIZE);
+      if (((*a).text=(char *)realloc((*a).text,(size_t)(*a).textsize))
+            ==NULL) {
+         fprintf(stderr,"%s: Error: Allocation failure in "
+            "add_label_char()\n",progname);
+         exit(FAILURE);
+      }
+   }
+   (*a).text[(*a).textlength++]=(char)ch;
+   (*a).length[(*a).numlabels]++;
+}
+
+void drop_last_label(labelarena *a) {
+   (*a).textlength-=(*a).length[(*a).numlabels];
+   (*a).numlabels--;
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the statistics of the --stats option. The wall_clock_time()
+| routine returns the time in seconds from an arbitrary origin, as given by
+| the monotonic clock on POSIX systems, and otherwise by the processor time
+| of clock(). A phase of the run is timed by
+|    t=start_stats_phase(map.stats);
+|      . . .
+|    end_stats_phase(map.stats,"name",t);
+| with the time of all calls to the phase of the same name summed up, while
+| count_scanned_trajectory() and count_drawn_segments() count the contents
+| of every scanned and drawn trajectory, respectively. All routines do
+| nothing if |stats| is NULL, that is, if --stats was not given.
+-----------------------------------------------------------------------------*/
+double wall_clock_time(void) {
+#ifdef POSIX_SYSTEM
+   struct timespec t;
+   if (clock_gettime(CLOCK_MONOTONIC,&t)==0)
+      return((double)t.tv_sec+1.0e-9*(double)t.tv_nsec);
+#endif
+   return(((double)clock())/CLOCKS_PER_SEC);
+}
+
+void initialize_run_stats(runstats *stats,short format,double starttime) {
+   (*stats).format=format;
+   (*stats).numphases=0;
+   (*stats).starttime=starttime;
+   (*stats).bytesread=(*stats).byteswritten=0;
+   (*stats).numtrajectories=(*stats).numpoints=0;
+   (*stats).numtickmarks=(*stats).numlabels=0;
+   (*stats).numhiddensegments=(*stats).numvisiblesegments=0;
+}
+
+double start_stats_phase(runstats *stats) {
+   return((stats==NULL)?0.0:wall_clock_time());
+}
+
+void end_stats_phase(runstats *stats,const char *name,double start) {
+   int k;
+
+   if (stats==NULL) return;
+   for (k=0;(k<(*stats).numphases)&&strcmp((*stats).phase[k],name);k++);
+   if (k==(*stats).numphases) {
+      if (k==MAX_NUM_STATS_PHASES) return;
+      (*stats).phase[k]=name;
+      (*stats).seconds[k]=0.0;
+      (*stats).calls[k]=0;
+      (*stats).numphases++;
+   }
+   (*stats).seconds[k]+=wall_clock_time()-start;
+   (*stats).calls[k]++;
+}
+
+void count_scanned_trajectory(runstats *stats,stoketraject *st) {
+   if (stats==NULL) return;
+   (*stats).numtrajectories++;
+   (*stats).numpoints+=(*st).numcoords;
+   (*stats).numtickmarks+=(*st).numtickmarks;
+   (*stats).numlabels+=(*st).numlabels;
+}
+
+void count_drawn_segments(runstats *stats,stoketraject *st) {
+   long k;
+   if (stats==NULL) return;
+   for (k=1;k<=(*st).numsegments;k++) {
+      if ((*st).segvisible[k]) {
+         (*stats).numvisiblesegments++;
+      } else {
+         (*stats).numhiddensegments++;
+      }
+   }
+}
+
+/*
+ * The peak_memory_usage() routine returns the peak resident memory of the
+ * process so far in kilobytes, or -1 if this is not known on the system.
+ */
+long peak_memory_usage(void) {
+#ifdef POSIX_SYSTEM
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF,&usage)==0) {
+#if defined(__APPLE__) && defined(__MACH__)
+      return((long)(usage.ru_maxrss/1024)); /* given in bytes */
+#else
+      return((long)usage.ru_maxrss); /* given in kilobytes */
+#endif
+   }
+#endif
+   return(-1);
+}
+
+/*-----------------------------------------------------------------------------
+| The write_run_stats() routine writes the statistics of the run to stderr,
+| so that they are kept apart from any figure written to stdout, either as
+| text or as a single JSON object, as chosen with --stats text|json.
+-----------------------------------------------------------------------------*/
+void write_run_stats(runstats *stats) {
+   double total;
+   long peak;
+   int k;
+
+   if (stats==NULL) return;
+   total=wall_clock_time()-(*stats).starttime;
+   peak=peak_memory_usage();
+   if ((*stats).format==JSON_STATS) {
+      fprintf(stderr,"{\"program\": \"%s\", \"version\": \"%s\",\n",
+         progname,VERSION_NUMBER);
+      fprintf(stderr," \"phases\": [");
+      for (k=0;k<(*stats).numphases;k++)
+         fprintf(stderr,"%s\n  {\"name\": \"%s\", \"calls\": %ld, "
+            "\"seconds\": %.6f}",(k>0)?",":"",(*stats).phase[k],
+            (*stats).calls[k],(*stats).seconds[k]);
+      fprintf(stderr,"],\n \"total_seconds\": %.6f,\n",total);
+      fprintf(stderr," \"bytes_read\": %lu, \"bytes_written\": %lu,\n",
+         (*stats).bytesread,(*stats).byteswritten);
+      fprintf(stderr," \"trajectories\": %ld, \"points\": %ld, "
+         "\"tickmarks\": %ld, \"labels\": %ld,\n",(*stats).numtrajectories,
+         (*stats).numpoints,(*stats).numtickmarks,(*stats).numlabels);
+      fprintf(stderr," \"hidden_segments\": %ld, \"visible_segments\": %ld,\n",
+         (*stats).numhiddensegments,(*stats).numvisiblesegments);
+      if (peak<0) {
+         fprintf(stderr," \"peak_memory_kb\": null}\n");
+      } else {
+         fprintf(stderr," \"peak_memory_kb\": %ld}\n",peak);
+      }
+   } else {
+      fprintf(stderr,"%s: Statistics of run:\n",progname);
+      for (k=0;k<(*stats).numphases;k++)
+         fprintf(stderr,"%s:   %-26s %12.6f s (%ld call%s)\n",progname,
+            (*stats).phase[k],(*stats).seconds[k],(*stats).calls[k],
+            ((*stats).calls[k]==1)?"":"s");
+      fprintf(stderr,"%s:   %-26s %12.6f s\n",progname,"total",total);
+      fprintf(stderr,"%s:   bytes read %lu, bytes written %lu\n",progname,
+         (*stats).bytesread,(*stats).byteswritten);
+      fprintf(stderr,"%s:   trajectories %ld, points %ld, tick marks %ld, "
+         "labels %ld\n",progname,(*stats).numtrajectories,(*stats).numpoints,
+         (*stats).numtickmarks,(*stats).numlabels);
+      fprintf(stderr,"%s:   segments %ld hidden, %ld visible\n",progname,
+         (*stats).numhiddensegments,(*stats).numvisiblesegments);
+      if (peak<0) {
+         fprintf(stderr,"%s:   peak memory unknown\n",progname);
+      } else {
+         fprintf(stderr,"%s:   peak memory %ld kB\n",progname,peak);
+      }
+   }
+} /* end of write_run_stats() */
+
+/*
+ * In the initialization of the |stoketraject| struct, the coordinate and
+ * tick mark arrays are initially allocated with INITIAL_NUM_STOKE_COORDS and
+ * INITIAL_NUM_TICKMARKS elements, respectively, and are then grown by the
+ * |grow_stoke_coordinates()| and |grow_stoke_tickmarks()| routines as the
+ * trajectory is being scanned. The labels of the trajectory are added to the
+ * label arena |labels|, to be set by the caller before scanning.
+ */
+void initialize_stoke_trajectory(stoketraject *tr) {
+   (*tr).numcoords=0;
+   (*tr).maxcoords=INITIAL_NUM_STOKE_COORDS;
+   (*tr).s1=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).s2=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).s3=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).x=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).y=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).visible=svector(1,INITIAL_NUM_STOKE_COORDS);
+   (*tr).numtickmarks=0;
+   (*tr).maxtickmarks=INITIAL_NUM_TICKMARKS;
+   (*tr).tickmark=lvector(1,INITIAL_NUM_TICKMARKS);
+   (*tr).labels=NULL;
+   (*tr).firstlabel=0;
+   (*tr).numlabels=0;
+   allocate_stoke_segments(tr);
+} /* end of initialize_stoke_trajectory() */
+
+/*
+ * The grow_stoke_coordinates() and grow_stoke_tickmarks() routines double
+ * the number of allocated coordinates and tick marks, respectively, of the
+ * trajectory |st|. Doubling the size keeps the total cost of the growth
+ * linear in the final number of elements.
+ */
+void grow_stoke_coordinates(stoketraject *st) {
+   (*st).maxcoords *= 2;
+   (*st).s1=resize_dvector((*st).s1,1,(*st).maxcoords);
+   (*st).s2=resize_dvector((*st).s2,1,(*st).maxcoords);
+   (*st).s3=resize_dvector((*st).s3,1,(*st).maxcoords);
+   (*st).x=resize_dvector((*st).x,1,(*st).maxcoords);
+   (*st).y=resize_dvector((*st).y,1,(*st).maxcoords);
+   (*st).visible=resize_svector((*st).visible,1,(*st).maxcoords);
+}
+
+/*-----------------------------------------------------------------------------
+| The update_view_transform() routine computes the 3x3 matrix of the view
+| transform as given by the rotation angles |rot_psi| and |rot_phi|, and
+| stores it in |view| of the parameter map. The first two rows give the
+| projection of a Stokes vector onto the screen coordinates (x,y), while the
+| third row is the direction towards the observer, such that a Stokes vector
+| is visible whenever its scalar product with this row is non-negative. The
+| routine must be called whenever the rotation angles have been changed.
+-----------------------------------------------------------------------------*/
+void update_view_transform(pmap *map) {
+   double cpsi,spsi,cphi,sphi;
+   cpsi=cos((*map).rot_psi);
+   spsi=sin((*map).rot_psi);
+   cphi=cos((*map).rot_phi);
+   sphi=sin((*map).rot_phi);
+   (*map).view[0][0]=spsi;
+   (*map).view[0][1]=cpsi;
+   (*map).view[0][2]=0.0;
+   (*map).view[1][0]=-cpsi*sphi;
+   (*map).view[1][1]=spsi*sphi;
+   (*map).view[1][2]=cphi;
+   (*map).view[2][0]=cpsi*cphi;
+   (*map).view[2][1]=-spsi*cphi;
+   (*map).view[2][2]=sphi;
+} /* end of update_view_transform() */
+
+void grow_stoke_segments(stoketraject *st) {
+   (*st).maxsegments *= 2;
+   (*st).segfirst=resize_lvector((*st).segfirst,1,(*st).maxsegments);
+   (*st).seglast=resize_lvector((*st).seglast,1,(*st).maxsegments);
+   (*st).segfrom=resize_lvector((*st).segfrom,1,(*st).maxsegments);
+   (*st).segto=resize_lvector((*st).segto,1,(*st).maxsegments);
+   (*st).segvisible=resize_svector((*st).segvisible,1,(*st).maxsegments);
+}
+
+void grow_stoke_autoticks(stoketraject *st) {
+   (*st).maxautoticks *= 2;
+   (*st).autotick=resize_lvector((*st).autotick,1,(*st).maxautoticks);
+}
+
+void grow_stoke_tickmarks(stoketraject *st) {
+   (*st).maxtickmarks *= 2;
+   (*st).tickmark=resize_lvector((*st).tickmark,1,(*st).maxtickmarks);
+}
+
+/*
+ * The reset_stokes_trajectory_struct() routine prepares the trajectory |st|
+ * for the scanning of a new trajectory. Only the label slots actually used
+ * by the previous trajectory are cleared, and coordinates or tick marks
+ * beyond |numcoords| and |numtickmarks| are never read, so the cost of the
+ * reset is proportional to what was used, and not to the allocated size.
+ */
+void reset_stokes_trajectory_struct(stoketraject *st) {
+   (*st).numcoords=0;
+   (*st).numtickmarks=0;
+   (*st).firstlabel=(((*st).labels!=NULL)?(*(*st).labels).numlabels:0);
+   (*st).numlabels=0;
+}
+
+void initialize_trajectory_store(trajectorystore *ts) {
+   (*ts).numtrajectories=0;
+   (*ts).maxtrajectories=0;
+   (*ts).trajectory=NULL;
+   initialize_label_arena(&((*ts).labels));
+} /* end of initialize_trajectory_store() */
+
+/*-----------------------------------------------------------------------------
+| The store_scanned_trajectory() routine appends the scanned trajectory |st|
+| to the trajectory store |ts|. The coordinate and tick mark arrays of |st|
+| are handed over to the store, shrunk to exactly the number of elements in
+| use, after which |st| gets freshly allocated arrays of the initial sizes,
+| so that the scratch structure used while parsing can be reset and reused
+| for the next trajectory of the input file. The labels are already in the
+| label arena of the store, as scanned, and are simply handed over.
+-----------------------------------------------------------------------------*/
+void store_scanned_trajectory(trajectorystore *ts,stoketraject *st) {
+   stoketraject *tr;
+   long k;
+
+   if ((*ts).numtrajectories>=(*ts).maxtrajectories) {
+      (*ts).maxtrajectories=((*ts).maxtrajectories>0 ?
+         2*(*ts).maxtrajectories : 16);
+      (*ts).trajectory=(stoketraject *)realloc((*ts).trajectory,
+         (size_t)(((*ts).maxtrajectories+1)*sizeof(stoketraject)));
+      if (!(*ts).trajectory) {
+         fprintf(stderr,"%s: Error: Allocation failure in "
+            "store_scanned_trajectory()\n",progname);
+         exit(FAILURE);
+      }
+   }
+   tr=&((*ts).trajectory[++((*ts).numtrajectories)]);
+   (*tr).numcoords=(*tr).maxcoords=(*st).numcoords;
+   (*tr).s1=resize_dvector((*st).s1,1,(*st).numcoords);
+   (*tr).s2=resize_dvector((*st).s2,1,(*st).numcoords);
+   (*tr).s3=resize_dvector((*st).s3,1,(*st).numcoords);
+   (*tr).x=resize_dvector((*st).x,1,(*st).numcoords);
+   (*tr).y=resize_dvector((*st).y,1,(*st).numcoords);
+   (*tr).visible=resize_svector((*st).visible,1,(*st).numcoords);
+   for (k=1;k<=(*st).numcoords;k++) (*tr).visible[k]=0;
+   (*tr).numtickmarks=(*tr).maxtickmarks=(*st).numtickmarks;
+   (*tr).tickmark=resize_lvector((*st).tickmark,1,(*st).numtickmarks);
+   allocate_stoke_segments(tr);
+   (*st).maxcoords=INITIAL_NUM_STOKE_COORDS;
+   (*st).s1=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).s2=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).s3=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).x=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).y=dvector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).visible=svector(1,INITIAL_NUM_STOKE_COORDS);
+   (*st).maxtickmarks=INITIAL_NUM_TICKMARKS;
+   (*st).tickmark=lvector(1,INITIAL_NUM_TICKMARKS);
+   (*tr).labels=(*st).labels;
+   (*tr).firstlabel=(*st).firstlabel;
+   (*tr).numlabels=(*st).numlabels;
+} /* end of store_scanned_trajectory() */
+
+void free_stoke_trajectory(stoketraject *tr) {
+   free_dvector((*tr).s1,1,(*tr).maxcoords);
+   free_dvector((*tr).s2,1,(*tr).maxcoords);
+   free_dvector((*tr).s3,1,(*tr).maxcoords);
+   free_dvector((*tr).x,1,(*tr).maxcoords);
+   free_dvector((*tr).y,1,(*tr).maxcoords);
+   free_svector((*tr).visible,1,(*tr).maxcoords);
+   free_lvector((*tr).tickmark,1,(*tr).maxtickmarks);
+   free_stoke_segments(tr);
+} /* end of free_stoke_trajectory() */
+
+void free_trajectory_store(trajectorystore *ts) {
+   long k;
+   for (k=1;k<=(*ts).numtrajectories;k++)
+      free_stoke_trajectory(&((*ts).trajectory[k]));
+   free((char*) (*ts).trajectory);
+   free_label_arena(&((*ts).labels));
+   initialize_trajectory_store(ts);
+} /* end of free_trajectory_store() */
+
+/*---------------------------------------------------------------------
+| The pathcharacter() routine takes one character `ch` as argument,
+| and returns 1 ('true') if the character is valid character of a path
+| string, otherwise 0 ('false') is returned.
+---------------------------------------------------------------------*/
+short pathcharacter(int ch) {
+   return(isalnum(ch)||(ch=='.')||(ch=='/')||(ch=='\\')||(ch=='_')||
+      (ch=='-')||(ch=='+'));
+}
+
+/*---------------------------------------------------------------------
+| The strip_away_path() routine takes a character string `filename` as
+| argument, and returns a pointer to the same string but without any
+| preceding path segments. This routine is, for example, useful for
+| removing paths from program names parsed from the command line.
+---------------------------------------------------------------------*/
+char *strip_away_path(char filename[]) {
+   int j,k=0;
+   while (pathcharacter(filename[k])) k++;
+   j=(--k); /* this is the uppermost index of the full path+file string */
+   while (isalnum((int)(filename[j]))) j--;
+   j++; /* this is the lowermost index of the stripped file name */
+   return(&filename[j]);
+}
+
+void display_parsed_command_line_option(pmap *map,char *optstr) {
+   if ((*map).verbose)
+      fprintf(stdout,"%s: Parsing '%s' option.\n",progname,optstr);
+}
+
+/*
+ * The scan_view_list() routine scans the views of the --views option from
+ * |str|, given as "psi,phi;psi,phi;..." in degrees, into the angles (in
+ * radians) of views 1..num_views of |*map|. Returns 1 if successful, or 0
+ * if |str| is not a list of 1..MAX_NUM_VIEWS such pairs.
+ */
+short scan_view_list(pmap *map,char *str) {
+   char *p=str,*end;
+   double psi,phi;
+   int n=0;
+
+   do {
+      psi=strtod(p,&end);
+      if ((end==p)||(*end!=',')) return(0);
+      p=end+1;
+      phi=strtod(p,&end);
+      if (end==p) return(0);
+      while (isspace((int)(*end))) end++;
+      if ((*end!=';')&&(*end!='\0')) return(0);
+      if (++n>MAX_NUM_VIEWS) return(0);
+      (*map).views_psi[n]=psi*(PI/180);
+      (*map).views_phi[n]=phi*(PI/180);
+      p=end+1;
+   } while (*end==';');
+   (*map).num_views=n;
+   return(1);
+}
+
+/*-----------------------------------------------------------------------------
+| The detect_compressed_input() routine checks whether the file |filename|
+| starts with the magic bytes of a gzip or zstd compressed file, returning
+| GZIP_COMPRESSION or ZSTD_COMPRESSION if so, or otherwise NO_COMPRESSION.
+| A file that cannot be opened is left for open_infile() to complain about.
+-----------------------------------------------------------------------------*/
+short detect_compressed_input(char *filename) {
+   FILE *fileptr;
+   char magic[4];
+   size_t n;
+   if ((fileptr=fopen(filename,"rb"))==NULL) return NO_COMPRESSION;
+   n=fread(magic,1,4,fileptr);
+   fclose(fileptr);
+   if ((n>=2)&&(!memcmp(magic,GZIP_MAGIC,2))) return GZIP_COMPRESSION;
+   if ((n==4)&&(!memcmp(magic,ZSTD_MAGIC,4))) return ZSTD_COMPRESSION;
+   return NO_COMPRESSION;
+} /* end of detect_compressed_input() */
+
+/*-----------------------------------------------------------------------------
+| Parsing for command-line arguments. This routine also takes care of default
+| initialization of the variables of the pmap struct.
+| For any additionally specified arrows, we allocate a [7x24] matrix for
+| (potential) arrow coordinates. The organization is as follows:
+|    Each column c=1,2,...,24, of the matrix corresponds to one arrow. The
+|    first three elements are the (s1,s2,s3)-coordinates of the first point
+|    of the arrow (the arrow base), the next three elements are the
+|    (s1,s2,s3)-coordinates of the endpoint of the arrow. The seventh element
+|    determines the type of arrow to draw: if  0 < arrows[...][7] < 1, the
+|    arrow will be of solid-line type,  if  1 < arrows[...][7] < 2, the arrow
+|    will be dashed.
+|    Finally, the eighth element determines the blackness of the arrow, where
+|    arrows[...][8] == 0 corresponds to white, and arrows[...][8] = 1 to
+|    black.
+-----------------------------------------------------------------------------*/
+pmap parse_command_line(int argc, char *argv[]) {
+   int no_arg,sweep_frames;
+   double sweep_start,sweep_stop;
+   short sweeping_psi;
+   pmap map;
+
+   initialize_variables(&map);
+   progname=strip_away_path(argv[0]); /* Strip from preceeding path string */
+   no_arg=argc;
+   map.arrows=matrix(1,8,1,24);
+   while(--argc) { /* while any arguments still are left */
+      if (!strcmp(argv[no_arg-argc],"-v") ||
+         !strcmp(argv[no_arg-argc],"--verbose")) {
+         map.verbose=(map.verbose?0:1);
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+      } else if (!strcmp(argv[no_arg-argc],"-s") ||
+              !strcmp(argv[no_arg-argc],"--save_memory")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.save_memory=(map.save_memory?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"-n") ||
+              !strcmp(argv[no_arg-argc],"--normalize")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.use_normalized_stokes_params
+            =(map.use_normalized_stokes_params?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--paththickness")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.paththickness)) {
+            fprintf(stderr,"%s: Couldn't get path thickness!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--draw_hidden_dashed")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.draw_hidden_dashed=(map.draw_hidden_dashed?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--draw_paths_as_arrows")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.draw_paths_as_arrows=(map.draw_paths_as_arrows?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--reverse_arrow_paths")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.reverse_arrow_paths=(map.reverse_arrow_paths?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--axisthickness")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.coordaxisthickness)) {
+            fprintf(stderr,\
+              "%s: Couldn't get coordinate axis thickness in [pt]!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--arrowthickness")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrowthickness)) {
+            fprintf(stderr,\
+              "%s: Couldn't get arrow thickness in [pt]!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--arrowheadangle")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrowheadangle)) {
+            fprintf(stderr,\
+              "%s: Couldn't get arrow head angle in [deg]!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"-b") ||
+              !strcmp(argv[no_arg-argc],"--bezier")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.use_bezier_curves=(map.use_bezier_curves?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"-h") ||
+              !strcmp(argv[no_arg-argc],"--help")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         showsomehelp();
+         exit(FAILURE);
+      } else if (!strcmp(argv[no_arg-argc],"-V") ||
+              !strcmp(argv[no_arg-argc],"--version")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         show_banner();
+         exit(0);
+      } else if (strcmp(argv[no_arg-argc],"-f")==0 ||
+             strcmp(argv[no_arg-argc],"--inputfile")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.infilename,argv[no_arg-argc]);
+         map.user_specified_inputfile=1;
+         map.stream_input=(strcmp(map.infilename,"-")?0:1);
+      } else if (strcmp(argv[no_arg-argc],"-e")==0 ||
+             strcmp(argv[no_arg-argc],"--epsoutput")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.epsjobname,argv[no_arg-argc]);
+         map.generate_eps_output=1;
+      } else if (strcmp(argv[no_arg-argc],"--cache")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.cachedirname,argv[no_arg-argc]);
+         map.user_specified_cachedir=1;
+      } else if (strcmp(argv[no_arg-argc],"--stats")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!strcmp(argv[no_arg-argc],"text")) {
+            map.stats_format=TEXT_STATS;
+         } else if (!strcmp(argv[no_arg-argc],"json")) {
+            map.stats_format=JSON_STATS;
+         } else {
+            fprintf(stderr,"%s: Error: Unknown format '%s' of --stats "
+               "(should be text or json).\n",progname,argv[no_arg-argc]);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"-o")==0 ||
+             strcmp(argv[no_arg-argc],"--outputfile")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.outfilename,argv[no_arg-argc]);
+         map.stream_output=(strcmp(map.outfilename,"-")?0:1);
+      } else if (strcmp(argv[no_arg-argc],"--batch")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.batchfilename,argv[no_arg-argc]);
+         map.user_specified_batchfile=1;
+      } else if (strcmp(argv[no_arg-argc],"--batchoutput")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.batchoutfilename,argv[no_arg-argc]);
+         map.user_specified_batchoutput=1;
+      } else if (strcmp(argv[no_arg-argc],"--threads")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%d",&map.num_threads))
+               ||(map.num_threads<1)||(map.num_threads>MAX_NUM_THREADS)) {
+            fprintf(stderr,"%s: Couldn't get a valid number of threads "
+               "(1..%d)!\n",progname,MAX_NUM_THREADS);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--jobs")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%d",&map.num_jobs))
+               ||(map.num_jobs<1)||(map.num_jobs>MAX_NUM_JOBS)) {
+            fprintf(stderr,"%s: Couldn't get a valid number of jobs "
+               "(1..%d)!\n",progname,MAX_NUM_JOBS);
+            exit(FAILURE);
+         }
+      } else if ((strcmp(argv[no_arg-argc],"--sweeppsi")==0)
+            ||(strcmp(argv[no_arg-argc],"--sweepphi")==0)) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         sweeping_psi=(strcmp(argv[no_arg-argc],"--sweeppsi")==0);
+         --argc;
+         if ((sscanf(argv[no_arg-argc],"%lf:%lf:%d",&sweep_start,&sweep_stop,
+               &sweep_frames)!=3)||(sweep_frames<1)) {
+            fprintf(stderr,"%s: Couldn't get sweep <start>:<stop>:<frames> "
+               "for %s from '%s'!\n",progname,(sweeping_psi?"psi":"phi"),
+               argv[no_arg-argc]);
+            exit(FAILURE);
+         }
+         if ((map.num_sweep_frames>0)&&(map.num_sweep_frames!=sweep_frames)) {
+            fprintf(stderr,"%s: Error: The sweeps of psi and phi must have "
+               "the same number of frames!\n",progname);
+            exit(FAILURE);
+         }
+         map.num_sweep_frames=sweep_frames;
+         if (sweeping_psi) {
+            map.sweep_psi=1;
+            map.sweep_psi_start=sweep_start*(PI/180);
+            map.sweep_psi_stop=sweep_stop*(PI/180);
+         } else {
+            map.sweep_phi=1;
+            map.sweep_phi_start=sweep_start*(PI/180);
+            map.sweep_phi_stop=sweep_stop*(PI/180);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--views")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!scan_view_list(&map,argv[no_arg-argc])) {
+            fprintf(stderr,"%s: Couldn't get 1..%d views \"psi,phi;psi,phi;"
+               "...\" from '%s'!\n",progname,MAX_NUM_VIEWS,argv[no_arg-argc]);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--density")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%d",&map.density_bands))
+               ||(map.density_bands<1)||(map.density_bands>MAX_DENSITY_BANDS)) {
+            fprintf(stderr,"%s: Couldn't get a valid number of bands of the "
+               "density grid (1..%d)!\n",progname,MAX_DENSITY_BANDS);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--watch")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%lf",&map.watch_interval))
+               ||(map.watch_interval<=0.0)) {
+            fprintf(stderr,"%s: Couldn't get a valid interval of --watch!\n",
+               progname);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--format")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (strcmp(argv[no_arg-argc],"mp")==0) {
+            map.output_format=METAPOST_FORMAT;
+         } else if (strcmp(argv[no_arg-argc],"svg")==0) {
+            map.output_format=SVG_FORMAT;
+         } else if (strcmp(argv[no_arg-argc],"pdf")==0) {
+            map.output_format=PDF_FORMAT;
+         } else {
+            fprintf(stderr,"%s: Error: Unknown output format '%s' "
+               "(should be mp, svg or pdf).\n",progname,argv[no_arg-argc]);
+            exit(FAILURE);
+         }
+      } else if (strcmp(argv[no_arg-argc],"--binaryoutput")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.binfilename,argv[no_arg-argc]);
+         map.user_specified_binaryfile=1;
+      } else if (strcmp(argv[no_arg-argc],"--auxsource")==0) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.auxfilename,argv[no_arg-argc]);
+         map.user_specified_auxfile=1;
+      } else if (!strcmp(argv[no_arg-argc],"--psi") ||
+              !strcmp(argv[no_arg-argc],"--rotatepsi")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.rot_psi)) {
+            fprintf(stderr,\
+              "%s: Couldn't get value for psi (rotation round z)!\n",progname);
+            exit(FAILURE);
+         }
+         map.rot_psi *= (PI/180);
+      } else if (!strcmp(argv[no_arg-argc],"--phi") ||
+              !strcmp(argv[no_arg-argc],"--rotatephi")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.rot_phi)) {
+            fprintf(stderr,\
+              "%s: Couldn't get value for phi (rotation round y)!\n",progname);
+            exit(FAILURE);
+         }
+         map.rot_phi *= (PI/180);
+      } else if (!strcmp(argv[no_arg-argc],"--rhodivisor")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.rho_divisor)) {
+            fprintf(stderr,\
+              "%s: Couldn't get value for rho divisor!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--phidivisor")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.phi_divisor)) {
+            fprintf(stderr,\
+              "%s: Couldn't get value for phi divisor!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--tickevery")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%lf",&map.tickevery))
+               ||(map.tickevery<=0.0)) {
+            fprintf(stderr,\
+              "%s: Couldn't get a valid arc length between tick marks!\n",
+              progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--ticksize")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%lf",&map.ticksize))
+               ||(map.ticksize<=0.0)) {
+            fprintf(stderr,\
+              "%s: Couldn't get a valid length of the tick marks!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--simplify")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%lf",&map.simplify_tolerance))
+               ||(map.simplify_tolerance<0.0)) {
+            fprintf(stderr,\
+              "%s: Couldn't get a valid simplification tolerance!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--fit")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%lf",&map.fit_tolerance))
+               ||(map.fit_tolerance<=0.0)) {
+            fprintf(stderr,\
+              "%s: Couldn't get a valid tolerance of the fit!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--scalefactor")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.scalefactor)) {
+            fprintf(stderr,\
+              "%s: Couldn't get value for scalefactor!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--hiddengraytone")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.hiddengraytone)) {
+            fprintf(stderr,\
+              "%s: Couldn't get whiteness value of hidden parts!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--precompute_shading")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.precompute_shading=(map.precompute_shading?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--shading_levels")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if ((!sscanf(argv[no_arg-argc],"%d",&map.shading_levels))
+               ||(map.shading_levels<2)) {
+            fprintf(stderr,\
+              "%s: Couldn't get a valid number of shading levels (>=2)!\n",
+              progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--shading")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.lower_whiteness_value)) {
+            fprintf(stderr,\
+              "%s: Couldn't get lower value of sphere whiteness!\n",progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.upper_whiteness_value)) {
+            fprintf(stderr,\
+              "%s: Couldn't get upper value of sphere whiteness!\n",progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--axislengths")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.neg_axis_length_s1)) {
+            fprintf(stderr,"%s: Couldn't get minimum for s1 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.pos_axis_length_s1)) {
+            fprintf(stderr,"%s: Couldn't get maximum for s1 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.neg_axis_length_s2)) {
+            fprintf(stderr,"%s: Couldn't get minimum for s2 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.pos_axis_length_s2)) {
+            fprintf(stderr,"%s: Couldn't get maximum for s2 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.neg_axis_length_s3)) {
+            fprintf(stderr,"%s: Couldn't get minimum for s3 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.pos_axis_length_s3)) {
+            fprintf(stderr,"%s: Couldn't get maximum for s3 axis!\n",progname);
+            fprintf(stderr,"%s: Check the '--axislength' option\n", progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--axislabels")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabel_s1,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabelposition_s1,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabel_s2,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabelposition_s2,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabel_s3,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.axislabelposition_s3,argv[no_arg-argc]);
+         map.user_specified_axislabels=1;
+      } else if (!strcmp(argv[no_arg-argc],"--draw_axes_inside")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.draw_axes_inside_sphere=(map.draw_axes_inside_sphere?0:1);
+      } else if (!strcmp(argv[no_arg-argc],"--xtracoordsys")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.delta_rot_psi)) {
+            fprintf(stderr,"%s: Couldn't get delta_rot_psi!\n",progname);
+            fprintf(stderr,"%s: Check the '--xtracoordsys' option\n",progname);
+            fprintf(stderr,"%s: (first argument)\n",progname);
+            exit(FAILURE);
+         }
+         map.delta_rot_psi *= (PI/180);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.delta_rot_phi)) {
+            fprintf(stderr,"%s: Couldn't get delta_rot_phi!\n",progname);
+            fprintf(stderr,"%s: Check the '--xtracoordsys' option\n",progname);
+            fprintf(stderr,"%s: (second argument)\n",progname);
+            exit(FAILURE);
+         }
+         map.delta_rot_phi *= (PI/180);
+         map.user_specified_additional_coordinate_system=1;
+      } else if (!strcmp(argv[no_arg-argc],"--xtracoordsys_axislabel_x")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.xtra_axislabel_x,argv[no_arg-argc]);
+         map.user_specified_xtra_axislabel_x=1;
+      } else if (!strcmp(argv[no_arg-argc],"--xtracoordsys_axislabel_y")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.xtra_axislabel_y,argv[no_arg-argc]);
+         map.user_specified_xtra_axislabel_y=1;
+      } else if (!strcmp(argv[no_arg-argc],"--xtracoordsys_axislabel_z")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         strcpy(map.xtra_axislabel_z,argv[no_arg-argc]);
+         map.user_specified_xtra_axislabel_z=1;
+      } else if (!strcmp(argv[no_arg-argc],"--xtracoordsys_axislengths")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_neg_axis_length_x)) {
+            fprintf(stderr,"%s: Couldn't get minimum for x axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_pos_axis_length_x)) {
+            fprintf(stderr,"%s: Couldn't get maximum for x axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_neg_axis_length_y)) {
+            fprintf(stderr,"%s: Couldn't get minimum for y axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_pos_axis_length_y)) {
+            fprintf(stderr,"%s: Couldn't get maximum for y axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_neg_axis_length_z)) {
+            fprintf(stderr,"%s: Couldn't get minimum for z axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.xtra_pos_axis_length_z)) {
+            fprintf(stderr,"%s: Couldn't get maximum for z axis!\n",progname);
+            fprintf(stderr,
+               "%s: Check the '--xtracoordsys_axislengths' option", progname);
+            exit(FAILURE);
+         }
+      } else if (!strcmp(argv[no_arg-argc],"--arrow")) {
+         display_parsed_command_line_option(&map,argv[no_arg-argc]);
+         map.numarrows++;
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[1][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S1 coordinate for starting point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[2][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S2 coordinate for starting point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[3][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S3 coordinate for starting point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[4][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S1 coordinate for ending point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[5][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S2 coordinate for ending point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[6][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get S3 coordinate for ending point of arrow"
+              " No. %d!\n", progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[7][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get line type of arrow No. %d!\n",\
+                                                     progname, map.numarrows);
+            exit(FAILURE);
+         }
+         --argc;
+         if (!sscanf(argv[no_arg-argc],"%lf",&map.arrows[8][map.numarrows])) {
+            fprintf(stderr,\
+              "%s: Couldn't get blackness of arrow No. %d!\n",\
+                                                     progname, map.numarrows);
+            exit(FAILURE);
+         }
+      } else { /* if no valid option is to be found... */
+         fprintf(stderr,"%s: Error: Specified option '%s' invalid!\n",
+            progname,argv[no_arg-argc]);
+         showsomehelp();
+         exit(FAILURE);
+      }
+   }
+
+   /*-------------------------------------------------------------------------
+   | When writing the MetaPost code to standard output, nothing else must go
+   | to standard output, and there is no named file for MetaPost to compile.
+   -------------------------------------------------------------------------*/
+   if (map.stream_output&&map.verbose) {
+      fprintf(stderr,"%s: Error: Verbose mode cannot be combined with "
+         "output to stdout (--outputfile -).\n",progname);
+      exit(FAILURE);
+   }
+   if (map.stream_output&&map.generate_eps_output) {
+      fprintf(stderr,"%s: Error: EPS output cannot be combined with "
+         "output to stdout (--outputfile -).\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.output_format!=METAPOST_FORMAT)&&map.generate_eps_output) {
+      fprintf(stderr,"%s: Error: EPS output requires MetaPost code "
+         "(--format mp).\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.output_format!=METAPOST_FORMAT)
+         &&(strcmp(map.outfilename,DEFAULT_OUTFILENAME)==0)) {
+      sprintf(map.outfilename,"%s.%s",DEFAULT_EPSJOBNAME,
+         (map.output_format==SVG_FORMAT)?"svg":"pdf");
+   }
+   if (map.user_specified_cachedir&&(!map.generate_eps_output)
+         &&(!map.user_specified_batchfile)) {
+      fprintf(stderr,"%s: Error: The --cache option requires EPS output "
+         "(-e).\n",progname);
+      exit(FAILURE);
+   }
+   if (map.user_specified_batchoutput&&!map.user_specified_batchfile) {
+      fprintf(stderr,"%s: Error: The --batchoutput option requires a batch "
+         "manifest (--batch).\n",progname);
+      exit(FAILURE);
+   }
+   if (map.user_specified_batchoutput&&map.generate_eps_output) {
+      fprintf(stderr,"%s: Error: EPS output cannot be combined with "
+         "--batchoutput; compile the file with MetaPost instead.\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.sweep_psi||map.sweep_phi)&&map.generate_eps_output) {
+      fprintf(stderr,"%s: Error: EPS output cannot be combined with a "
+         "rotation sweep; compile the frames with MetaPost instead.\n",
+         progname);
+      exit(FAILURE);
+   }
+   if ((map.num_views>0)&&(map.sweep_psi||map.sweep_phi)) {
+      fprintf(stderr,"%s: Error: The --views option cannot be combined "
+         "with a rotation sweep.\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.sweep_psi||map.sweep_phi||(map.num_views>0))&&map.stream_output
+         &&(map.output_format!=METAPOST_FORMAT)) {
+      fprintf(stderr,"%s: Error: The frames of a rotation sweep or --views "
+         "in %s cannot be written to stdout (--outputfile -).\n",progname,
+         (map.output_format==SVG_FORMAT)?"SVG":"PDF");
+      exit(FAILURE);
+   }
+   if (map.user_specified_binaryfile&&!map.user_specified_inputfile) {
+      fprintf(stderr,"%s: Error: The --binaryoutput option requires an "
+         "input trajectory file (-f).\n",progname);
+      exit(FAILURE);
+   }
+   map.input_compression=NO_COMPRESSION;
+   if (map.user_specified_inputfile&&!map.stream_input)
+      map.input_compression=detect_compressed_input(map.infilename);
+   if ((map.watch_interval>0.0)&&((!map.user_specified_inputfile)
+         ||map.stream_input||map.stream_output
+         ||(map.input_compression!=NO_COMPRESSION))) {
+      fprintf(stderr,"%s: Error: The --watch option requires an input "
+         "trajectory file (-f) and an output file (-o), neither being stdin, "
+         "stdout or compressed.\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.watch_interval>0.0)&&(map.sweep_psi||map.sweep_phi
+         ||(map.num_views>0)||map.user_specified_batchfile
+         ||map.user_specified_binaryfile)) {
+      fprintf(stderr,"%s: Error: The --watch option cannot be combined with "
+         "a rotation sweep, --views, --batch or --binaryoutput.\n",progname);
+      exit(FAILURE);
+   }
+   if ((map.density_bands>0)&&(map.sweep_psi||map.sweep_phi
+         ||(map.num_views>0)||(map.watch_interval>0.0)
+         ||map.user_specified_binaryfile)) {
+      fprintf(stderr,"%s: Error: The --density option cannot be combined "
+         "with a rotation sweep, --views, --watch or --binaryoutput.\n",
+         progname);
+      exit(FAILURE);
+   }
+   if (map.num_views>0) /* the views are rendered as the frames of a sweep */
+      map.num_sweep_frames=map.num_views;
+   update_view_transform(&map);
+   return map; /* return all parameter values as a struct of type |pmap| */
+} /* end of parse_command_line() */
+
+void display_arrow_specs(pmap map) {
+   int i;
+   if (map.numarrows > 0) {
+      if (map.verbose) {
+         printf("%s: You specified the following arrows to draw:\n",progname);
+         for (i=1;i<=map.numarrows;i++) {
+            printf("%s:    Arrow No. %d: (%1.2f,%1.2f,%1.2f) --> "
+                   "(%1.2f,%1.2f,%1.2f) [%1.2f,%1.2f]\n", progname, i,
+                         map.arrows[1][i], map.arrows[2][i], map.arrows[3][i],
+                         map.arrows[4][i], map.arrows[5][i], map.arrows[6][i],
+                         map.arrows[7][i], map.arrows[8][i]);
+         }
+      }
+   }
+} /* end of display_arrow_specs() */
+
+FILE *open_outfile(pmap map) {
+   FILE *outfileptr;
+   if (map.stream_output) return stdout;
+   if ((outfileptr=fopen(map.outfilename,
+         (map.output_format==PDF_FORMAT)?"wb":"w")) == NULL) {
+      fprintf(stderr,"Couldn't open file %s for output!\n",map.outfilename);
+      exit(FAILURE);
+   } else {
+      if (map.verbose)
+         printf("%s: Writing %s to %s\n",progname,
+            (map.output_format==METAPOST_FORMAT)?"MetaPost code":"figure",
+            map.outfilename);
+   }
+   return outfileptr;
+} /* end of open_outfile() */
+
+/*-----------------------------------------------------------------------------
+| The open_decoder_pipe() routine starts the decoder of the compressed
+| trajectory file of |map| (gzip or zstd) as a separate process, writing the
+| decompressed trajectories to a pipe, whose reading end is returned, with
+| the process id of the decoder kept in |decoderpid|. This way, no
+| decompressed copy of the file is ever stored, and the trajectories are
+| read as a stream, as they are decoded. The decoder is waited for by
+| close_trajectory_input(), where a failure of the decoding is reported.
+-----------------------------------------------------------------------------*/
+FILE *open_decoder_pipe(pmap map,long *decoderpid) {
+   char *decoder=(map.input_compression==ZSTD_COMPRESSION)?
+      ZSTD_DECODER:GZIP_DECODER;
+#ifdef POSIX_SYSTEM
+   FILE *fileptr;
+   int fd[2];
+   pid_t pid;
+
+   if (access(map.infilename,R_OK)!=0) {
+      fprintf(stderr,"%s: Couldn't open trajectory file %s for reading\n",
+         progname,map.infilename);
+      exit(FAILURE);
+   }
+   if (pipe(fd)!=0) {
+      fprintf(stderr,"%s: Error: Couldn't create pipe for %s.\n",
+         progname,decoder);
+      exit(FAILURE);
+   }
+   if ((pid=fork())<0) {
+      fprintf(stderr,"%s: Error: Couldn't start %s.\n",progname,decoder);
+      exit(FAILURE);
+   }
+   if (pid==0) { /* the decoder, writing to the pipe */
+      close(fd[0]);
+      if (fd[1]!=STDOUT_FILENO) {
+         dup2(fd[1],STDOUT_FILENO);
+         close(fd[1]);
+      }
+      execlp(decoder,decoder,"-d","-c","-q","--",map.infilename,(char *)NULL);
+      fprintf(stderr,"%s: Error: Couldn't run %s for decompressing %s.\n",
+         progname,decoder,map.infilename);
+      _exit(FAILURE);
+   }
+   close(fd[1]);
+   if ((fileptr=fdopen(fd[0],"r"))==NULL) {
+      fprintf(stderr,"%s: Error: Couldn't read from %s.\n",progname,decoder);
+      exit(FAILURE);
+   }
+   *decoderpid=(long)pid;
+   if (map.verbose)
+      printf("%s: Reading Stokes parameters from %s (decoded by %s)\n",
+         progname,map.infilename,decoder);
+   return fileptr;
+#else
+   fprintf(stderr,"%s: Error: Trajectory file %s is compressed; reading "
+      "compressed files requires a POSIX system, please decompress it with "
+      "%s first.\n",progname,map.infilename,decoder);
+   *decoderpid=0;
+   exit(FAILURE);
+   return NULL;
+#endif
+} /* end of open_decoder_pipe() */
+
+/*
+ * The open_infile() routine opens the trajectory file of |map| for reading,
+ * or returns stdin for --inputfile -. For compressed files, the reading end
+ * of the pipe from the decoder is returned, with its process id kept in
+ * |decoderpid|, which otherwise is set to zero.
+ */
+FILE *open_infile(pmap map,long *decoderpid) {
+   FILE *infileptr;
+   *decoderpid=0;
+   if (!map.user_specified_inputfile) {
+      fprintf(stderr,"%s: No input trajectory file specified.\n",progname);
+      infileptr=NULL;
+   } else if (map.stream_input) {
+      infileptr=stdin;
+      if (map.verbose)
+         printf("%s: Reading Stokes parameters from stdin\n",progname);
+   } else if (map.input_compression!=NO_COMPRESSION) {
+      infileptr=open_decoder_pipe(map,decoderpid);
+   } else {
+   if ((infileptr=fopen(map.infilename,"r")) == NULL) {
+      fprintf(stderr,"%s: Couldn't open trajectory file %s for reading\n",
+         progname,map.infilename);
+      fprintf(stderr,"%s: Please check -f or --inputfile option arguments\n",
+                         progname);
+      exit(FAILURE);
+   } else {
+      if (map.verbose) {
+         printf("%s: Reading Stokes parameters from %s\n",\
+                                           progname, map.infilename);
+      }
+   }
+   }
+   return infileptr;
+} /* end of open_infile() */
+
+/*
+ * Write out the heading comments of the MetaPost file that is about
+ * to be generated.
+ */
+void write_header(mpbuffer *out,pmap map,int argc, char *argv[]) {
+   time_t now=time(NULL);
+   int i=0,no_arg=argc;
+   mp_printf(out,
+ "%% This Filename:  %s   [MetaPost source]\n"
+ "%% Creation time:  %s"                   /* ctime() takes care of '\n'. */
+ "%%\n"
+ "%% Copyright (C) 1997-2005, Fredrik Jonsson <fj@optics.kth.se>\n"
+ "%%\n"
+ "%% Input Filename [Stokes parameters]:  %s\n"
+ "%% This MetaPost source code was automatically generated by %s\n",
+   map.outfilename, ctime(&now), map.infilename, progname);
+
+   /*
+    * In many cases, it is quite useful to keep the full command-line
+    * that generated a certain figure, for future reference.
+    */
+   argc=no_arg-1;
+   mp_printf(out,
+      "%% Full set of command line options that generated this code:\n");
+   while (argc) {
+      if (i==0) mp_printf(out,"%%    ");
+      mp_printf(out," %s",argv[no_arg-argc]);
+      argc--;
+      i++;
+      if (i==6) {
+         mp_printf(out,"\n");
+         i=0;
+      }
+   }
+   mp_printf(out,"\n%%\n");
+   mp_printf(out,
+ "%% Description:  Map of Stokes parameters, visualized as trajectories\n"
+ "%%               onto the Poincare sphere. This file contains MetaPost\n"
+ "%%               source code, to be compiled with John Hobby's MetaPost\n"
+ "%%               compiler or used with anything that understands MetaPost\n"
+ "%%               source code.\n"
+ "%%\n");
+   mp_printf(out,
+ "%% If you want to create PostScript output, or include the resulting\n"
+ "%% output in a TeX document, this example illustrates the procedure,\n"
+ "%% assuming 'poincaremap.mp' to be the name of the file containing the\n"
+ "%% MetaPost code to be visualized: (commands run on command-line)\n"
+ "%%\n");
+   mp_printf(out,
+ "%%       mp poincaremap.mp;\n"
+ "%%       echo \042\\input epsf\\centerline{\\epsfbox{poincaremap.1}}\\bye\042 > tmp.tex;\n"
+ "%%       tex tmp.tex;\n"
+ "%%       dvips tmp.dvi -o poincaremap.ps;\n"
+ "%%\n");
+   mp_printf(out,
+ "%% Here, the first command compiles the MetaPost source code, and leaves\n"
+ "%% an Encapsulated PostScript file named 'poincaremap.1', containing TeX\n"
+ "%% control codes for characters, etc. This file does not contain any\n"
+ "%% definitions for characters or TeX-specific items, and it cannot be\n"
+ "%% viewed or printed simply as is stands; it must rather be included into\n"
+ "%% TeX code in order to provide something useful.\n");
+   mp_printf(out,
+ "%%     The second command creates a temporary minimal TeX-file 'tmp.tex',\n"
+ "%% that only includes the previously generated Encapsulated PostScript\n"
+ "%% code.\n");
+   mp_printf(out,
+ "%%     The third command compiles the TeX-code into device-independent,\n"
+ "%% or DVI, output, stored in the file 'tmp.dvi'.\n"
+ "%%     Finally, the last command converts the DVI output into a free-\n"
+ "%% standing PostScript file 'poincaremap.ps', to be printed or viewed\n"
+ "%% with some PostScript viewer, such as GhostView.\n"
+ "%%\n");
+} /* end of write_header() */
+
+void write_euler_angle_specs(mpbuffer *out,pmap map) {
+   mp_printf(out,
+ "scalefactor := %f mm;\n"
+ "rot_psi := %f;  %% Rotation angle round z-axis (first rotation)\n"
+ "rot_phi := %f;  %% Rotation angle round y-axis (second rotation)\n"
+ "alpha := %f;    %% == arctan(sin(rot_phi)*tan(rot_psi))\n"
+ "beta  := %f;    %% == arctan(sin(rot_phi)/tan(rot_psi))\n\n",
+   map.scalefactor, (180/PI)*map.rot_psi, (180/PI)*map.rot_phi,
+   (180/PI)*atan(sin(map.rot_phi)*tan(map.rot_psi)),
+   (180/PI)*atan(sin(map.rot_phi)/tan(map.rot_psi)));
+} /* end of write_euler_angle_specs() */
+
+/*
+ * The write_light_source_specs() routine writes the parameters of the light
+ * source and of the shading of the sphere, kept by MetaPost from one figure
+ * to the next, so that the figures after the first one of a rotation sweep
+ * or of --views only need |begin_shaded_figure()|.
+ */
+void write_light_source_specs(mpbuffer *out,pmap map) {
+   /*
+    * Parameters specifying the location of the light source.
+    */
+   mp_printf(out,
+     "%%\n"
+     "%% Parameters specifying the location of the light source; for Phong\n"
+     "%% shading of the sphere.\n"
+     "%%\n"
+     "%%    phi_source:  Angle (in deg.) to light source counterclockwise\n"
+     "%%                 'from three o'clock', viewed from the observer.\n"
+     "%%\n"
+     "%%  theta_source:  Angle (in deg.) between light source and observer,\n"
+     "%%                 seen from the centre of the sphere.\n"
+     "%%\n");
+   mp_printf(out,
+     "%% Parameters specifying the shading 'intensity' in terms of maximum\n"
+     "%% (for the highlighs) and minimum (for the deep shadowed regions)\n"
+     "%% values for the Phong shading.  '0.0' <=> 'black'; '1.0' <=> 'white'\n"
+     "%%\n"
+     "%%   upper_value:  Maximum value of whiteness.\n"
+     "%%   lower_value:  Minimum value of whiteness.\n"
+     "%%\n");
+   mp_printf(out,
+     "phi_source := %f;\n"
+     "theta_source := %f;\n"
+     "upper_value := %f;\n"
+     "lower_value := %f;\n",
+       (180/PI)*map.phi_source,(180/PI)*map.theta_source,
+       map.upper_whiteness_value,map.lower_whiteness_value);
+   mp_printf(out,
+     "radius := scalefactor;\n"
+     "delta_rho := radius/%f;\n"
+     "delta_phi := 360.0/%f;\n",map.rho_divisor, map.phi_divisor);
+} /* end of write_light_source_specs() */
+
+void begin_shaded_figure(mpbuffer *out,pmap map) {
+   mp_printf(out,
+     "beginfig(%d);\n"
+     "  path p;\n"
+     "  path equator;\n"
+     "  transform T;\n"
+     "  c1:=lower_value;\n"
+     "  c2:=upper_value-lower_value;\n",map.figure_number);
+
+/*-----------------------------------------------------------------------------
+| Here follows the x-, y- and z-components of the unit normal vector pointing
+| from the center of the sphere to the position of the (point-like) light
+| source.
+-----------------------------------------------------------------------------*/
+   mp_printf(out,
+     "  nx_source := sind(theta_source)*cosd(phi_source);\n"
+     "  ny_source := sind(theta_source)*sind(phi_source);\n"
+     "  nz_source := cosd(theta_source);\n"
+     "  phistop := 360.0;\n"
+     "  rhostop := radius - delta_rho/2.0;\n");
+} /* end of begin_shaded_figure() */
+
+void write_sphere_shading_specs(mpbuffer *out,pmap map) {
+   write_light_source_specs(out,map);
+   begin_shaded_figure(out,map);
+}
+
+/*-----------------------------------------------------------------------------
+| The shading_product() routine returns the scalar product of the normal
+| vector of the sphere at the projected point (x,y), with x*x+y*y<=1, and
+| the unit vector (nxs,nys,nzs) pointing towards the light source.
+-----------------------------------------------------------------------------*/
+double shading_product(double x,double y,double nxs,double nys,double nzs) {
+   double r2=x*x+y*y;
+   return(x*nxs+y*nys+((r2<1.0)?sqrt(1.0-r2):0.0)*nzs);
+}
+
+/*-----------------------------------------------------------------------------
+| The shading_contour() routine traces the boundary of the region of the
+| projected sphere where the shading product is at least |c|, returning the
+| number of points |x[1..n]|, |y[1..n]| (in units of the radius) of the
+| boundary, or 0 if the region is empty. The number of points n is given by
+| |num_shading_contour_points()|.
+|
+| Since the shading product is a concave function of the projected
+| coordinates (x,y), the region where it exceeds a given threshold is convex,
+| containing the point of maximum shading, and its boundary is found along
+| |phi_divisor| rays from this point, by bisection between the point and the
+| rim of the sphere.
+-----------------------------------------------------------------------------*/
+long num_shading_contour_points(pmap map) {
+   long nphi=(long)floor(map.phi_divisor);
+   return((nphi<8)?8:nphi);
+}
+
+long shading_contour(double *x,double *y,double c,pmap map) {
+   double nxs,nys,nzs,x0,y0,r0,ux,uy,pu,rhomax,ra,rb,rm,theta;
+   long j,nphi=num_shading_contour_points(map);
+   int k;
+
+   nxs=sin(map.theta_source)*cos(map.phi_source);
+   nys=sin(map.theta_source)*sin(map.phi_source);
+   nzs=cos(map.theta_source);
+
+   /* The point of maximum shading, kept just inside the rim of the sphere */
+   r0=sqrt(nxs*nxs+nys*nys);
+   x0=nxs;
+   y0=nys;
+   if ((nzs<=0.0)||(r0>0.999)) {
+      x0=((r0>0.0)?0.999*nxs/r0:0.0);
+      y0=((r0>0.0)?0.999*nys/r0:0.0);
+   }
+   if (shading_product(x0,y0,nxs,nys,nzs)<c) return 0; /* empty region */
+   for (j=1;j<=nphi;j++) {
+      theta=(j-1)*(2.0*PI/nphi);
+      ux=cos(theta);
+      uy=sin(theta);
+      pu=x0*ux+y0*uy;
+      rhomax=-pu+sqrt(pu*pu-(x0*x0+y0*y0)+1.0); /* distance to the rim */
+      if (shading_product(x0+rhomax*ux,y0+rhomax*uy,nxs,nys,nzs)>=c) {
+         rm=rhomax;
+      } else {
+         ra=0.0;
+         rb=rhomax;
+         for (k=0;k<40;k++) {
+            rm=0.5*(ra+rb);
+            if (shading_product(x0+rm*ux,y0+rm*uy,nxs,nys,nzs)>=c) {
+               ra=rm;
+            } else {
+               rb=rm;
+            }
+         }
+         rm=ra;
+      }
+      x[j]=x0+rm*ux;
+      y[j]=y0+rm*uy;
+   }
+   return nphi;
+}
+
+/*-----------------------------------------------------------------------------
+| The write_precomputed_shaded_sphere() routine is used instead of the
+| MetaPost loops of |write_shaded_sphere()| whenever the --precompute_shading
+| option is given. The Phong shading is then computed by the program, with
+| the gray tone c1+c2*prod*prod (for prod>=0; otherwise c1) quantized to
+| |shading_levels| levels. Rather than filling cells, the regions of equal
+| quantized gray tone are filled as a whole, in order of increasing
+| whiteness, each of them painted on top of the previous ones, with their
+| boundaries traced by |shading_contour()| and passed on to MetaPost as
+| smooth closed curves. This way MetaPost gets one fill per gray level, with
+| the precision no longer limited by the cells of the loops.
+-----------------------------------------------------------------------------*/
+void write_precomputed_shaded_sphere(mpbuffer *out,pmap map) {
+   double *x,*y,c1,c2;
+   long j,nphi=num_shading_contour_points(map);
+   int q,lmax=map.shading_levels-1;
+
+   x=dvector(1,nphi);
+   y=dvector(1,nphi);
+   c1=map.lower_whiteness_value;
+   c2=map.upper_whiteness_value-map.lower_whiteness_value;
+   mp_printf(out,
+      "  fill fullcircle scaled (2*radius) withcolor %f[black,white];\n",c1);
+   for (q=1;q<=lmax;q++) {
+      /* threshold of prod for gray level q */
+      if (shading_contour(x,y,sqrt((q-0.5)/lmax),map)==0) break;
+      mp_printf(out,"  fill (");
+      for (j=1;j<=nphi;j++) {
+         mp_printf(out,"%s(%1.4f,%1.4f)",(j>1)?"..":"",x[j],y[j]);
+         if ((j%NUM_COORDS_PER_METAPOST_LINE)==0) mp_printf(out,"\n    ");
+      }
+      mp_printf(out,"..cycle) scaled radius withcolor %f[black,white];\n",
+         c1+c2*((double)q)/lmax);
+   }
+   mp_printf(out,"\n");
+   free_dvector(x,1,nphi);
+   free_dvector(y,1,nphi);
+   if (map.verbose)
+      fprintf(stdout,"%s: Precomputed shading of sphere in %d fills\n",
+         progname,q);
+} /* end of write_precomputed_shaded_sphere() */
+
+/*-----------------------------------------------------------------------------
+| The write_native_shaded_sphere() routine is the counterpart of
+| |write_precomputed_shaded_sphere()| for the native vector output, which
+| always uses the precomputed shading.
+-----------------------------------------------------------------------------*/
+void write_native_shaded_sphere(mpbuffer *out,pmap map) {
+   double *x,*y,c1,c2,radius=map.scalefactor*BP_PER_MM;
+   long j,nphi=num_shading_contour_points(map);
+   int q,lmax=map.shading_levels-1;
+
+   x=dvector(1,nphi);
+   y=dvector(1,nphi);
+   c1=map.lower_whiteness_value;
+   c2=map.upper_whiteness_value-map.lower_whiteness_value;
+   vec_circle(out,radius,c1);
+   for (q=1;q<=lmax;q++) {
+      if (shading_contour(x,y,sqrt((q-0.5)/lmax),map)==0) break;
+      for (j=1;j<=nphi;j++) {
+         x[j]*=radius;
+         y[j]*=radius;
+      }
+      vec_fill(out,x,y,nphi,1,c1+c2*((double)q)/lmax);
+   }
+   free_dvector(x,1,nphi);
+   free_dvector(y,1,nphi);
+} /* end of write_native_shaded_sphere() */
+
+/*-----------------------------------------------------------------------------
+| Now generate the Phong-shaded poincare sphere as it is projected down
+| in 2D.  This is done by creating a number of >>parallelltrapetser<<
+| mapped centro-symmmetrically around origo.
+| The steps involved in this are as follows:
+| 1. Take the coordinate of the center of each >>parallelltrapets<< to be
+|    the reference for calculating the coordinates of the corners.
+| 2. Calculate the coordinates of the corners of >>parallelltrapetserna<<.
+| 3. Create the path p of the >>parallelltrapets<<:
+|
+|          (x3,y3)                       (x2,y2)
+|               +------------<------------+
+|                \                       /
+|                 \                     /
+|                  v                   ^
+|                   \                 /
+|                    \               /
+|                     +------>------+
+|                 (x4,y4)          (x1,y1)
+|
+| 4. Check if the >>parallelltrapets<< just created is shaded by the sphere or
+|    not, i.e. if the position of the >>parallelltrapets<< is situated on the
+|    opposite side of the Poincare sphere, seen from the direction of the light
+|    source. If so, make the >>parallelltrapets<< shaded with the darkest tone,
+|    specified by c1; otherwise make it shaded with the tone of gray specified
+|    by prod, the scalar product of the normal vector to the object with the
+|    normal vector to the lightsource.
+-----------------------------------------------------------------------------*/
+void write_shaded_sphere(mpbuffer *out,pmap map) {
+   if ((*out).format!=METAPOST_FORMAT) {
+      write_native_shaded_sphere(out,map);
+      return;
+   }
+   mp_printf(out,
+     "%%\n"
+     "%% Draw the shaded Poincare sphere projected on 2D screen coordinates\n"
+     "%%\n");
+   if (map.precompute_shading) {
+      write_precomputed_shaded_sphere(out,map);
+      return;
+   }
+   mp_printf(out,
+     "  for rho=0.0cm step delta_rho until rhostop:\n"
+     "    for phi=0.0 step delta_phi until phistop:\n");
+   mp_printf(out,
+     "      rhomid := rho + delta_rho/2.0;\n"
+     "      phimid := phi + delta_phi/2.0;\n");
+   mp_printf(out,
+     "      x1 := rho*cosd(phi);\n"
+     "      y1 := rho*sind(phi);\n"
+     "      x2 := (rho+delta_rho)*cosd(phi);\n"
+     "      y2 := (rho+delta_rho)*sind(phi);\n"
+     "      x3 := (rho+delta_rho)*cosd(phi+delta_phi);\n"
+     "      y3 := (rho+delta_rho)*sind(phi+delta_phi);\n"
+     "      x4 := rho*cosd(phi+delta_phi);\n"
+     "      y4 := rho*sind(phi+delta_phi);\n");
+   mp_printf(out,
+     "      p:=makepath makepen ((x1,y1)--(x2,y2)--(x3,y3)--(x4,y4)--(x1,y1));\n"
+     "      quot := (rhomid/radius);\n"
+     "      nx_object := quot*cosd(phimid);\n"
+     "      ny_object := quot*sind(phimid);\n"
+     "      nz_object := sqrt(1-quot*quot);\n");
+   mp_printf(out,
+     "      prod:=nx_object*nx_source+ny_object*ny_source\n"
+     "            +nz_object*nz_source;\n");
+   mp_printf(out,
+     "      if prod < 0.0:\n"
+     "         value := c1;\n"
+     "      else:\n"
+     "         value := c1 + c2*prod*prod;\n"
+     "      fi\n"
+     "      fill p withcolor value[black,white];\n"
+     "    endfor\n"
+     "  endfor\n\n");
+} /*end of write_shaded_sphere() */
+
+/*-----------------------------------------------------------------------------
+| The write_native_equators() routine is the counterpart of
+| |write_equators()| for the native vector output. Each equator is drawn as
+| the half circle through NUM_EQUATOR_POINTS points, transformed as in the
+| MetaPost code, that is, first scaled by |a| in the y-direction and then
+| rotated by the angle |theta|.
+-----------------------------------------------------------------------------*/
+void write_native_half_ellipse(mpbuffer *out,pmap map,double a,
+      double theta) {
+   double x[NUM_EQUATOR_POINTS+1],y[NUM_EQUATOR_POINTS+1],t,radius;
+   int k;
+
+   radius=map.scalefactor*BP_PER_MM;
+   for (k=1;k<=NUM_EQUATOR_POINTS;k++) {
+      t=(k-1)*(PI/(NUM_EQUATOR_POINTS-1));
+      x[k]=radius*(cos(t)*cos(theta)-a*sin(t)*sin(theta));
+      y[k]=radius*(cos(t)*sin(theta)+a*sin(t)*cos(theta));
+   }
+   vec_stroke(out,x,y,NUM_EQUATOR_POINTS,1,1.0-0.45,
+      map.coordaxisthickness*BP_PER_PT,0);
+}
+
+void write_native_equators(mpbuffer *out,pmap map) {
+   double psi,phi;
+   int k;
+
+   for (k=0;k<=(map.user_specified_additional_coordinate_system?1:0);k++) {
+      psi=map.rot_psi+((k)?map.delta_rot_psi:0.0);
+      phi=map.rot_phi+((k)?map.delta_rot_phi:0.0);
+      write_native_half_ellipse(out,map,sin(phi),PI);
+      write_native_half_ellipse(out,map,cos(phi)*sin(psi),
+         1.5*PI+atan(sin(phi)*tan(psi)));
+      write_native_half_ellipse(out,map,cos(phi)*cos(psi),
+         1.5*PI-atan(sin(phi)/tan(psi)));
+   }
+} /* end of write_native_equators() */
+
+/*-----------------------------------------------------------------------------
+| Draw the 'equators' $S_1=0$, $S_2=0$ and $S_3=0$ on the sphere.
+| If specified by the user, also draw the additional 'equators' (corresponding
+| to a coordinate system rotated around the original one by the Euler angles
+| delta_psi, delta_phi) on the sphere.
+-----------------------------------------------------------------------------*/
+void write_equators(mpbuffer *out,pmap map) {
+   if ((*out).format!=METAPOST_FORMAT) {
+      write_native_equators(out,map);
+      return;
+   }
+   mp_printf(out,
+     "%%\n"
+     "%% Draw the 'equators' of the Poincare sphere\n"
+     "%%\n"
+     "   equator := halfcircle scaled (2.0*radius);\n"
+     "   eqcolval := .45;    %% '0.0' <=> 'white';  '1.0' <=> 'black'\n"
+     "\n");
+   mp_printf(out,
+     "   pickup pencircle scaled %f pt;\n",map.coordaxisthickness);
+   mp_printf(out,
+     "%%\n"
+     "%% Draw equator $S_3=0$...\n"
+     "%%\n"
+     "   T := identity yscaled sind(rot_phi) rotated 180.0;\n"
+     "   draw equator transformed T withcolor eqcolval [white,black];\n"
+     "\n");
+   mp_printf(out,
+     "%%\n"
+     "%% ... then equator $S_2=0$...\n"
+     "%%\n"
+     "   T := identity yscaled (cosd(rot_phi)*sind(rot_psi))\n"
+     "                 rotated (270.0 + alpha);\n"
+     "   draw equator transformed T withcolor eqcolval [white,black];\n"
+     "\n");
+   mp_printf(out,
+     "%%\n"
+     "%% ... and finally equator $S_1=0$.\n"
+     "%%\n"
+     "   T := identity yscaled (cosd(rot_phi)*cosd(rot_psi))\n"
+     "                 rotated (270.0 - beta);\n"
+     "   draw equator transformed T withcolor eqcolval [white,black];\n"
+     "\n");
+   if (map.user_specified_additional_coordinate_system) { /* whoaaaou ... */
+      mp_printf(out,
+        "%%\n"
+        "%% Some handy parameters used in calculations below.\n"
+        "%%\n");
+      mp_printf(out,
+        "delta_rot_psi := %f; %% Additional 1st rotation angle round z-axis\n"
+        "delta_rot_phi := %f;  %% Additional 2nd rotation angle round y-axis\n"
+        "delta_alpha := %f;    %% == arctan(sin(rot_phi)*tan(rot_psi))\n"
+        "delta_beta  := %f;    %% == arctan(sin(rot_phi)/tan(rot_psi))\n\n",
+          (180/PI)*(map.delta_rot_psi),(180/PI)*(map.delta_rot_phi),
+          (180/PI)*atan(sin(map.rot_phi + map.delta_rot_phi)
+            *tan(map.rot_psi + map.delta_rot_psi)),
+          (180/PI)*atan(sin(map.rot_phi + map.delta_rot_phi)
+            /tan(map.rot_psi + map.delta_rot_psi)));
+      mp_printf(out,
+        "%%\n"
+        "%% Draw the additional 'equators' of the Poincare sphere,\n"
+        "%% corresponding to a system rotated by the Euler-angles\n"
+        "%%   delta_psi=, delta_phi=\n"
+        "%%\n"
+        "   equator := halfcircle scaled (2.0*radius);\n"
+        "   eqcolval := .45;    %% '0.0' <=> 'white';  '1.0' <=> 'black'\n"
+        "\n");
+      mp_printf(out,
+        "%%\n"
+        "%% Draw equator $W_3=0$...\n"
+        "%%\n"
+        "   T := identity yscaled sind(rot_phi+delta_rot_phi) rotated 180.0;\n"
+        "   draw equator transformed T withcolor eqcolval [white,black];\n"
+        "\n");
+      mp_printf(out,
+        "%%\n"
+        "%% ... then equator $W_2=0$...\n"
+        "%%\n"
+        "   T := identity yscaled (cosd(rot_phi + delta_rot_phi)\n"
+        "             *sind(rot_psi + delta_rot_psi))\n"
+        "             rotated (270.0 + delta_alpha);\n"
+        "   draw equator transformed T withcolor eqcolval [white,black];\n"
+        "\n");
+      mp_printf(out,
+        "%%\n"
+        "%% ... and finally equator $W_1=0$.\n"
+        "%%\n"
+        "   T := identity yscaled (cosd(rot_phi + delta_rot_phi)\n"
+        "             *cosd(rot_psi + delta_rot_psi))\n"
+        "             rotated (270.0 - delta_beta);\n"
+        "   draw equator transformed T withcolor eqcolval [white,black];\n"
+        "\n");
+   }
+} /* end of write_equators() */
+
+void display_stokes_trajectory(stoketraject st) {
+   long k;
+
+   fprintf(stdout,"Stokes trajectory [%ld coordinates]:\n",st.numcoords);
+   for (k=1;k<=st.numcoords;k++) {
+      fprintf(stdout," S[%ld]=(%f, %f ,%f), ",k,st.s1[k],st.s2[k],st.s3[k]);
+      fprintf(stdout,"[%s]\n",(st.visible[k]?"visible":"hidden"));
+   }
+}
+
+/*
+ * The map_trajectory_input() routine attempts to memory map the file
+ * |fileptr| in its entirety, returning 1 (true) if successful. Anything else
+ * than a non-empty regular file (such as a pipe or terminal) is left for
+ * stream reading, in which case 0 (false) is returned.
+ */
+short map_trajectory_input(trajectoryinput *in,FILE *fileptr) {
+#ifdef POSIX_SYSTEM
+   struct stat sb;
+   void *addr;
+   if (fstat(fileno(fileptr),&sb)!=0) return 0;
+   if ((!S_ISREG(sb.st_mode))||(sb.st_size<=0)) return 0;
+   if ((off_t)((size_t)sb.st_size)!=sb.st_size) return 0; /* too large */
+   addr=mmap(NULL,(size_t)sb.st_size,PROT_READ,MAP_PRIVATE,
+      fileno(fileptr),0);
+   if (addr==MAP_FAILED) return 0;
+   posix_madvise(addr,(size_t)sb.st_size,POSIX_MADV_SEQUENTIAL);
+   (*in).fileptr=fileptr;
+   (*in).buf=(char *)addr;
+   (*in).bufsize=(*in).len=(size_t)sb.st_size;
+   (*in).pos=0;
+   (*in).linenum=1;
+   (*in).mapped=1;
+   return 1;
+#else
+   return 0;
+#endif
+} /* end of map_trajectory_input() */
+
+void initialize_trajectory_input(trajectoryinput *in,FILE *fileptr,
+      long decoderpid) {
+   (*in).decoderpid=decoderpid;
+   (*in).binary=0;
+   (*in).numbinarytrajectories=(*in).binarytrajectory=0;
+   (*in).binaryindex=NULL;
+   (*in).numread=0;
+   if ((fileptr!=NULL)&&map_trajectory_input(in,fileptr)) {
+      (*in).numread=(unsigned long)(*in).len;
+      return;
+   }
+   (*in).mapped=0;
+   (*in).fileptr=fileptr;
+   (*in).bufsize=TRAJECTORY_INPUT_BUFSIZE;
+   (*in).buf=(char *)malloc((*in).bufsize);
+   if (!(*in).buf) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "initialize_trajectory_input()\n",progname);
+      exit(FAILURE);
+   }
+   (*in).pos=(*in).len=0;
+   (*in).linenum=1;
+} /* end of initialize_trajectory_input() */
+
+/*
+ * The initialize_trajectory_text() routine sets up the input |in| for
+ * scanning the |len| characters of text kept in |buf|, as allocated by
+ * malloc() and released by close_trajectory_input(), with the first line
+ * of the text being line No |linenum| of the trajectory file. This is used
+ * by --watch, for the trajectories appended to the file since last time.
+ */
+void initialize_trajectory_text(trajectoryinput *in,char *buf,size_t len,
+      long linenum) {
+   (*in).fileptr=NULL;
+   (*in).decoderpid=0;
+   (*in).buf=buf;
+   (*in).bufsize=(*in).len=len;
+   (*in).pos=0;
+   (*in).linenum=linenum;
+   (*in).mapped=0;
+   (*in).binary=0;
+   (*in).numbinarytrajectories=(*in).binarytrajectory=0;
+   (*in).binaryindex=NULL;
+   (*in).numread=(unsigned long)len;
+} /* end of initialize_trajectory_text() */
+
+/*
+ * The read_trajectory_block() routine reads at most |n| characters from the
+ * input file into |buf|, and returns the number of characters read, or zero
+ * at end of file. On POSIX systems, read() is used instead of fread(), since
+ * it returns whatever is available rather than waiting for all |n|
+ * characters; this way trajectories streamed through a pipe are scanned as
+ * soon as they arrive.
+ */
+size_t read_trajectory_block(trajectoryinput *in,char *buf,size_t n) {
+#ifdef POSIX_SYSTEM
+   ssize_t k;
+   do {
+      k=read(fileno((*in).fileptr),buf,n);
+   } while ((k<0)&&(errno==EINTR));
+   if (k<0) {
+      fprintf(stderr,"%s: Error: Failed reading trajectory input.\n",
+         progname);
+      exit(FAILURE);
+   }
+   return((size_t)k);
+#else
+   return(fread(buf,1,n,(*in).fileptr));
+#endif
+} /* end of read_trajectory_block() */
+
+/*
+ * The close_trajectory_input() routine closes the input |in| and releases
+ * its buffer. If the input was decoded from a compressed file, whatever is
+ * left of the pipe is first read away, so that the decoder may finish, and
+ * the decoder is waited for, with the program stopped if it failed.
+ */
+void close_trajectory_input(trajectoryinput *in) {
+#ifdef POSIX_SYSTEM
+   pid_t pid;
+   int status=0;
+   if ((*in).decoderpid!=0) {
+      if (!(*in).mapped) {
+         (*in).pos=(*in).len=0;
+         while (read_trajectory_block(in,(*in).buf,(*in).bufsize)>0);
+      }
+      fclose((*in).fileptr);
+      (*in).fileptr=NULL;
+      while (((pid=waitpid((pid_t)(*in).decoderpid,&status,0))<0)
+         &&(errno==EINTR));
+      (*in).decoderpid=0;
+      if (pid<0) {
+         fprintf(stderr,"%s: Error: Lost track of the decompression "
+            "process.\n",progname);
+         exit(FAILURE);
+      }
+      if ((!WIFEXITED(status))||(WEXITSTATUS(status)!=0)) {
+         fprintf(stderr,"%s: Error: Decompression of the trajectory file "
+            "failed.\n",progname);
+         exit(FAILURE);
+      }
+   }
+#endif
+   if (((*in).fileptr!=NULL)&&((*in).fileptr!=stdin)) fclose((*in).fileptr);
+   if ((*in).binaryindex!=NULL)
+      free_lvector((*in).binaryindex,1,(*in).numbinarytrajectories);
+#ifdef POSIX_SYSTEM
+   if ((*in).mapped) {
+      munmap((void *)(*in).buf,(*in).bufsize);
+   } else {
+      free((*in).buf);
+   }
+#else
+   free((*in).buf);
+#endif
+   (*in).buf=NULL;
+   (*in).pos=(*in).len=0;
+} /* end of close_trajectory_input() */
+
+/*
+ * The refill_trajectory_input(in,n) routine makes sure that at least |n|
+ * characters are available in the window of the lexer, unless the end of
+ * the file is reached first. Any characters not yet scanned are moved to the
+ * beginning of the buffer before the next block of the file is read. The
+ * routine returns the number of characters available in the window.
+ */
+size_t refill_trajectory_input(trajectoryinput *in,size_t n) {
+   size_t k;
+   if (((*in).len-(*in).pos>=n)||((*in).fileptr==NULL)||((*in).mapped))
+      return((*in).len-(*in).pos);
+   k=(*in).len-(*in).pos;
+   if (k>0) memmove((*in).buf,(*in).buf+(*in).pos,k);
+   (*in).pos=0;
+   (*in).len=k;
+   while ((*in).len<n) {
+      k=read_trajectory_block(in,(*in).buf+(*in).len,
+         (*in).bufsize-(*in).len);
+      if (k==0) break;
+      (*in).len+=k;
+      (*in).numread+=(unsigned long)k;
+   }
+   return((*in).len-(*in).pos);
+} /* end of refill_trajectory_input() */
+
+/*
+ * The refill_trajectory_token() routine makes sure that the next token of
+ * the input, up to the first following blank, is entirely contained in the
+ * window of the lexer, provided that it is at most MAX_NUMBER_TOKENLENGTH
+ * characters long. Only as many characters as needed are waited for, so
+ * that a number at the end of a streamed trajectory is scanned as soon as
+ * its terminating blank has arrived.
+ */
+void refill_trajectory_token(trajectoryinput *in) {
+   size_t k,avail;
+   for (;;) {
+      avail=(*in).len-(*in).pos;
+      for (k=0;(k<avail)&&(k<=MAX_NUMBER_TOKENLENGTH);k++)
+         if (isspace((int)((unsigned char)(*in).buf[(*in).pos+k]))) return;
+      if (avail>MAX_NUMBER_TOKENLENGTH) return;
+      if (refill_trajectory_input(in,avail+1)<=avail) return; /* at EOF */
+   }
+} /* end of refill_trajectory_token() */
+
+/*
+ * The peek_trajectory_char() routine returns the next character of the
+ * input, without consuming it, or EOF if the end of the input is reached.
+ */
+int peek_trajectory_char(trajectoryinput *in) {
+   if (((*in).pos<(*in).len)||(refill_trajectory_input(in,1)>0))
+      return((int)((unsigned char)(*in).buf[(*in).pos]));
+   return(EOF);
+}
+
+/*
+ * The next_trajectory_char_is() routine checks whether the next character
+ * of the input is |ch|. If so, the character is consumed and 1 (true) is
+ * returned; otherwise the input is left as it is and 0 (false) is returned.
+ */
+short next_trajectory_char_is(trajectoryinput *in,int ch) {
+   if (peek_trajectory_char(in)==ch) {
+      (*in).pos++;
+      return 1;
+   }
+   return 0;
+}
+
+short new_trajectory(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'p'));
+}
+
+short end_of_trajectory(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'q'));
+}
+
+short beginlabel(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'b'));
+}
+
+short tickmark(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'t'));
+}
+
+short tickmarklabel(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'l'));
+}
+
+short endlabel(trajectoryinput *in) {
+   return(next_trajectory_char_is(in,'e'));
+}
+
+/*
+ * The readaway_comments_and_blanks(trajectoryinput *in) routine, well... ,
+ * reads away comments and blanks from the input until next alphanumeric
+ * character, including any leading sign, or until end-of-file.
+ *
+ * Important: The "(isalnum(ch)||(ch=='-')||(ch=='+'))" construction is
+ * absolutely necessary, since any preceding signs are not covered by
+ * isalnum(). Previously, isalnum() used to cover this as well, at least in
+ * the GNU development environment distributed with Linux (1996-2000) and
+ * OSX 10.3 (2003), but somehow this seems to have changed, despite that we
+ * here follow a strict ISO C90 standard.
+ *
+ * The scanning is done directly in the window of the lexer, with comments
+ * read away by memchr() rather than character by character. Since a comment
+ * may continue past the end of the window, the |incomment| flag keeps track
+ * of whether we are inside a comment as the window is refilled.
+ */
+void readaway_comments_and_blanks(trajectoryinput *in) {
+   char *p,*q,*r;
+   int ch;
+   short incomment=0;
+
+   do {
+      p=(*in).buf+(*in).pos;
+      q=(*in).buf+(*in).len;
+      while (p<q) {
+         if (incomment) { /* if inside comment, then read away the row */
+            if ((r=(char *)memchr(p,'\n',(size_t)(q-p)))==NULL) {
+               p=q;
+               break;
+            }
+            p=r;
+            incomment=0;
+         }
+         ch=(int)((unsigned char)(*p));
+         if (isalnum(ch)||(ch=='-')||(ch=='+')) {
+            (*in).pos=(size_t)(p-(*in).buf);
+            return;
+         } else if (ch=='\n') {
+            (*in).linenum++;
+         } else if (ch=='%') {
+            incomment=1;
+         }
+         p++;
+      }
+      (*in).pos=(*in).len;
+   } while (refill_trajectory_input(in,1)>0);
+}
+
+/*
+ * The scan_trajectory_word() routine scans a word of at most |maxlength|
+ * non-blank characters, after skipping any preceding blanks, into |str|.
+ * The routine returns the number of characters of the scanned word.
+ */
+int scan_trajectory_word(trajectoryinput *in,char *str,int maxlength) {
+   int ch,k=0;
+   while (((ch=peek_trajectory_char(in))!=EOF)&&isspace(ch)) {
+      if (ch=='\n') (*in).linenum++;
+      (*in).pos++;
+   }
+   while (((ch=peek_trajectory_char(in))!=EOF)&&(!isspace(ch))
+         &&(k<maxlength)) {
+      str[k++]=(char)ch;
+      (*in).pos++;
+   }
+   str[k]='\0';
+   return k;
+}
+
+/*
+ * The scan_number(in,&value) routine scans a decimal floating-point number,
+ * with optional sign, fraction and exponent, after skipping any preceding
+ * blanks, and returns 1 (true) if successful, otherwise 0 (false).
+ * This is a hand-written replacement for fscanf("%f"), which is the main
+ * cost in parsing large trajectory files. As long as the number has at most
+ * MAX_FAST_NUMBER_DIGITS significant digits (such that the decimal mantissa
+ * is exactly representable in double precision) and its decimal exponent is
+ * within +-22 (such that the power of ten is exactly representable as well),
+ * the conversion is done by a single multiplication or division, which
+ * hence is correctly rounded. This covers all practical trajectory data;
+ * any other number is handed over to strtod() instead.
+ */
+short scan_number(trajectoryinput *in,double *value) {
+   static const double pow10[23]={1.0e0,1.0e1,1.0e2,1.0e3,1.0e4,1.0e5,1.0e6,
+      1.0e7,1.0e8,1.0e9,1.0e10,1.0e11,1.0e12,1.0e13,1.0e14,1.0e15,1.0e16,
+      1.0e17,1.0e18,1.0e19,1.0e20,1.0e21,1.0e22};
+   char tmpstr[MAX_NUMBER_TOKENLENGTH+1],*p,*q,*r,*start;
+   double mantissa;
+   int ch,ndigits,exp10,expval,expsign;
+   short negative,anydigits,slow;
+
+   while (((ch=peek_trajectory_char(in))!=EOF)&&isspace(ch)) {
+      if (ch=='\n') (*in).linenum++;
+      (*in).pos++;
+   }
+   refill_trajectory_token(in);
+   start=p=(*in).buf+(*in).pos;
+   q=(*in).buf+(*in).len;
+   negative=anydigits=slow=0;
+   mantissa=0.0;
+   ndigits=exp10=0;
+   if ((p<q)&&((*p=='-')||(*p=='+'))) negative=(*(p++)=='-');
+   while ((p<q)&&isdigit((int)((unsigned char)(*p)))) {
+      anydigits=1;
+      if ((ndigits>0)||(*p!='0')) {
+         if (ndigits<MAX_FAST_NUMBER_DIGITS) {
+            mantissa=10.0*mantissa+(double)(*p-'0');
+            ndigits++;
+         } else {
+            slow=1;
+         }
+      }
+      p++;
+   }
+   if ((p<q)&&(*p=='.')) {
+      p++;
+      while ((p<q)&&isdigit((int)((unsigned char)(*p)))) {
+         anydigits=1;
+         if ((ndigits>0)||(*p!='0')) {
+            if (ndigits<MAX_FAST_NUMBER_DIGITS) {
+               mantissa=10.0*mantissa+(double)(*p-'0');
+               ndigits++;
+            } else {
+               slow=1;
+            }
+         }
+         exp10--;
+         p++;
+      }
+   }
+   if (!anydigits) return 0;
+   if ((p<q)&&((*p=='e')||(*p=='E'))) {
+      r=p+1;
+      expsign=1;
+      if ((r<q)&&((*r=='-')||(*r=='+'))) expsign=((*(r++)=='-')?-1:1);
+      if ((r<q)&&isdigit((int)((unsigned char)(*r)))) {
+         expval=0;
+         while ((r<q)&&isdigit((int)((unsigned char)(*r)))) {
+            if (expval<10000) expval=10*expval+(*r-'0');
+            r++;
+         }
+         exp10+=expsign*expval;
+         p=r;
+      }
+   }
+   if ((!slow)&&(-22<=exp10)&&(exp10<=22)) {
+      *value=((exp10<0)?mantissa/pow10[-exp10]:mantissa*pow10[exp10]);
+      if (negative) *value=-(*value);
+   } else {
+      if (p-start>MAX_NUMBER_TOKENLENGTH) return 0;
+      memcpy(tmpstr,start,(size_t)(p-start));
+      tmpstr[p-start]='\0';
+      *value=strtod(tmpstr,NULL);
+   }
+   (*in).pos=(size_t)(p-(*in).buf);
+   return 1;
+}
+
+void scan_label(trajectoryinput *in,stoketraject *st,pmap *map,
+      long coordnum) {
+   char tmpstr[256];
+   int ch,k;
+   short pos;
+
+   /* Scan for positioning of label */
+   readaway_comments_and_blanks(in);
+   if ((*map).verbose) {
+      fprintf(stdout,
+         "%s: Scanning label text starting at line %ld of trajectory file\n",
+            progname,(*in).linenum);
+   }
+   if (scan_trajectory_word(in,tmpstr,255)==0) {
+      fprintf(stderr,"Failed scanning label position!\n");
+      exit(FAILURE);
+   }
+   if (!strcmp(tmpstr,"top")) {
+      pos=TOPLABEL;
+   } else if (!strcmp(tmpstr,"ulft")) {
+      pos=UPPERLEFTLABEL;
+   } else if (!strcmp(tmpstr,"lft")) {
+      pos=LEFTLABEL;
+   } else if (!strcmp(tmpstr,"llft")) {
+      pos=LOWERLEFTLABEL;
+   } else if (!strcmp(tmpstr,"bot")) {
+      pos=BOTTOMLABEL;
+   } else if (!strcmp(tmpstr,"lrgt")) {
+      pos=LOWERRIGHTLABEL;
+   } else if (!strcmp(tmpstr,"rgt")) {
+      pos=RIGHTLABEL;
+   } else if (!strcmp(tmpstr,"urgt")) {
+      pos=UPPERRIGHTLABEL;
+   } else {
+      fprintf(stderr,
+         "%s: Invalid string '%s' found at line %ld of trajectory file.\n",
+            progname,tmpstr,(*in).linenum);
+      exit(1);
+   }
+   if ((*map).verbose) {
+      fprintf(stdout,
+         "%s: Scanned label positioning '%s' at line %ld of trajectory file\n",
+            progname,tmpstr,(*in).linenum);
+   }
+
+   /* Scan for label string to be printed, directly into the label arena */
+   while (next_trajectory_char_is(in,' '));
+   if ((ch=peek_trajectory_char(in))!='\"') {
+      fprintf(stderr,"%s: Error in line %ld of trajectory file. [ch=%c]\n",
+         progname,(*in).linenum,ch);
+      fprintf(stderr,"%s: Use enclosing quote marks (\") around label text.\n",
+         progname);
+      exit(1);
+   }
+   (*in).pos++;
+   add_label((*st).labels,coordnum,pos);
+   k=0;
+   while ((ch=peek_trajectory_char(in))!='\"') {
+      k++;
+      if ((ch!='\n')&&(ch!=EOF)&&(k<MAX_LABEL_TEXTLENGTH)) {
+         add_label_char((*st).labels,ch);
+         (*in).pos++;
+      } else if (k>=MAX_LABEL_TEXTLENGTH) {
+         fprintf(stderr,
+            "%s: Error: Label text at line %ld exceeds %d characters.\n",
+            progname,(*in).linenum,MAX_LABEL_TEXTLENGTH-1);
+         exit(1);
+      } else {
+         fprintf(stderr,
+            "%s: Error: Reached end of line %ld without closing quote mark.\n",
+            progname,(*in).linenum);
+         fprintf(stderr,"%s: (Check this label statement.)\n",progname);
+         exit(1);
+      }
+   }
+   (*in).pos++;
+   if (k>0) { /* empty labels are not drawn, and hence not kept */
+      (*st).numlabels++;
+   } else {
+      drop_last_label((*st).labels);
+   }
+}
+
+/*
+The scan_beginlabel() scans for a label string immediatelty after a
+statement for a new trajectory, and adds the string text, string length,
+and label position relative the first point to the labels of the data
+structure st, as does scan_endlabel() for the label of the last point.
+The routines use the more general scan_label() routine for the
+implementation, in order to keep a comapct and consistent behaviour of the
+algorithm.
+*/
+void scan_beginlabel(trajectoryinput *in,stoketraject *st,pmap *map,
+      long coordnum) {
+   scan_label(in,st,map,coordnum);
+}
+
+void scan_endlabel(trajectoryinput *in,stoketraject *st,pmap *map,
+      long coordnum) {
+   scan_label(in,st,map,coordnum);
+}
+
+/*
+ * The display_last_label() routine displays the text of the label last
+ * scanned into the label arena |a|, in verbose mode.
+ */
+void display_last_label(labelarena *a,const char *kind) {
+   long k;
+   fprintf(stdout,"%s: Parsed %s label string '",progname,kind);
+   for (k=0;k<(*a).length[(*a).numlabels];k++)
+      fprintf(stdout,"%c",(*a).text[(*a).offset[(*a).numlabels]+k]);
+   fprintf(stdout,"' [%d characters]\n",(*a).length[(*a).numlabels]);
+}
+
+/*------------------------------------------------------------------------
+| In this routine we do not only like to access the numerical values of the
+| input data structure <st> which contains all information of the Stokes
+| vector trajectory, but we also wish to update the values.
+| Hence this routine takes a pointer to the structure as input, and internally
+| dereferences this pointer whenever a value is to be updated. Typical
+| usage of the routine, for example as when called from within the
+| scan_trajectory_file routine, is:
+|    stoketraject st;
+|    trajectoryinput in;
+|    initialize_stoke_trajectory(&st);
+|    infileptr=open_infile(map,&decoderpid);
+|    initialize_trajectory_input(&in,infileptr,decoderpid);
+|    scan_for_stokes_triplet(&in,&st);
+|        . . .
+| The Stokes parameters are scanned in full double precision.
+------------------------------------------------------------------------*/
+/*
+ * The scan_stokes_triplet() routine scans the next triplet (s1,s2,s3) of
+ * Stokes parameters, which scan_for_stokes_triplet() then adds to the
+ * trajectory |st|.
+ */
+void scan_stokes_triplet(trajectoryinput *in,double *s1,double *s2,
+      double *s3) {
+   long linenum=(*in).linenum; /* the line where the triplet starts */
+   if (!scan_number(in,s1)) {
+      fprintf(stderr,"%s: Error: Faulty S1 in line %ld of trajectory file.\n",
+         progname,linenum);
+      exit(1);
+   }
+   if (!scan_number(in,s2)) {
+      fprintf(stderr,"%s: Error: Faulty S2 in line %ld of trajectory file.\n",
+         progname,linenum);
+      exit(1);
+   }
+   if (!scan_number(in,s3)) {
+      fprintf(stderr,"%s: Error: Faulty S3 in line %ld of trajectory file.\n",
+         progname,linenum);
+      exit(1);
+   }
+}
+
+void scan_for_stokes_triplet(trajectoryinput *in,stoketraject *st) {
+   double s1,s2,s3;
+   scan_stokes_triplet(in,&s1,&s2,&s3);
+   if ((*st).numcoords>=(*st).maxcoords) grow_stoke_coordinates(st);
+   ((*st).numcoords)++;
+   (*st).s1[(*st).numcoords]=s1;
+   (*st).s2[(*st).numcoords]=s2;
+   (*st).s3[(*st).numcoords]=s3;
+}
+
+short visible(double s1,double s2,double s3,pmap *map) {
+   double vprod;
+   vprod=(*map).view[2][0]*s1+(*map).view[2][1]*s2+(*map).view[2][2]*s3;
+   if (vprod>=0.0) { /* point (s1,s2,s3) located in visible region */
+      return 1;
+   } else { /* point (s1,s2,s3) located in hidden region */
+      return 0;
+   }
+}
+
+/*
+ * The get_screen_coordinates() routine calculates the projected screen
+ * coordinates (x,y) in the image from a Stokes triplet (s1,s2,s3).
+ * In order to update the output parameters we use these as pointers,
+ * to give a behaviour as when using reference variables in languages
+ * as Pascal.
+ */
+void get_screen_coordinates(double *x,double *y,
+      double s1,double s2,double s3,pmap *map) {
+   double snorm;
+   (*x)=(*map).view[0][0]*s1+(*map).view[0][1]*s2;
+   (*y)=(*map).view[1][0]*s1+(*map).view[1][1]*s2+(*map).view[1][2]*s3;
+   if ((*map).use_normalized_stokes_params) {
+      snorm=sqrt(s1*s1+s2*s2+s3*s3);
+      (*x)=(*x)/snorm;
+      (*y)=(*y)/snorm;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the density grid of --density. The add_density_point() routine
+| bins the last point scanned into |st|, after which the point is dropped
+| from |st|, so that no points are kept in memory while scanning, and the
+| add_density_trajectory() routine bins all points of |st|, as read from a
+| binary trajectory file.
+-----------------------------------------------------------------------------*/
+void initialize_density_grid(densitygrid *g,int numbands) {
+   long k;
+   (*g).numbands=numbands;
+   (*g).numsectors=2*numbands;
+   (*g).count=lvector(1,(long)(*g).numbands*(*g).numsectors);
+   for (k=1;k<=(long)(*g).numbands*(*g).numsectors;k++) (*g).count[k]=0;
+   (*g).maxcount=0;
+   (*g).numpoints=0;
+}
+
+void free_density_grid(densitygrid *g) {
+   free_lvector((*g).count,1,(long)(*g).numbands*(*g).numsectors);
+}
+
+void bin_density_point(densitygrid *g,double s1,double s2,double s3) {
+   double r=sqrt(s1*s1+s2*s2+s3*s3);
+   int i,j;
+   long k;
+   if (!(r>0.0)) return; /* no direction to bin by */
+   i=1+(int)floor(0.5*(s3/r+1.0)*(*g).numbands);
+   j=1+(int)floor((atan2(s2,s1)+PI)*(*g).numsectors/(2.0*PI));
+   if (i<1) i=1;
+   if (i>(*g).numbands) i=(*g).numbands;
+   if (j<1) j=1;
+   if (j>(*g).numsectors) j=(*g).numsectors;
+   k=(long)(i-1)*(*g).numsectors+j;
+   if (++((*g).count[k])>(*g).maxcount) (*g).maxcount=(*g).count[k];
+   (*g).numpoints++;
+}
+
+void add_density_point(densitygrid *g,stoketraject *st) {
+   bin_density_point(g,(*st).s1[(*st).numcoords],(*st).s2[(*st).numcoords],
+      (*st).s3[(*st).numcoords]);
+   (*st).numcoords=0;
+   (*st).numtickmarks=0;
+}
+
+void add_density_trajectory(densitygrid *g,stoketraject *st) {
+   long k;
+   for (k=1;k<=(*st).numcoords;k++)
+      bin_density_point(g,(*st).s1[k],(*st).s2[k],(*st).s3[k]);
+}
+
+/*
+ * The mark_fixed_points() routine sets |fixed[k]| to 1 for the points of
+ * the sub-trajectory |ka..kb| of |st| carrying tick marks or labels, which
+ * are to be kept as they are in any simplification or fit of the path, and
+ * to 0 for all other points.
+ */
+void mark_fixed_points(short *fixed,stoketraject *st,long int ka,
+      long int kb) {
+   long int k;
+   for (k=ka;k<=kb;k++) fixed[k]=0;
+   for (k=1;k<=(*st).numtickmarks;k++)
+      if ((ka<=(*st).tickmark[k])&&((*st).tickmark[k]<=kb))
+         fixed[(*st).tickmark[k]]=1;
+   for (k=1;k<=(*st).numautoticks;k++)
+      if ((ka<=(*st).autotick[k])&&((*st).autotick[k]<=kb))
+         fixed[(*st).autotick[k]]=1;
+   for (k=(*st).firstlabel+1;k<=(*st).firstlabel+(*st).numlabels;k++)
+      if ((ka<=(*(*st).labels).coord[k])&&((*(*st).labels).coord[k]<=kb))
+         fixed[(*(*st).labels).coord[k]]=1;
+}
+
+/*-----------------------------------------------------------------------------
+| The simplify_subtrajectory() routine selects which points of the
+| sub-trajectory |ka..kb| of |st| are to be written, by setting |keep[k]|
+| to 1 for the points to keep and to 0 for the points to omit. The
+| selection is made by the Douglas-Peucker algorithm, operating on the
+| projected screen coordinates |x[]| and |y[]|, such that no omitted point
+| deviates more than the tolerance |(*map).simplify_tolerance| (in pt) from
+| the simplified path as seen in the figure. The end points, as well as all
+| points carrying tick marks or labels, are always kept, and serve as fixed
+| break points of the simplification. Instead of recursion, the segments
+| yet to be examined are kept on an explicit stack.
+-----------------------------------------------------------------------------*/
+void simplify_subtrajectory(short *keep,stoketraject *st,
+      long int ka,long int kb,pmap *map) {
+   long int i,j,k,kmax,*stack,top;
+   double tol,dx,dy,len2,d,dmax;
+
+   /* Tolerance in units of the radius, that is, of the screen coordinates */
+   tol=(*map).simplify_tolerance/((*map).scalefactor*(72.0/25.4));
+   mark_fixed_points(keep,st,ka,kb);
+   keep[ka]=keep[kb]=1;
+   stack=lvector(1,2*(kb-ka+1));
+   top=0;
+   for (i=ka,j=ka+1;j<=kb;j++) { /* push segments between fixed points */
+      if (keep[j]) {
+         if (j>i+1) {
+            stack[++top]=i;
+            stack[++top]=j;
+         }
+         i=j;
+      }
+   }
+   while (top>0) {
+      j=stack[top--];
+      i=stack[top--];
+      dx=(*st).x[j]-(*st).x[i];
+      dy=(*st).y[j]-(*st).y[i];
+      len2=dx*dx+dy*dy;
+      dmax=-1.0;
+      kmax=i;
+      for (k=i+1;k<j;k++) { /* squared distance from segment line times len2 */
+         if (len2>0.0) {
+            d=dx*((*st).y[k]-(*st).y[i])-dy*((*st).x[k]-(*st).x[i]);
+            d=d*d;
+         } else {
+            d=((*st).x[k]-(*st).x[i])*((*st).x[k]-(*st).x[i])
+               +((*st).y[k]-(*st).y[i])*((*st).y[k]-(*st).y[i]);
+         }
+         if (d>dmax) {
+            dmax=d;
+            kmax=k;
+         }
+      }
+      if (dmax>tol*tol*((len2>0.0)?len2:1.0)) {
+         keep[kmax]=1;
+         if (kmax>i+1) {
+            stack[++top]=i;
+            stack[++top]=kmax;
+         }
+         if (j>kmax+1) {
+            stack[++top]=kmax;
+            stack[++top]=j;
+         }
+      }
+   }
+   free_lvector(stack,1,2*(kb-ka+1));
+} /* end of simplify_subtrajectory() */
+
+/*-----------------------------------------------------------------------------
+| Routines for the least-squares fitting of cubic Bezier curves to the
+| points of the paths to draw, as selected by the --fit option, following
+| the algorithm of P. J. Schneider ("An Algorithm for Automatically Fitting
+| Digitized Curves", Graphics Gems, Academic Press, 1990). The control points
+| of a cubic segment are kept as |bx[0..3]| and |by[0..3]|.
+|
+| The bezier_point() routine evaluates the cubic segment of degree |degree|
+| (used with 3, 2 and 1 for the curve itself and for its first and second
+| derivatives) with control points |bx[]|,|by[]| at the parameter |u|.
+-----------------------------------------------------------------------------*/
+void bezier_point(double *bx,double *by,int degree,double u,
+      double *qx,double *qy) {
+   double vx[4],vy[4];
+   int i,j;
+   for (i=0;i<=degree;i++) {
+      vx[i]=bx[i];
+      vy[i]=by[i];
+   }
+   for (i=1;i<=degree;i++) { /* de Casteljau */
+      for (j=0;j<=degree-i;j++) {
+         vx[j]=(1.0-u)*vx[j]+u*vx[j+1];
+         vy[j]=(1.0-u)*vy[j]+u*vy[j+1];
+      }
+   }
+   *qx=vx[0];
+   *qy=vy[0];
+}
+
+/*
+ * The unit_tangent() routine sets |(*tx,*ty)| to the unit vector pointing
+ * from point No |i| to point No |j| of |x[]|,|y[]|, or to the null vector if
+ * the points coincide.
+ */
+void unit_tangent(double *x,double *y,long i,long j,double *tx,double *ty) {
+   double d;
+   *tx=x[j]-x[i];
+   *ty=y[j]-y[i];
+   d=sqrt((*tx)*(*tx)+(*ty)*(*ty));
+   if (d>0.0) {
+      *tx/=d;
+      *ty/=d;
+   }
+}
+
+/*
+ * The center_tangent() routine sets |(*tx,*ty)| to the unit tangent at the
+ * inner point No |k| of |x[]|,|y[]|, pointing backwards along the path, as
+ * the mean of the directions to its neighbours.
+ */
+void center_tangent(double *x,double *y,long k,double *tx,double *ty) {
+   double d;
+   *tx=x[k-1]-x[k+1];
+   *ty=y[k-1]-y[k+1];
+   d=sqrt((*tx)*(*tx)+(*ty)*(*ty));
+   if (d>0.0) {
+      *tx/=d;
+      *ty/=d;
+   }
+}
+
+/*
+ * The chord_length_parameters() routine assigns the parameters |u[i]| of
+ * the points |first..last| in proportion to the length of the polygon up to
+ * each point, running from 0 to 1.
+ */
+void chord_length_parameters(double *x,double *y,double *u,long first,
+      long last) {
+   long i;
+   u[first]=0.0;
+   for (i=first+1;i<=last;i++)
+      u[i]=u[i-1]+sqrt((x[i]-x[i-1])*(x[i]-x[i-1])+(y[i]-y[i-1])*(y[i]-y[i-1]));
+   for (i=first+1;i<=last;i++)
+      u[i]=((u[last]>0.0)?u[i]/u[last]:((double)(i-first))/(last-first));
+}
+
+/*-----------------------------------------------------------------------------
+| The generate_bezier_segment() routine sets |bx[]|,|by[]| to the cubic
+| segment from point No |first| to point No |last| with the unit tangents
+| |(t1x,t1y)| and |(t2x,t2y)| at its ends, whose control points along these
+| tangents are placed so as to minimize the sum of the squared distances of
+| the points |first..last|, at their parameters |u[]|, from the curve. If
+| the least-squares solution is degenerate, the control points are placed
+| at a third of the chord from the end points instead.
+-----------------------------------------------------------------------------*/
+void generate_bezier_segment(double *x,double *y,double *u,long first,
+      long last,double t1x,double t1y,double t2x,double t2y,
+      double *bx,double *by) {
+   double c00=0.0,c01=0.0,c11=0.0,x0=0.0,x1=0.0,a0x,a0y,a1x,a1y;
+   double b0,b1,b2,b3,tx,ty,det,alpha1=0.0,alpha2=0.0,chord,eps;
+   long i;
+
+   for (i=first;i<=last;i++) {
+      b0=(1.0-u[i])*(1.0-u[i])*(1.0-u[i]);
+      b1=3.0*u[i]*(1.0-u[i])*(1.0-u[i]);
+      b2=3.0*u[i]*u[i]*(1.0-u[i]);
+      b3=u[i]*u[i]*u[i];
+      a0x=t1x*b1;
+      a0y=t1y*b1;
+      a1x=t2x*b2;
+      a1y=t2y*b2;
+      c00+=a0x*a0x+a0y*a0y;
+      c01+=a0x*a1x+a0y*a1y;
+      c11+=a1x*a1x+a1y*a1y;
+      tx=x[i]-(b0+b1)*x[first]-(b2+b3)*x[last];
+      ty=y[i]-(b0+b1)*y[first]-(b2+b3)*y[last];
+      x0+=a0x*tx+a0y*ty;
+      x1+=a1x*tx+a1y*ty;
+   }
+   det=c00*c11-c01*c01;
+   if (det!=0.0) {
+      alpha1=(x0*c11-x1*c01)/det;
+      alpha2=(c00*x1-c01*x0)/det;
+   }
+   chord=sqrt((x[last]-x[first])*(x[last]-x[first])
+      +(y[last]-y[first])*(y[last]-y[first]));
+   eps=1.0e-6*chord;
+   if ((alpha1<eps)||(alpha2<eps)) alpha1=alpha2=chord/3.0;
+   bx[0]=x[first];
+   by[0]=y[first];
+   bx[1]=x[first]+alpha1*t1x;
+   by[1]=y[first]+alpha1*t1y;
+   bx[2]=x[last]+alpha2*t2x;
+   by[2]=y[last]+alpha2*t2y;
+   bx[3]=x[last];
+   by[3]=y[last];
+}
+
+/*
+ * The bezier_fit_error() routine returns the largest squared distance of
+ * the inner points |first+1..last-1| from the cubic segment |bx[]|,|by[]| at
+ * their parameters |u[]|, with the point of largest distance in |*split|.
+ */
+double bezier_fit_error(double *x,double *y,double *u,long first,long last,
+      double *bx,double *by,long *split) {
+   double qx,qy,d,dmax=0.0;
+   long i;
+   *split=(first+last)/2;
+   for (i=first+1;i<last;i++) {
+      bezier_point(bx,by,3,u[i],&qx,&qy);
+      d=(qx-x[i])*(qx-x[i])+(qy-y[i])*(qy-y[i]);
+      if (d>dmax) {
+         dmax=d;
+         *split=i;
+      }
+   }
+   return(dmax);
+}
+
+/*
+ * The reparameterize_bezier() routine improves the parameters |u[]| of the
+ * points |first..last| with one Newton-Raphson step each, towards the
+ * parameters of the points of the segment |bx[]|,|by[]| closest to them.
+ */
+void reparameterize_bezier(double *x,double *y,double *u,long first,
+      long last,double *bx,double *by) {
+   double dx[3],dy[3],ddx[2],ddy[2],qx,qy,q1x,q1y,q2x,q2y,num,den;
+   long i;
+   int j;
+   for (j=0;j<3;j++) {
+      dx[j]=3.0*(bx[j+1]-bx[j]);
+      dy[j]=3.0*(by[j+1]-by[j]);
+   }
+   for (j=0;j<2;j++) {
+      ddx[j]=2.0*(dx[j+1]-dx[j]);
+      ddy[j]=2.0*(dy[j+1]-dy[j]);
+   }
+   for (i=first+1;i<last;i++) {
+      bezier_point(bx,by,3,u[i],&qx,&qy);
+      bezier_point(dx,dy,2,u[i],&q1x,&q1y);
+      bezier_point(ddx,ddy,1,u[i],&q2x,&q2y);
+      num=(qx-x[i])*q1x+(qy-y[i])*q1y;
+      den=q1x*q1x+q1y*q1y+(qx-x[i])*q2x+(qy-y[i])*q2y;
+      if (den!=0.0) u[i]-=num/den;
+      if (u[i]<0.0) u[i]=0.0;
+      if (u[i]>1.0) u[i]=1.0;
+   }
+}
+
+/*-----------------------------------------------------------------------------
+| The fit_bezier_path() routine fits a sequence of cubic Bezier segments,
+| joined with continuous tangents, to the points |x[1..n]|,|y[1..n]|, such
+| that no point deviates more than |tol| from the curve. The points with
+| |fixed[k]| set (if |fixed| is not NULL), as well as the end points, are
+| knots of the curve. On return, |knot[k]| is set for every point being the
+| end of a segment, whose control points then are |(c1x[k],c1y[k])| and
+| |(c2x[k],c2y[k])|; the first segment starts at point No 1.
+|
+| The points between consecutive knots are first fitted with a single
+| segment, using tangents estimated from the neighbouring points. If the
+| fit deviates more than |tol|, but less than four times as much, the
+| parameters of the points are improved by reparameterize_bezier() and the
+| segment is fitted again, at most MAX_BEZIER_ITERATIONS times; if it still
+| deviates too much, the points are split at the point of largest
+| deviation, which becomes a knot. Instead of recursion, the spans yet to be
+| fitted are kept on an explicit stack, just as in simplify_subtrajectory().
+-----------------------------------------------------------------------------*/
+void fit_bezier_path(double *x,double *y,short *fixed,long n,double tol,
+      short *knot,double *c1x,double *c1y,double *c2x,double *c2y) {
+   long i,j,k,split,*stack,top;
+   double *u,bx[4],by[4],t1x,t1y,t2x,t2y,err;
+   int iter;
+
+   for (k=1;k<=n;k++) knot[k]=((k==1)||(k==n)||((fixed!=NULL)&&fixed[k]));
+   if (n<2) return;
+   u=dvector(1,n);
+   stack=lvector(1,2*n);
+   top=0;
+   for (i=1,j=2;j<=n;j++) { /* push spans between fixed knots */
+      if (knot[j]) {
+         stack[++top]=i;
+         stack[++top]=j;
+         i=j;
+      }
+   }
+   while (top>0) {
+      j=stack[top--];
+      i=stack[top--];
+      if (i>1) { /* tangents continuous across inner knots */
+         center_tangent(x,y,i,&t1x,&t1y);
+         t1x=-t1x;
+         t1y=-t1y;
+      } else {
+         unit_tangent(x,y,i,i+1,&t1x,&t1y);
+      }
+      if (j<n) {
+         center_tangent(x,y,j,&t2x,&t2y);
+      } else {
+         unit_tangent(x,y,j,j-1,&t2x,&t2y);
+      }
+      chord_length_parameters(x,y,u,i,j);
+      generate_bezier_segment(x,y,u,i,j,t1x,t1y,t2x,t2y,bx,by);
+      err=bezier_fit_error(x,y,u,i,j,bx,by,&split);
+      for (iter=0;(err>tol*tol)&&(err<16.0*tol*tol)
+            &&(iter<MAX_BEZIER_ITERATIONS);iter++) {
+         reparameterize_bezier(x,y,u,i,j,bx,by);
+         generate_bezier_segment(x,y,u,i,j,t1x,t1y,t2x,t2y,bx,by);
+         err=bezier_fit_error(x,y,u,i,j,bx,by,&split);
+      }
+      if ((err>tol*tol)&&(j>i+1)) { /* split the span at the worst point */
+         knot[split]=1;
+         stack[++top]=i;
+         stack[++top]=split;
+         stack[++top]=split;
+         stack[++top]=j;
+      } else {
+         c1x[j]=bx[1];
+         c1y[j]=by[1];
+         c2x[j]=bx[2];
+         c2y[j]=by[2];
+      }
+   }
+   free_lvector(stack,1,2*n);
+   free_dvector(u,1,n);
+} /* end of fit_bezier_path() */
+
+/*-----------------------------------------------------------------------------
+| Routines for the |bezierpath| of the --fit option. The fit_subtrajectory()
+| routine collects the points of the sub-trajectory |ka..kb| of |st| to be
+| drawn (all of them, or only those kept by simplify_subtrajectory() if
+| |keep| is not NULL), at the scale |scale| of the output, and fits cubic
+| Bezier segments to them within the tolerance of --fit, in the units of the
+| figure, with the points carrying tick marks or labels as fixed knots.
+-----------------------------------------------------------------------------*/
+void allocate_bezier_path(bezierpath *bp,long maxpoints) {
+   (*bp).n=0;
+   (*bp).maxpoints=maxpoints;
+   (*bp).x=dvector(1,maxpoints);
+   (*bp).y=dvector(1,maxpoints);
+   (*bp).c1x=dvector(1,maxpoints);
+   (*bp).c1y=dvector(1,maxpoints);
+   (*bp).c2x=dvector(1,maxpoints);
+   (*bp).c2y=dvector(1,maxpoints);
+   (*bp).fixed=svector(1,maxpoints);
+   (*bp).knot=svector(1,maxpoints);
+}
+
+void free_bezier_path(bezierpath *bp) {
+   free_dvector((*bp).x,1,(*bp).maxpoints);
+   free_dvector((*bp).y,1,(*bp).maxpoints);
+   free_dvector((*bp).c1x,1,(*bp).maxpoints);
+   free_dvector((*bp).c1y,1,(*bp).maxpoints);
+   free_dvector((*bp).c2x,1,(*bp).maxpoints);
+   free_dvector((*bp).c2y,1,(*bp).maxpoints);
+   free_svector((*bp).fixed,1,(*bp).maxpoints);
+   free_svector((*bp).knot,1,(*bp).maxpoints);
+}
+
+void fit_subtrajectory(bezierpath *bp,stoketraject *st,long int ka,
+      long int kb,short *keep,pmap *map,double scale) {
+   short *fixed;
+   long int k;
+
+   fixed=svector(ka,kb);
+   mark_fixed_points(fixed,st,ka,kb);
+   (*bp).n=0;
+   for (k=ka;k<=kb;k++) {
+      if ((keep!=NULL)&&(!keep[k])) continue; /* omitted by simplify */
+      (*bp).n++;
+      (*bp).x[(*bp).n]=scale*(*st).x[k];
+      (*bp).y[(*bp).n]=scale*(*st).y[k];
+      (*bp).fixed[(*bp).n]=fixed[k];
+   }
+   free_svector(fixed,ka,kb);
+   fit_bezier_path((*bp).x,(*bp).y,(*bp).fixed,(*bp).n,
+      (*map).fit_tolerance*scale/((*map).scalefactor*BP_PER_MM),(*bp).knot,
+      (*bp).c1x,(*bp).c1y,(*bp).c2x,(*bp).c2y);
+}
+
+/*-----------------------------------------------------------------------------
+| The add_native_subtrajectory() routine is the counterpart of
+| |add_subtrajectory()| for the native vector output, drawing the
+| sub-trajectory |ka..kb| of |st| as a single path, with an arrow head at its
+| end (or, for reversed arrow paths, at its beginning) if it ends the
+| trajectory and the paths are to be drawn as arrows. With --fit, the path
+| is drawn as the cubic segments fitted by fit_subtrajectory().
+-----------------------------------------------------------------------------*/
+void add_native_subtrajectory(mpbuffer *out,stoketraject *st,
+      long int ka,long int kb,pmap *map,short type) {
+   long int k,n;
+   short *keep=NULL,dashed=0;
+   double *x,*y,gray=0.0,radius=(*map).scalefactor*BP_PER_MM,width;
+   bezierpath bp;
+
+   if (ka>=kb) return; /* only draw paths of two points or more */
+   if ((*map).simplify_tolerance>0.0) {
+      keep=svector(ka,kb);
+      simplify_subtrajectory(keep,st,ka,kb,map);
+   }
+   x=dvector(1,kb-ka+1);
+   y=dvector(1,kb-ka+1);
+   for (k=ka,n=0;k<=kb;k++) {
+      if ((keep!=NULL)&&(!keep[k])) continue; /* omitted by simplify */
+      n++;
+      x[n]=radius*(*st).x[k];
+      y[n]=radius*(*st).y[k];
+   }
+   if (type==HIDDEN) {
+      dashed=(*map).draw_hidden_dashed;
+      gray=((dashed)?0.0:(*map).hiddengraytone);
+   }
+   width=(*map).paththickness*BP_PER_PT;
+   if ((*map).fit_tolerance>0.0) {
+      allocate_bezier_path(&bp,kb-ka+1);
+      fit_subtrajectory(&bp,st,ka,kb,keep,map,radius);
+      vec_begin_path(out,gray,width,dashed,0);
+      vec_moveto(out,bp.x[1],bp.y[1]);
+      for (k=2;k<=bp.n;k++)
+         if (bp.knot[k])
+            vec_curveto(out,bp.c1x[k],bp.c1y[k],bp.c2x[k],bp.c2y[k],
+               bp.x[k],bp.y[k]);
+      vec_end_path(out,gray,width,dashed,0);
+      free_bezier_path(&bp);
+   } else {
+      vec_stroke(out,x,y,n,(*map).use_bezier_curves,gray,width,dashed);
+   }
+   if ((kb==(*st).numcoords)&&((*map).draw_paths_as_arrows)) {
+      if ((*map).reverse_arrow_paths) {
+         vec_arrowhead(out,x[1],y[1],x[2],y[2],(*map).arrowheadangle,gray);
+      } else {
+         vec_arrowhead(out,x[n],y[n],x[n-1],y[n-1],(*map).arrowheadangle,
+            gray);
+      }
+   }
+   free_dvector(x,1,kb-ka+1);
+   free_dvector(y,1,kb-ka+1);
+   if (keep!=NULL) free_svector(keep,ka,kb);
+}
+
+/*
+ * The add_path_drawing() routine writes the MetaPost statement drawing the
+ * path |p|, as an arrow if |arrow| is set, in the style of the hidden or
+ * visible layer as given by |type|.
+ */
+void add_path_drawing(mpbuffer *out,short arrow,pmap *map,short type) {
+   if (arrow) {
+      if ((*map).reverse_arrow_paths) {
+         mp_printf(out,"   drawarrow reverse p scaled radius");
+      } else {
+         mp_printf(out,"   drawarrow p scaled radius");
+      }
+   } else {
+      mp_printf(out,"   draw p scaled radius");
+   }
+   if (type==HIDDEN) { /* end of a hidden segment */
+      if ((*map).draw_hidden_dashed) {
+         mp_printf(out," dashed evenly withcolor black;\n");
+      } else {
+         mp_printf(out," withcolor %f [black,white];\n",
+            (*map).hiddengraytone);
+      }
+   } else { /* end of a visible segment */
+      mp_printf(out," withcolor black;\n");
+   }
+}
+
+/*
+ * The mp_pair() routine writes the pair |(x,y)| of MetaPost code, with the
+ * coordinates given with four decimals.
+ */
+void mp_pair(mpbuffer *out,double x,double y) {
+   mp_putc(out,'(');
+   mp_fixed(out,x,4);
+   mp_putc(out,',');
+   mp_fixed(out,y,4);
+   mp_putc(out,')');
+}
+
+/*
+ * The mp_direction() routine writes the direction |{(dx,dy)}| of MetaPost
+ * code, normalized to unit length, unless it is the zero vector.
+ */
+void mp_direction(mpbuffer *out,double dx,double dy) {
+   double r=sqrt(dx*dx+dy*dy);
+   if (r<=0.0) return;
+   mp_putc(out,'{');
+   mp_pair(out,dx/r,dy/r);
+   mp_putc(out,'}');
+}
+
+/*
+ * The add_path_chunk_end() routine ends the path |p| of MetaPost code at a
+ * split of a long sub-trajectory into several paths, as by add_subtrajectory()
+ * and add_fitted_subtrajectory(), drawing it (with an arrow head only if
+ * |arrow| is set) and starting the next path at the joining point |(x,y)|,
+ * with the direction |(dx,dy)| there, if nonzero.
+ */
+void add_path_chunk_end(mpbuffer *out,short arrow,pmap *map,short type,
+      double x,double y,double dx,double dy) {
+   mp_printf(out,";\n");
+   add_path_drawing(out,arrow,map,type);
+   mp_printf(out,"   p := makepath makepen ");
+   mp_pair(out,x,y);
+   mp_direction(out,dx,dy);
+}
+
+/*
+ * The add_fitted_subtrajectory() routine writes the sub-trajectory |ka..kb|
+ * of |st| as the path |p| of cubic segments with explicit control points,
+ * one segment per line, as fitted by fit_subtrajectory() for --fit. Paths
+ * of more than MAX_METAPOST_PATH_KNOTS knots are split, as described for
+ * add_subtrajectory(), with the explicit control points keeping the curve
+ * smooth at the joins. The path is left for the caller to draw, as an arrow
+ * if |arrow| is set and the last chunk (or, for reversed arrows, the first
+ * chunk) is still to be drawn.
+ */
+void add_fitted_subtrajectory(mpbuffer *out,stoketraject *st,
+      long int ka,long int kb,short *keep,pmap *map,short type,short *arrow) {
+   bezierpath bp;
+   long int k,n=1;
+
+   allocate_bezier_path(&bp,kb-ka+1);
+   fit_subtrajectory(&bp,st,ka,kb,keep,map,1.0);
+   mp_printf(out,"   p := makepath makepen ");
+   mp_pair(out,bp.x[1],bp.y[1]);
+   for (k=2;k<=bp.n;k++) {
+      if (!bp.knot[k]) continue;
+      mp_printf(out,"\n    ..controls ");
+      mp_pair(out,bp.c1x[k],bp.c1y[k]);
+      mp_printf(out," and ");
+      mp_pair(out,bp.c2x[k],bp.c2y[k]);
+      mp_printf(out,"..");
+      mp_pair(out,bp.x[k],bp.y[k]);
+      if ((++n==MAX_METAPOST_PATH_KNOTS)&&(k<bp.n)) {
+         add_path_chunk_end(out,(*arrow)&&(*map).reverse_arrow_paths,map,
+            type,bp.x[k],bp.y[k],0.0,0.0);
+         if ((*map).reverse_arrow_paths) *arrow=0;
+         n=1;
+      }
+   }
+   mp_printf(out,";\n");
+   free_bezier_path(&bp);
+}
+
+/*-----------------------------------------------------------------------------
+| The add_subtrajectory() routine writes the MetaPost code drawing the
+| sub-trajectory |ka..kb| of |st| in the layer given by |type|, or hands it
+| over to add_native_subtrajectory() for native vector output. In order to
+| stay within the capacity of MetaPost, the sub-trajectory is drawn as
+| several paths of at most MAX_METAPOST_PATH_KNOTS knots each, sharing their
+| joining points. For Bezier paths (--bezier), the direction at each join is
+| given explicitly, as that of the chord between the neighbouring points, to
+| both of the paths meeting there, so that the curve stays smooth. Only the
+| path carrying the arrow head (the last one, or with --reverse_arrow_paths
+| the first one) is drawn as an arrow.
+-----------------------------------------------------------------------------*/
+void add_subtrajectory(mpbuffer *out, stoketraject *st,
+      long int ka, long int kb, pmap *map, short type) {
+   long int k,kp,kn,n=0;
+   short j,*keep=NULL,arrow;
+   double dx=0.0,dy=0.0;
+   if ((*out).format!=METAPOST_FORMAT) {
+      add_native_subtrajectory(out,st,ka,kb,map,type);
+      return;
+   }
+   j=1;
+   mp_printf(out,"   pickup pencircle scaled %f pt;\n",
+      (*map).paththickness);
+   if (ka<kb) { /* only draw paths of two points or more */
+      arrow=((kb==(*st).numcoords)&&((*map).draw_paths_as_arrows));
+      if ((*map).simplify_tolerance>0.0) {
+         keep=svector(ka,kb);
+         simplify_subtrajectory(keep,st,ka,kb,map);
+      }
+      if ((*map).fit_tolerance>0.0) {
+         add_fitted_subtrajectory(out,st,ka,kb,keep,map,type,&arrow);
+         add_path_drawing(out,arrow,map,type);
+      } else {
+         for (kp=k=ka;k<=kb;k++) {
+            if ((keep!=NULL)&&(!keep[k])) continue; /* omitted by simplify */
+            j++;
+            if (k==ka) {
+               mp_printf(out,"   p := makepath makepen ");
+            }
+            if (j==(NUM_COORDS_PER_METAPOST_LINE+1)) {
+               mp_printf(out,"\n    ");
+               j=1;
+            }
+            if (k>ka) mp_write(out,((*map).use_bezier_curves)?"..":"--",2);
+            if ((++n==MAX_METAPOST_PATH_KNOTS)&&(k<kb)) { /* split here */
+               for (kn=k+1;(keep!=NULL)&&(!keep[kn]);kn++);
+               dx=dy=0.0;
+               if ((*map).use_bezier_curves) {
+                  dx=(*st).x[kn]-(*st).x[kp];
+                  dy=(*st).y[kn]-(*st).y[kp];
+               }
+               mp_direction(out,dx,dy);
+               mp_pair(out,(*st).x[k],(*st).y[k]);
+               add_path_chunk_end(out,arrow&&(*map).reverse_arrow_paths,map,
+                  type,(*st).x[k],(*st).y[k],dx,dy);
+               if ((*map).reverse_arrow_paths) arrow=0;
+               n=1;
+               j=2;
+            } else {
+               mp_pair(out,(*st).x[k],(*st).y[k]);
+            }
+            if (k==kb) {
+               mp_printf(out,";\n");
+               add_path_drawing(out,arrow,map,type);
+            }
+            kp=k;
+         }
+      }
+      if (keep!=NULL) free_svector(keep,ka,kb);
+   }
+}
+
+/*
+ * The place_arc_length_tickmarks() routine places the tick marks of the
+ * --tickevery option on the trajectory |st|, at the first point at or beyond
+ * each multiple of the arc length |every| along the trajectory, counted on
+ * the unit sphere from its first point, as |autotick[1..numautoticks]|. The
+ * arc between consecutive points is the angle between their Stokes vectors,
+ * being atan2(|a x b|,a.b), which needs no normalization of the points.
+ */
+void place_arc_length_tickmarks(stoketraject *st,double every) {
+   double *s1=(*st).s1,*s2=(*st).s2,*s3=(*st).s3,c1,c2,c3,arc=0.0,next=every;
+   long k;
+
+   (*st).numautoticks=0;
+   for (k=2;k<=(*st).numcoords;k++) {
+      c1=s2[k-1]*s3[k]-s3[k-1]*s2[k];
+      c2=s3[k-1]*s1[k]-s1[k-1]*s3[k];
+      c3=s1[k-1]*s2[k]-s2[k-1]*s1[k];
+      arc+=atan2(sqrt(c1*c1+c2*c2+c3*c3),
+         s1[k-1]*s1[k]+s2[k-1]*s2[k]+s3[k-1]*s3[k]);
+      if (arc>=next) {
+         if ((*st).numautoticks>=(*st).maxautoticks) grow_stoke_autoticks(st);
+         (*st).autotick[++((*st).numautoticks)]=k;
+         next=every*(floor(arc/every)+1.0);
+      }
+   }
+} /* end of place_arc_length_tickmarks() */
+
+/*-----------------------------------------------------------------------------
+| The project_stokes_trajectory() routine is the batched counterpart of the
+| |get_screen_coordinates()| and |visible()| routines, projecting all points
+| of the trajectory |st| onto the screen coordinates |x[]| and |y[]|, and
+| classifying their visibility into |visible[]|, using the view transform
+| |view| of the parameter map. The loops are kept free from calls and
+| branches, operating on the arrays of the trajectory as a whole, so as to be
+| vectorized by the compiler; the normalization of the Stokes parameters is
+| done in a loop of its own, only if requested, as is the placement of the
+| tick marks of --tickevery by place_arc_length_tickmarks().
+-----------------------------------------------------------------------------*/
+void project_stokes_trajectory(stoketraject *st,pmap *map) {
+   double a00,a01,a10,a11,a12,a20,a21,a22,snorm;
+   double *s1=(*st).s1,*s2=(*st).s2,*s3=(*st).s3,*x=(*st).x,*y=(*st).y;
+   short *vis=(*st).visible;
+   long k,n=(*st).numcoords;
+
+   a00=(*map).view[0][0];
+   a01=(*map).view[0][1];
+   a10=(*map).view[1][0];
+   a11=(*map).view[1][1];
+   a12=(*map).view[1][2];
+   a20=(*map).view[2][0];
+   a21=(*map).view[2][1];
+   a22=(*map).view[2][2];
+   for (k=1;k<=n;k++) {
+      x[k]=a00*s1[k]+a01*s2[k];
+      y[k]=a10*s1[k]+a11*s2[k]+a12*s3[k];
+      vis[k]=(short)(a20*s1[k]+a21*s2[k]+a22*s3[k]>=0.0);
+   }
+   if ((*map).use_normalized_stokes_params) {
+      for (k=1;k<=n;k++) {
+         snorm=sqrt(s1[k]*s1[k]+s2[k]*s2[k]+s3[k]*s3[k]);
+         x[k]=x[k]/snorm;
+         y[k]=y[k]/snorm;
+      }
+   }
+   if ((*map).tickevery>0.0) place_arc_length_tickmarks(st,(*map).tickevery);
+} /* end of project_stokes_trajectory() */
+
+/*-----------------------------------------------------------------------------
+| The segment_stokes_trajectory() routine splits the trajectory |st|, as
+| projected by |project_stokes_trajectory()|, in a single sweep into its
+| maximal runs of points of the same visibility, being the sub-trajectories
+| drawn in the hidden and visible layers of the figure. The run No k covers
+| the points |segfirst[k]..seglast[k]|, with visibility |segvisible[k]|, and
+| is drawn over the points |segfrom[k]..segto[k]|. For visible runs, these
+| bounds extend one coordinate step behind the sphere at either end (where
+| possible), so as to give a smooth connection to the hidden parts; hidden
+| runs are drawn as they are.
+-----------------------------------------------------------------------------*/
+void segment_stokes_trajectory(stoketraject *st) {
+   short *vis=(*st).visible;
+   long k,j,ns=0,n=(*st).numcoords;
+
+   for (k=1;k<=n;k=j+1) {
+      for (j=k;(j<n)&&(vis[j+1]==vis[k]);j++);
+      if (ns>=(*st).maxsegments) grow_stoke_segments(st);
+      ns++;
+      (*st).segfirst[ns]=(*st).segfrom[ns]=k;
+      (*st).seglast[ns]=(*st).segto[ns]=j;
+      (*st).segvisible[ns]=vis[k];
+      if (vis[k]) {
+         if (k>1) (*st).segfrom[ns]=k-1;
+         if (j<n) (*st).segto[ns]=j+1;
+      }
+   }
+   (*st).numsegments=ns;
+} /* end of segment_stokes_trajectory() */
+
+/*
+ * Sort out visible from hidden parts of the trajectory, and compute the
+ * screen coordinates of all its points.
+ */
+void sort_out_visible_and_hidden(mpbuffer *out,stoketraject *st,pmap *map) {
+   project_stokes_trajectory(st,map);
+   segment_stokes_trajectory(st);
+}
+
+/*
+ * Write the hidden (|viewtype| being HIDDEN) or visible (VISIBLE) parts of
+ * the trajectory to file, as given by its visibility segments.
+ */
+void add_subtrajectories(mpbuffer *out,stoketraject *st,pmap *map,
+      short viewtype) {
+   long k;
+   for (k=1;k<=(*st).numsegments;k++) {
+      if ((*st).segvisible[k]!=(viewtype==VISIBLE)) continue;
+      if ((*map).verbose) {
+         fprintf(stdout,
+            "%s: Adding %s subtrajectory from ka=%ld to kb=%ld\n",
+            progname,((viewtype==VISIBLE)?"visible":"hidden"),
+            (*st).segfirst[k],(*st).seglast[k]);
+      }
+      add_subtrajectory(out,st,(*st).segfrom[k],(*st).segto[k],map,viewtype);
+   }
+}
+
+/*
+ * The add_scanned_trajectory() routine writes the hidden or visible parts
+ * of the trajectory |st|. The trajectory is projected and split into its
+ * visibility segments in the hidden pass only, which always comes first,
+ * after which the visible pass reuses the very same segments.
+ */
+void add_scanned_trajectory(mpbuffer *out,stoketraject *st,pmap *map,
+      short viewtype) {
+   if (viewtype==HIDDEN) {
+      sort_out_visible_and_hidden(out,st,map);
+      add_subtrajectories(out,st,map,HIDDEN);
+   } else if (viewtype==VISIBLE) {
+      add_subtrajectories(out,st,map,VISIBLE);
+   } else { /* if invalid |viewtype| option */
+      fprintf(stderr,"%s: Error in add_scanned_trajectory: ",progname);
+      fprintf(stderr,"Invalid viewtype value! (%d)\n",viewtype);
+      exit(1);
+   }
+}
+
+/*
+ * The add_label_drawing() routine writes the label |k| of the arena |a|,
+ * being label No |n| of its trajectory, at the screen coordinates (x,y).
+ */
+void add_label_drawing(mpbuffer *out,labelarena *a,long k,long n,
+      double x,double y,pmap *map) {
+   long int j;
+   char text[MAX_LABEL_TEXTLENGTH+1];
+
+   if ((*out).format!=METAPOST_FORMAT) {
+      for (j=0;j<(*a).length[k];j++)
+         text[j]=(*a).text[(*a).offset[k]+j];
+      text[(*a).length[k]]='\0';
+      x=(*map).scalefactor*BP_PER_MM*x;
+      y=(*map).scalefactor*BP_PER_MM*y;
+      vec_label(out,text,(short)(strchr(text,'$')!=NULL),x,y,(*a).pos[k]);
+   } else {
+      if ((*a).pos[k]==TOPLABEL) {
+         mp_printf(out,"   label.top");
+      } else if ((*a).pos[k]==UPPERLEFTLABEL) {
+         mp_printf(out,"   label.ulft");
+      } else if ((*a).pos[k]==LEFTLABEL) {
+         mp_printf(out,"   label.lft");
+      } else if ((*a).pos[k]==LOWERLEFTLABEL) {
+         mp_printf(out,"   label.llft");
+      } else if ((*a).pos[k]==BOTTOMLABEL) {
+         mp_printf(out,"   label.bot");
+      } else if ((*a).pos[k]==LOWERRIGHTLABEL) {
+         mp_printf(out,"   label.lrt");
+      } else if ((*a).pos[k]==RIGHTLABEL) {
+         mp_printf(out,"   label.rt");
+      } else if ((*a).pos[k]==UPPERRIGHTLABEL) {
+         mp_printf(out,"   label.urt");
+      } else {
+         fprintf(stderr,
+            "%s: add_scanned_labels: Invalid labelpos (%d) detected ",
+            progname,(*a).pos[k]);
+         fprintf(stderr,"at label No %ld\n",n);
+         fprintf(stderr,
+            "%s: add_scanned_labels: Labelstring is \042",progname);
+         for (j=0;j<(*a).length[k];j++)
+            fprintf(stderr,"%c",(*a).text[(*a).offset[k]+j]);
+         fprintf(stderr,"\044\n");
+         exit(1);
+      }
+      mp_printf(out,"(btex ");
+      for (j=0;j<(*a).length[k];j++)
+         mp_printf(out,"%c",(*a).text[(*a).offset[k]+j]);
+      mp_printf(out," etex,(%f,%f)*radius);\n",x,y);
+   }
+}
+
+/*
+ * The add_scanned_labels() routines the previously scanned text labels
+ * of the trajectory |st| to the output MetaPost source file.
+ */
+void add_scanned_labels(mpbuffer *out,stoketraject *st,pmap *map) {
+   long int k,n;
+   labelarena *a;
+
+   a=(*st).labels;
+   for (n=1;n<=(*st).numlabels;n++) {
+      k=(*st).firstlabel+n;
+      add_label_drawing(out,a,k,n,(*st).x[(*a).coord[k]],
+         (*st).y[(*a).coord[k]],map);
+   }
+}
+
+void scan_for_tickmark(trajectoryinput *in,stoketraject *st) {
+   if (tickmark(in)) {
+      if ((*st).numtickmarks>=(*st).maxtickmarks) grow_stoke_tickmarks(st);
+      (*st).numtickmarks++;
+      (*st).tickmark[(*st).numtickmarks]=(*st).numcoords;
+   }
+}
+
+void scan_for_tickmarklabel(trajectoryinput *in,stoketraject *st,pmap *map) {
+   if (tickmarklabel(in)) {
+      if ((*map).verbose)
+         fprintf(stdout,"%s: Scanning label No %ld\n",progname,
+            (*st).numlabels+1);
+      scan_label(in,st,map,(*st).numcoords);
+   }
+}
+
+/*------------------------------------------------------------------------
+| The get_tickmark_screen_coordinates(...) routine computes the end-points
+| (xa,ya) and (xb,yb) for a tickmark to be written. These coordinates are
+| returned via the reference variables (pointers) *xa, *ya, *xb, and *yb.
+------------------------------------------------------------------------*/
+void get_tickmark_screen_coordinates(double *xa,double *ya,
+      double *xb,double *yb,long int k,stoketraject *st,pmap *map) {
+   double xt,yt,snorm,s1n,s2n,s3n,s1a,s2a,s3a,s1b,s2b,s3b,
+      s0,s1,s2,s3,p1,p2,p3,q1,q2,q3,h;
+
+   /* Calculate the normalized approximate tangential vector to path
+    * at the tickmark point with index k. If the tangential vector is
+    * not possible to compute, say if the two defining points are equal,
+    * then the get_tickmark_screen_coordinates(...) routine simply will
+    * return (NAN,NAN) as screen coordinate, to be checked by the caller.
+    */
+   if ((*st).tickmark[k]==1) {
+      q1=(*st).s1[(*st).tickmark[k]+1]-(*st).s1[(*st).tickmark[k]];
+      q2=(*st).s2[(*st).tickmark[k]+1]-(*st).s2[(*st).tickmark[k]];
+      q3=(*st).s3[(*st).tickmark[k]+1]-(*st).s3[(*st).tickmark[k]];
+   } else if ((*st).tickmark[k]==(*st).numcoords) {
+      q1=(*st).s1[(*st).tickmark[k]]-(*st).s1[(*st).tickmark[k]-1];
+      q2=(*st).s2[(*st).tickmark[k]]-(*st).s2[(*st).tickmark[k]-1];
+      q3=(*st).s3[(*st).tickmark[k]]-(*st).s3[(*st).tickmark[k]-1];
+   } else if ((1<(*st).tickmark[k])&&((*st).tickmark[k]<(*st).numcoords)) {
+      q1=(*st).s1[(*st).tickmark[k]+1]-(*st).s1[(*st).tickmark[k]-1];
+      q2=(*st).s2[(*st).tickmark[k]+1]-(*st).s2[(*st).tickmark[k]-1];
+      q3=(*st).s3[(*st).tickmark[k]+1]-(*st).s3[(*st).tickmark[k]-1];
+   } else {
+      fprintf(stderr,"%s: In get_tickmark_screen_coordinates:\n",progname);
+      fprintf(stderr,"%s: Index k=%ld out of valid range!\n",
+         progname,(*st).tickmark[k]);
+      exit(1);
+   }
+   snorm=sqrt(q1*q1+q2*q2+q3*q3);
+   if (isnan(snorm) || (snorm < 1.0e-24)) {
+      fprintf(stderr,"%s: Singular norm of (q1,q2,q3) detected.\n",progname);
+      fprintf(stderr,"%s: snorm=%1.4f, q1=%1.4f, q2=%1.4f, q3=%1.4f\n",
+           progname,snorm,q1,q2,q3);
+      fprintf(stderr,"%s: (No tickmark projektion possible.)\n",progname);
+      (*xa)=NAN;
+      (*ya)=NAN;
+      (*xb)=NAN;
+      (*yb)=NAN;
+      return;
+   }
+   q1/=snorm;
+   q2/=snorm;
+   q3/=snorm;
+
+   /* Get normalized (unitary) Stokes vector. */
+   s1=(*st).s1[(*st).tickmark[k]];
+   s2=(*st).s2[(*st).tickmark[k]];
+   s3=(*st).s3[(*st).tickmark[k]];
+   s0=sqrt(s1*s1+s2*s2+s3*s3);
+   s1n=s1/s0;
+   s2n=s2/s0;
+   s3n=s3/s0;
+
+   /* Calculate the normalized vector transverse to the tangent of path,
+    * {\bf p}={\bf s}\times{\bf q}/|{\bf s}\times{\bf q}|.
+    */
+   p1=s2n*q3-s3n*q2;
+   p2=s3n*q1-s1n*q3;
+   p3=s1n*q2-s2n*q1;
+   snorm=sqrt(p1*p1+p2*p2+p3*p3);
+   if (isnan(snorm) || (snorm < 1.0e-24)) {
+      fprintf(stderr,
+         "%s: Singular norm detected for the normalized vector\n",progname);
+      fprintf(stderr,
+         "%s: transverse to the tangent of path, p=s x q/|s x q|.\n",progname);
+      fprintf(stderr,
+         "%s: snorm=%1.4f, p1=%1.4f, p2=%1.4f, p3=%1.4f\n",
+         progname, snorm, p1, p2, p3);
+      (*xa)=NAN;
+      (*ya)=NAN;
+      (*xb)=NAN;
+      (*yb)=NAN;
+      return;
+   }
+   p1/=snorm;
+   p2/=snorm;
+   p3/=snorm;
+
+   /* Calculate the 1st endpoint of tick mark in Stokes parameter space */
+   h=0.5*(*map).ticksize;
+   s1a=s1n+h*p1;
+   s2a=s2n+h*p2;
+   s3a=s3n+h*p3;
+
+   /* Calculate the 2nd endpoint of tick mark in Stokes parameter space */
+   s1b=s1n-h*p1;
+   s2b=s2n-h*p2;
+   s3b=s3n-h*p3;
+
+   /* Get the screen coordinates of the ends of the tick mark */
+   get_screen_coordinates(&xt,&yt,s0*s1a,s0*s2a,s0*s3a,map);
+   if (isnan(xt) || isnan(yt)) {
+     fprintf(stderr,"%s: [Case A] NaN detected by routine "
+             "get_tickmark_screen_coordinates: xt=%1.4f, yt=%1.4f\n",
+             progname, xt,yt);
+     fprintf(stderr,"%s: s0=%1.4f, s1a=%1.4f, s2a=%1.4f, s3a=%1.4f\n",
+             progname, s0, s1a, s2a, s3a);
+      (*xa)=NAN;
+      (*ya)=NAN;
+      (*xb)=NAN;
+      (*yb)=NAN;
+      return;
+   }
+   (*xa)=xt;
+   (*ya)=yt;
+   get_screen_coordinates(&xt,&yt,s0*s1b,s0*s2b,s0*s3b,map);
+   if (isnan(xt) || isnan(yt)) {
+     fprintf(stderr,"%s: [Case B] NaN detected by routine "
+             "get_tickmark_screen_coordinates: xt=%1.4f, yt=%1.4f\n",
+             progname, xt, yt);
+     fprintf(stderr,"%s: s0=%1.4f, s1b=%1.4f, s2b=%1.4f, s3b=%1.4f\n",
+             progname, s0, s1b, s2b, s3b);
+      (*xa)=NAN;
+      (*ya)=NAN;
+      (*xb)=NAN;
+      (*yb)=NAN;
+      return;
+   }
+   (*xb)=xt;
+   (*yb)=yt;
+}
+
+/*
+ * The add_native_tickmark() routine draws, for the native vector output, the
+ * tick mark |k| of |st| from (xa,ya) to (xb,yb), in units of the radius, if
+ * it belongs to the layer |viewtype|.
+ */
+void add_native_tickmark(mpbuffer *out,double xa,double ya,double xb,
+      double yb,pmap *map,short vis) {
+   double x[3],y[3],radius=(*map).scalefactor*BP_PER_MM;
+
+   x[1]=radius*xa;
+   y[1]=radius*ya;
+   x[2]=radius*xb;
+   y[2]=radius*yb;
+   vec_stroke(out,x,y,2,0,(vis)?0.0:(*map).hiddengraytone,
+      0.5*(*map).paththickness*BP_PER_PT,0);
+}
+
+/*
+ * The add_mp_tickmark() routine writes the tick mark from (xa,ya) to (xb,yb),
+ * in units of the radius, as the path |p| of MetaPost code, drawing it in
+ * the style of its visibility |vis| only if |draw| is set.
+ */
+void add_mp_tickmark(mpbuffer *out,double xa,double ya,double xb,double yb,
+      pmap *map,short vis,short draw) {
+   mp_printf(out,"   p:=makepath makepen (%f,%f)--(%f,%f);\n",xa,ya,xb,yb);
+   if (!draw) return;
+   if (vis) {
+      mp_printf(out,"   draw p scaled radius;\n");
+   } else {
+      mp_printf(out,"   draw p scaled radius");
+      mp_printf(out," withcolor %f [black,white];\n",(*map).hiddengraytone);
+   }
+}
+
+/*
+ * The tickmark_visibility() routine returns the visibility of the point
+ * |k| of the trajectory |st|, as given by its visibility segments, starting
+ * the search at the segment |*seg|, which is updated to the segment found.
+ * For tick marks in increasing order along the trajectory, the segments are
+ * thus walked through once only.
+ */
+short tickmark_visibility(stoketraject *st,long k,long *seg) {
+   if (((*seg)<1)||((*seg)>(*st).numsegments)
+         ||((*st).segfirst[*seg]>k)) (*seg)=1;
+   while (((*seg)<(*st).numsegments)&&((*st).seglast[*seg]<k)) (*seg)++;
+   return((*st).segvisible[*seg]);
+}
+
+/*
+ * The get_autotick_screen_coordinates() routine computes the end points
+ * (xa,ya) and (xb,yb) of the tick mark of --tickevery at the point |k| of
+ * |st|, drawn across the path as seen in the figure, with the direction of
+ * the path taken from the screen coordinates of the neighbouring points, as
+ * already projected. The routine returns 0 (false), with no tick mark to be
+ * drawn, if the neighbours coincide in the figure.
+ */
+short get_autotick_screen_coordinates(double *xa,double *ya,
+      double *xb,double *yb,long k,stoketraject *st,pmap *map) {
+   long ka=((k>1)?k-1:k),kb=((k<(*st).numcoords)?k+1:k);
+   double tx,ty,h;
+
+   tx=(*st).x[kb]-(*st).x[ka];
+   ty=(*st).y[kb]-(*st).y[ka];
+   h=sqrt(tx*tx+ty*ty);
+   if (h<1.0e-12) return 0;
+   h=0.5*(*map).ticksize/h;
+   (*xa)=(*st).x[k]-h*ty;
+   (*ya)=(*st).y[k]+h*tx;
+   (*xb)=(*st).x[k]+h*ty;
+   (*yb)=(*st).y[k]-h*tx;
+   return 1;
+}
+
+/*
+ * The add_arc_length_tickmarks() routine draws the tick marks of --tickevery
+ * of the trajectory |st| belonging to the layer |viewtype|, as placed by
+ * place_arc_length_tickmarks() in the projection of the trajectory.
+ */
+void add_arc_length_tickmarks(mpbuffer *out,stoketraject *st,pmap *map,
+      short viewtype) {
+   long int k;
+   double xa,ya,xb,yb;
+   short vis;
+
+   for (k=1;k<=(*st).numautoticks;k++) {
+      vis=(*st).visible[(*st).autotick[k]];
+      if (vis!=(viewtype==VISIBLE)) continue;
+      if (!get_autotick_screen_coordinates(&xa,&ya,&xb,&yb,
+            (*st).autotick[k],st,map)) continue;
+      if ((*out).format!=METAPOST_FORMAT) {
+         add_native_tickmark(out,xa,ya,xb,yb,map,vis);
+      } else {
+         add_mp_tickmark(out,xa,ya,xb,yb,map,vis,1);
+      }
+   }
+}
+
+/*
+ * If any of the coordinates returned by get_tickmark_screen_coordinates()
+ * contain a NAN, then the tickmark is deemed invalid (say, due to an attempt
+ * of finding the orthogonal direction based on two coinciding points on the
+ * Poincare sphere), and we hence simply avoid this particular tickmark, as
+ * reported by the report_invalid_tickmark() routine.
+ */
+void report_invalid_tickmark(long k) {
+   fprintf(stderr,"%s: Screen coordinates for tickmark No.%ld was\n",
+      progname,k);
+   fprintf(stderr,"%s: returned as NAN, indicating an invalid tickmark.\n",
+      progname);
+   fprintf(stderr,"%s: Will ignore this tickmark.\n", progname);
+}
+
+void add_scanned_tickmarks(mpbuffer *out,stoketraject *st,pmap *map,
+      short viewtype) {
+   long int k,seg=1;
+   double xa,ya,xb,yb;
+   short vis;
+
+   if ((*out).format==METAPOST_FORMAT)
+      mp_printf(out,"   pickup pencircle scaled %f pt;\n",
+         (*map).paththickness/2.0);
+   for (k=1;k<=(*st).numtickmarks;k++) {
+      vis=tickmark_visibility(st,(*st).tickmark[k],&seg);
+      if (((*out).format!=METAPOST_FORMAT)&&(vis!=(viewtype==VISIBLE)))
+         continue; /* tick mark belongs to the other layer */
+      get_tickmark_screen_coordinates(&xa,&ya,&xb,&yb,k,st,map);
+      if (isnan(xa)||isnan(ya)||isnan(xb)||isnan(yb)) {
+         report_invalid_tickmark(k);
+      } else if ((*out).format!=METAPOST_FORMAT) {
+         add_native_tickmark(out,xa,ya,xb,yb,map,vis);
+      } else {
+         add_mp_tickmark(out,xa,ya,xb,yb,map,vis,vis==(viewtype==VISIBLE));
+      }
+   }
+   add_arc_length_tickmarks(out,st,map,viewtype);
+}
+
+/*
+ * The append_mpbuffer() routine appends the text kept in the buffer |in| to
+ * the buffer |out|, extending the bounding box of |out| accordingly.
+ */
+void append_mpbuffer(mpbuffer *out,mpbuffer *in) {
+   mp_write(out,(*in).buf,(*in).len);
+   if ((*in).llx<=(*in).urx) {
+      vec_extend_bbox(out,(*in).llx,(*in).lly);
+      vec_extend_bbox(out,(*in).urx,(*in).ury);
+   }
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the rolling-window renderer of stream_trajectory_file(), by
+| which a trajectory is drawn point by point while it is scanned, so that
+| the memory needed does not grow with the length of the trajectory. Each
+| point is projected as by project_stokes_trajectory(), and the runs of
+| points of the same visibility, as found by segment_stokes_trajectory(),
+| are written as paths to the hidden and visible layers as the points
+| arrive, just as add_subtrajectory() would have written them. Since a path
+| is only known to have ended (and whether it gets the arrow head of the
+| trajectory) at the point after its last, and since a tick mark is drawn
+| across the path at its point, everything is written one point behind the
+| input. The tick marks are written to spill buffers of their own, with
+| temporary files attached, to be appended to the layers after the paths,
+| together with the labels, once the trajectory has been scanned. The
+| MetaPost code is thus the very same as for the trajectory kept as a whole.
+|
+| Features needing the whole trajectory, being --simplify and --fit, arrow
+| heads at the beginning of the trajectories (--reverse_arrow_paths), the
+| native vector output, and the binary trajectory format (with S1, S2 and
+| S3 stored one after the other), are left to the regular renderer, as
+| decided by rolling_window_applies().
+-----------------------------------------------------------------------------*/
+short rolling_window_applies(mpbuffer *out,pmap *map,trajectoryinput *in) {
+   return(((*out).format==METAPOST_FORMAT)&&(!(*in).binary)
+      &&((*map).simplify_tolerance<=0.0)&&((*map).fit_tolerance<=0.0)
+      &&(!((*map).draw_paths_as_arrows&&(*map).reverse_arrow_paths))
+      &&((*map).density==NULL));
+}
+
+void open_window_spill(mpbuffer *spill) {
+   FILE *fileptr;
+
+   if ((fileptr=tmpfile())==NULL) {
+      fprintf(stderr,"%s: Error: Couldn't open temporary file for the "
+         "tick marks of trajectories.\n",progname);
+      exit(FAILURE);
+   }
+   initialize_mpbuffer(spill,fileptr);
+}
+
+void close_window_spill(mpbuffer *spill) {
+   FILE *fileptr=(*spill).fileptr;
+
+   (*spill).fileptr=NULL; /* whatever is left is not needed */
+   free_mpbuffer(spill);
+   fclose(fileptr);
+}
+
+/*
+ * The append_window_spill() routine appends the text of the spill buffer
+ * |spill| to |out|, whether kept in memory or spilled to its file, leaving
+ * it empty for the next trajectory.
+ */
+void append_window_spill(mpbuffer *out,mpbuffer *spill) {
+   char buf[BUFSIZ];
+   unsigned long left;
+   size_t n;
+
+   if ((*spill).numwritten>0) {
+      flush_mpbuffer(spill);
+      rewind((*spill).fileptr);
+      for (left=(*spill).numwritten;left>0;left-=n) {
+         n=fread(buf,1,(left<BUFSIZ)?(size_t)left:BUFSIZ,(*spill).fileptr);
+         if (n==0) {
+            fprintf(stderr,"%s: Error: Couldn't read back the tick marks "
+               "of a trajectory from temporary file.\n",progname);
+            exit(FAILURE);
+         }
+         mp_write(out,buf,n);
+      }
+      rewind((*spill).fileptr);
+      (*spill).numwritten=0;
+   } else {
+      append_mpbuffer(out,spill);
+   }
+   reset_mpbuffer(spill);
+}
+
+void initialize_rolling_window(rollingwindow *rw,mpbuffer *hidden,
+      mpbuffer *visible) {
+   short t;
+
+   (*rw).layer[HIDDEN]=hidden;
+   (*rw).layer[VISIBLE]=visible;
+   for (t=HIDDEN;t<=VISIBLE;t++) {
+      open_window_spill(&((*rw).ticks[t]));
+      open_window_spill(&((*rw).autoticks[t]));
+   }
+   (*rw).maxlabels=64;
+   (*rw).labelx=dvector(1,(*rw).maxlabels);
+   (*rw).labely=dvector(1,(*rw).maxlabels);
+}
+
+void free_rolling_window(rollingwindow *rw) {
+   short t;
+
+   for (t=HIDDEN;t<=VISIBLE;t++) {
+      close_window_spill(&((*rw).ticks[t]));
+      close_window_spill(&((*rw).autoticks[t]));
+   }
+   free_dvector((*rw).labelx,1,(*rw).maxlabels);
+   free_dvector((*rw).labely,1,(*rw).maxlabels);
+}
+
+void begin_window_trajectory(rollingwindow *rw,pmap *map) {
+   short t;
+
+   (*rw).numcoords=0;
+   (*rw).numtickmarks=0;
+   (*rw).arc=0.0;
+   (*rw).nextarc=(*map).tickevery;
+   for (t=HIDDEN;t<=VISIBLE;t++) (*rw).open[t]=(*rw).split[t]=0;
+   (*rw).closing=0;
+   (*rw).numlabels=0;
+}
+
+/*
+ * The open_window_path() routine starts the path of the layer |t| for the
+ * run of points starting at |first|, with the path starting at point |ka|.
+ */
+void open_window_path(rollingwindow *rw,short t,long first,long ka,
+      pmap *map) {
+   mp_printf((*rw).layer[t],"   pickup pencircle scaled %f pt;\n",
+      (*map).paththickness);
+   (*rw).open[t]=1;
+   (*rw).split[t]=0;
+   (*rw).first[t]=first;
+   (*rw).ka[t]=ka;
+   (*rw).n[t]=0;
+   (*rw).j[t]=1;
+   if ((*map).stats!=NULL) {
+      if (t==VISIBLE) {
+         (*(*map).stats).numvisiblesegments++;
+      } else {
+         (*(*map).stats).numhiddensegments++;
+      }
+   }
+}
+
+/*
+ * The add_window_path_point() routine adds the point kept as |slot| of the
+ * window to the path of the layer |t|, as in the loop of add_subtrajectory().
+ * The first point of the path is written along with the second one, as the
+ * path is only drawn if it has two points or more, and a split of the path
+ * is left for the next point, as its direction there depends on that point.
+ */
+void add_window_path_point(rollingwindow *rw,short t,short slot,pmap *map) {
+   mpbuffer *out=(*rw).layer[t];
+   long k=(*rw).numcoords-3+slot;
+   double *x=(*rw).x,*y=(*rw).y,dx,dy;
+
+   if (k==(*rw).ka[t]) {
+      (*rw).n[t]=1;
+      (*rw).j[t]=2;
+      return;
+   }
+   if (k==(*rw).ka[t]+1) {
+      mp_printf(out,"   p := makepath makepen ");
+      mp_pair(out,x[slot-1],y[slot-1]);
+   }
+   if ((*rw).split[t]) { /* split the path at the previous point */
+      dx=dy=0.0;
+      if ((*map).use_bezier_curves) {
+         dx=x[slot]-x[slot-2];
+         dy=y[slot]-y[slot-2];
+      }
+      mp_direction(out,dx,dy);
+      mp_pair(out,x[slot-1],y[slot-1]);
+      add_path_chunk_end(out,0,map,t,x[slot-1],y[slot-1],dx,dy);
+      (*rw).split[t]=0;
+      (*rw).n[t]=1;
+      (*rw).j[t]=2;
+   }
+   if (++((*rw).j[t])==(NUM_COORDS_PER_METAPOST_LINE+1)) {
+      mp_printf(out,"\n    ");
+      (*rw).j[t]=1;
+   }
+   mp_write(out,((*map).use_bezier_curves)?"..":"--",2);
+   if (++((*rw).n[t])==MAX_METAPOST_PATH_KNOTS) {
+      (*rw).split[t]=1;
+   } else {
+      mp_pair(out,x[slot],y[slot]);
+   }
+}
+
+/*
+ * The end_window_path() routine ends the path of the layer |t| at the point
+ * kept as |slot| of the window, its run of points ending at |last|, after
+ * which draw_window_path() draws it, with an arrow head if |arrow| is set.
+ */
+void end_window_path(rollingwindow *rw,short t,short slot,long last,
+      pmap *map) {
+   if ((*map).verbose) {
+      fprintf(stdout,
+         "%s: Adding %s subtrajectory from ka=%ld to kb=%ld\n",
+         progname,((t==VISIBLE)?"visible":"hidden"),(*rw).first[t],last);
+   }
+   if ((*rw).split[t]) { /* no split at the last point after all */
+      mp_pair((*rw).layer[t],(*rw).x[slot],(*rw).y[slot]);
+      (*rw).split[t]=0;
+   }
+}
+
+void draw_window_path(rollingwindow *rw,short t,short arrow,pmap *map) {
+   if ((*rw).n[t]>1) { /* only draw paths of two points or more */
+      mp_printf((*rw).layer[t],";\n");
+      add_path_drawing((*rw).layer[t],arrow,map,t);
+   }
+   (*rw).open[t]=0;
+}
+
+/*
+ * The add_window_tickmarks() routine writes the tick marks at the point kept
+ * as |slot| of the window to the spill buffers, once the point after it (if
+ * any) has been projected. The routines of the regular renderer are used on
+ * the points around it, as a |stoketraject| of one to three points.
+ */
+void add_window_tickmarks(rollingwindow *rw,short slot,pmap *map) {
+   stoketraject w;
+   long tick[2];
+   short lo,vis=(*rw).visible[slot];
+   double xa,ya,xb,yb;
+
+   lo=(((*rw).numcoords-3+slot>1)?slot-1:slot);
+   w.s1=(*rw).s1+lo-1;
+   w.s2=(*rw).s2+lo-1;
+   w.s3=(*rw).s3+lo-1;
+   w.x=(*rw).x+lo-1;
+   w.y=(*rw).y+lo-1;
+   w.numcoords=3-lo+1;
+   tick[1]=slot-lo+1;
+   w.tickmark=tick;
+   if ((*rw).tick[slot]) {
+      (*rw).numtickmarks++;
+      get_tickmark_screen_coordinates(&xa,&ya,&xb,&yb,1,&w,map);
+      if (isnan(xa)||isnan(ya)||isnan(xb)||isnan(yb)) {
+         report_invalid_tickmark((*rw).numtickmarks);
+      } else {
+         add_mp_tickmark(&((*rw).ticks[HIDDEN]),xa,ya,xb,yb,map,vis,!vis);
+         add_mp_tickmark(&((*rw).ticks[VISIBLE]),xa,ya,xb,yb,map,vis,vis);
+      }
+   }
+   if ((*rw).autotick[slot]
+         &&get_autotick_screen_coordinates(&xa,&ya,&xb,&yb,tick[1],&w,map))
+      add_mp_tickmark(&((*rw).autoticks[vis]),xa,ya,xb,yb,map,vis,1);
+}
+
+/*
+ * The add_window_point() routine adds the point (s1,s2,s3) to the trajectory
+ * drawn by the rolling window |rw|, as point No k, being kept as |slot| 3 of
+ * the window, and writes what was waiting for it. On a change of visibility,
+ * the hidden path ends at the point before, with the visible path starting
+ * there, while the visible path goes on to the point, ending there.
+ */
+void add_window_point(rollingwindow *rw,double s1,double s2,double s3,
+      pmap *map) {
+   double snorm,c1,c2,c3;
+   long k;
+   short i,v;
+
+   for (i=1;i<=2;i++) {
+      (*rw).s1[i]=(*rw).s1[i+1];
+      (*rw).s2[i]=(*rw).s2[i+1];
+      (*rw).s3[i]=(*rw).s3[i+1];
+      (*rw).x[i]=(*rw).x[i+1];
+      (*rw).y[i]=(*rw).y[i+1];
+      (*rw).visible[i]=(*rw).visible[i+1];
+      (*rw).tick[i]=(*rw).tick[i+1];
+      (*rw).autotick[i]=(*rw).autotick[i+1];
+   }
+   k=++((*rw).numcoords);
+   (*rw).s1[3]=s1;
+   (*rw).s2[3]=s2;
+   (*rw).s3[3]=s3;
+   (*rw).x[3]=(*map).view[0][0]*s1+(*map).view[0][1]*s2;
+   (*rw).y[3]=(*map).view[1][0]*s1+(*map).view[1][1]*s2+(*map).view[1][2]*s3;
+   (*rw).visible[3]=(short)((*map).view[2][0]*s1+(*map).view[2][1]*s2
+      +(*map).view[2][2]*s3>=0.0);
+   if ((*map).use_normalized_stokes_params) {
+      snorm=sqrt(s1*s1+s2*s2+s3*s3);
+      (*rw).x[3]=(*rw).x[3]/snorm;
+      (*rw).y[3]=(*rw).y[3]/snorm;
+   }
+   (*rw).tick[3]=(*rw).autotick[3]=0;
+   if ((k>1)&&((*map).tickevery>0.0)) { /* as place_arc_length_tickmarks() */
+      c1=(*rw).s2[2]*s3-(*rw).s3[2]*s2;
+      c2=(*rw).s3[2]*s1-(*rw).s1[2]*s3;
+      c3=(*rw).s1[2]*s2-(*rw).s2[2]*s1;
+      (*rw).arc+=atan2(sqrt(c1*c1+c2*c2+c3*c3),
+         (*rw).s1[2]*s1+(*rw).s2[2]*s2+(*rw).s3[2]*s3);
+      if ((*rw).arc>=(*rw).nextarc) {
+         (*rw).autotick[3]=1;
+         (*rw).nextarc=(*map).tickevery
+            *(floor((*rw).arc/(*map).tickevery)+1.0);
+      }
+   }
+   if ((*rw).closing) { /* the visible path did not end the trajectory */
+      draw_window_path(rw,VISIBLE,0,map);
+      (*rw).closing=0;
+   }
+   v=(*rw).visible[3];
+   if (k==1) {
+      open_window_path(rw,v,1,1,map);
+      add_window_path_point(rw,v,3,map);
+   } else if (v==(*rw).visible[2]) {
+      add_window_path_point(rw,v,3,map);
+   } else if (v) {
+      end_window_path(rw,HIDDEN,2,k-1,map);
+      draw_window_path(rw,HIDDEN,0,map);
+      open_window_path(rw,VISIBLE,k,k-1,map);
+      add_window_path_point(rw,VISIBLE,2,map);
+      add_window_path_point(rw,VISIBLE,3,map);
+   } else {
+      add_window_path_point(rw,VISIBLE,3,map);
+      end_window_path(rw,VISIBLE,3,k-1,map);
+      (*rw).closing=1;
+      open_window_path(rw,HIDDEN,k,k,map);
+      add_window_path_point(rw,HIDDEN,3,map);
+   }
+   if (k>1) add_window_tickmarks(rw,2,map);
+}
+
+/*
+ * The resolve_window_labels() routine gives the labels of the trajectory
+ * |st| scanned so far their screen coordinates, as their points arrive.
+ */
+void resolve_window_labels(rollingwindow *rw,stoketraject *st) {
+   labelarena *a=(*st).labels;
+   long n,coord,m;
+
+   for (n=(*rw).numlabels+1;n<=(*st).numlabels;n++) {
+      coord=(*a).coord[(*st).firstlabel+n];
+      if (coord>(*rw).numcoords) break; /* label of a point to come */
+      if (n>(*rw).maxlabels) {
+         m=2*(*rw).maxlabels;
+         (*rw).labelx=resize_dvector((*rw).labelx,1,m);
+         (*rw).labely=resize_dvector((*rw).labely,1,m);
+         (*rw).maxlabels=m;
+      }
+      (*rw).labelx[n]=(*rw).x[3-((*rw).numcoords-coord)];
+      (*rw).labely[n]=(*rw).y[3-((*rw).numcoords-coord)];
+      (*rw).numlabels=n;
+   }
+}
+
+/*
+ * The end_window_trajectory() routine ends the trajectory |st| drawn by the
+ * rolling window |rw|, drawing the paths still open, with the arrow head of
+ * the trajectory, and the tick marks of its last point, after which the
+ * tick marks and labels are appended to either layer.
+ */
+void end_window_trajectory(rollingwindow *rw,stoketraject *st,pmap *map) {
+   long n=(*rw).numcoords,k;
+   short t;
+
+   if ((*rw).closing) {
+      draw_window_path(rw,VISIBLE,(*map).draw_paths_as_arrows,map);
+      (*rw).closing=0;
+   }
+   for (t=HIDDEN;t<=VISIBLE;t++) {
+      if (!(*rw).open[t]) continue;
+      end_window_path(rw,t,3,n,map);
+      draw_window_path(rw,t,(*map).draw_paths_as_arrows,map);
+   }
+   if (n>0) {
+      /* a single point lends its own place to the point after it, giving a
+         tick mark without direction, which is left out as invalid */
+      (*rw).s1[4]=(*rw).s1[3];
+      (*rw).s2[4]=(*rw).s2[3];
+      (*rw).s3[4]=(*rw).s3[3];
+      add_window_tickmarks(rw,3,map);
+   }
+   resolve_window_labels(rw,st);
+   for (t=HIDDEN;t<=VISIBLE;t++) {
+      mp_printf((*rw).layer[t],"   pickup pencircle scaled %f pt;\n",
+         (*map).paththickness/2.0);
+      append_window_spill((*rw).layer[t],&((*rw).ticks[t]));
+      append_window_spill((*rw).layer[t],&((*rw).autoticks[t]));
+      for (k=1;k<=(*st).numlabels;k++)
+         add_label_drawing((*rw).layer[t],(*st).labels,(*st).firstlabel+k,k,
+            (k<=(*rw).numlabels)?(*rw).labelx[k]:0.0,
+            (k<=(*rw).numlabels)?(*rw).labely[k]:0.0,map);
+   }
+   if ((*map).stats!=NULL) {
+      (*(*map).stats).numtrajectories++;
+      (*(*map).stats).numpoints+=n;
+      (*(*map).stats).numtickmarks+=(*rw).numtickmarks;
+      (*(*map).stats).numlabels+=(*st).numlabels;
+   }
+} /* end of end_window_trajectory() */
+
+/*-----------------------------------------------------------------------------
+| Routines for the binary trajectory format. As an alternative to the text
+| format, trajectories may be supplied in a compact binary format, which is
+| automatically recognized by its leading magic string BINARY_MAGIC, and
+| which is written by the --binaryoutput option. All integers are stored as
+| 64-bit unsigned little-endian words, and all reals as little-endian IEEE
+| 754 double precision numbers. The layout of the file is
+|
+|    "POINCARB"                               [magic string, 8 bytes]
+|    <version> <N>                            [format version, trajectories]
+|    <offset 1> <offset 2> ... <offset N>     [index of trajectory starts]
+|
+| after which the N trajectory blocks follow, each of them starting at the
+| byte offset given in the index, counted from the beginning of the file:
+|
+|    <M> <T> <L>                              [coordinates, ticks, labels]
+|    <s1[1]> ... <s1[M]>                      [S1 array, M doubles]
+|    <s2[1]> ... <s2[M]>                      [S2 array, M doubles]
+|    <s3[1]> ... <s3[M]>                      [S3 array, M doubles]
+|    <t[1]> ... <t[T]>                        [coordinate index of ticks]
+|    <c> <pos> <len> <text>                   [label table, L entries]
+|
+| In the label table, <c> is the coordinate index of the label, <pos> its
+| position code (TOPLABEL, ..., UPPERRIGHTLABEL), and <len> the number of
+| characters of the label text, which follows zero padded to a multiple of
+| eight bytes. Since the coordinates are stored as plain arrays, loading a
+| trajectory involves no tokenizing, and whenever the file is memory mapped
+| the index is used to locate each trajectory directly.
+-----------------------------------------------------------------------------*/
+
+/*
+ * The read_trajectory_bytes() routine copies the next |n| bytes of the
+ * input to |dst|, refilling the window of the input as needed.
+ */
+void read_trajectory_bytes(trajectoryinput *in,void *dst,size_t n) {
+   char *p=(char *)dst;
+   size_t k;
+   while (n>0) {
+      if ((k=refill_trajectory_input(in,1))==0) {
+         fprintf(stderr,"%s: Error: Unexpected end of binary trajectory "
+            "file.\n",progname);
+         exit(FAILURE);
+      }
+      if (k>n) k=n;
+      memcpy(p,(*in).buf+(*in).pos,k);
+      (*in).pos+=k;
+      p+=k;
+      n-=k;
+   }
+} /* end of read_trajectory_bytes() */
+
+/*
+ * The binary_word_order() routine tells in which byte order the doubles of
+ * the host are stored, by comparing the bytes of 1.0 against its IEEE 754
+ * representation. It returns 1 for little endian and 0 for big endian, and
+ * terminates the program if the host does not use IEEE 754 doubles at all.
+ */
+short binary_word_order(void) {
+   static const unsigned char one[8]={0,0,0,0,0,0,0xf0,0x3f};
+   double x=1.0;
+   unsigned char b[8];
+   int k;
+   memcpy(b,&x,8);
+   if (!memcmp(b,one,8)) return 1;
+   for (k=0;k<8;k++) if (b[k]!=one[7-k]) {
+      fprintf(stderr,"%s: Error: Binary trajectory format requires IEEE 754 "
+         "doubles.\n",progname);
+      exit(FAILURE);
+   }
+   return 0;
+} /* end of binary_word_order() */
+
+/*
+ * The swap_binary_words() routine reverses the byte order of each of the
+ * |n| consecutive 8-byte words starting at |v|, as needed on big-endian
+ * hosts when reading or writing the little-endian binary format.
+ */
+void swap_binary_words(void *v,long n) {
+   unsigned char *p=(unsigned char *)v,ch;
+   long k;
+   int j;
+   for (k=0;k<n;k++,p+=8) {
+      for (j=0;j<4;j++) {
+         ch=p[j];
+         p[j]=p[7-j];
+         p[7-j]=ch;
+      }
+   }
+} /* end of swap_binary_words() */
+
+/*
+ * The read_binary_word() routine reads an unsigned 64-bit little-endian word
+ * from the input, and returns its value as a long, terminating the program
+ * if the value does not fit into the range |0..maxval|.
+ */
+long read_binary_word(trajectoryinput *in,long maxval) {
+   unsigned char b[8];
+   unsigned long v;
+   read_trajectory_bytes(in,b,8);
+   v=((unsigned long)b[0])|(((unsigned long)b[1])<<8)|
+      (((unsigned long)b[2])<<16)|(((unsigned long)b[3])<<24);
+   if ((b[4]|b[5]|b[6]|b[7])||(v>(unsigned long)maxval)) {
+      fprintf(stderr,"%s: Error: Value out of range in binary trajectory "
+         "file.\n",progname);
+      exit(FAILURE);
+   }
+   return((long)v);
+} /* end of read_binary_word() */
+
+/*
+ * The detect_binary_trajectory_input() routine checks whether the input
+ * |in| starts with the magic string of the binary format. If so, the header
+ * and the index of trajectory offsets are read, and the |binary| flag of
+ * |in| is set, after which |scan_next_trajectory()| reads the trajectories
+ * with |read_binary_trajectory()| rather than with the text lexer.
+ */
+void detect_binary_trajectory_input(trajectoryinput *in) {
+   char magic[8];
+   long k,version;
+
+   if ((*in).fileptr==NULL) return;
+   if (refill_trajectory_input(in,8)<8) return;
+   if (memcmp((*in).buf+(*in).pos,BINARY_MAGIC,8)) return;
+   read_trajectory_bytes(in,magic,8);
+   if ((version=read_binary_word(in,LONG_MAX))!=BINARY_VERSION) {
+      fprintf(stderr,"%s: Error: Unsupported version %ld of binary "
+         "trajectory file.\n",progname,version);
+      exit(FAILURE);
+   }
+   (*in).binary=1;
+   (*in).numbinarytrajectories=read_binary_word(in,LONG_MAX/8);
+   (*in).binarytrajectory=0;
+   (*in).binaryindex=lvector(1,(*in).numbinarytrajectories);
+   for (k=1;k<=(*in).numbinarytrajectories;k++)
+      (*in).binaryindex[k]=read_binary_word(in,LONG_MAX);
+} /* end of detect_binary_trajectory_input() */
+
+/*-----------------------------------------------------------------------------
+| The read_binary_trajectory() routine is the binary counterpart of the text
+| scanning of |scan_next_trajectory()|, reading the next trajectory of the
+| binary input |in| into the scratch structure |st|. The labels are added
+| to the label arena of |st|, in the order of the label table. If the
+| input is memory mapped, the trajectory is located by the index; otherwise
+| the trajectory blocks are read in the order they are stored.
+-----------------------------------------------------------------------------*/
+short read_binary_trajectory(trajectoryinput *in,stoketraject *st) {
+   long k,n,j,m,coord;
+   int i,length;
+   short pos;
+   char pad[8],text[MAX_LABEL_TEXTLENGTH];
+
+   if ((*in).binarytrajectory>=(*in).numbinarytrajectories) return 0;
+   (*in).binarytrajectory++;
+   if ((*in).mapped) {
+      if ((size_t)(*in).binaryindex[(*in).binarytrajectory]>=(*in).len) {
+         fprintf(stderr,"%s: Error: Offset of trajectory %ld out of range in "
+            "binary trajectory file.\n",progname,(*in).binarytrajectory);
+         exit(FAILURE);
+      }
+      (*in).pos=(size_t)(*in).binaryindex[(*in).binarytrajectory];
+   }
+   n=read_binary_word(in,LONG_MAX/8);
+   (*st).numtickmarks=read_binary_word(in,n);
+   m=(long)read_binary_word(in,LONG_MAX/8);
+   while ((*st).maxcoords<n) grow_stoke_coordinates(st);
+   while ((*st).maxtickmarks<(*st).numtickmarks) grow_stoke_tickmarks(st);
+   (*st).numcoords=n;
+   read_trajectory_bytes(in,&((*st).s1[1]),(size_t)n*8);
+   read_trajectory_bytes(in,&((*st).s2[1]),(size_t)n*8);
+   read_trajectory_bytes(in,&((*st).s3[1]),(size_t)n*8);
+   if (!binary_word_order()) {
+      swap_binary_words(&((*st).s1[1]),n);
+      swap_binary_words(&((*st).s2[1]),n);
+      swap_binary_words(&((*st).s3[1]),n);
+   }
+   for (k=1;k<=(*st).numtickmarks;k++) {
+      (*st).tickmark[k]=read_binary_word(in,n);
+      if ((*st).tickmark[k]<1) {
+         fprintf(stderr,"%s: Error: Tick mark at coordinate 0 in binary "
+            "trajectory file.\n",progname);
+         exit(FAILURE);
+      }
+   }
+   for (j=1;j<=m;j++) {
+      coord=read_binary_word(in,n);
+      pos=(short)read_binary_word(in,UPPERRIGHTLABEL);
+      length=(int)read_binary_word(in,MAX_LABEL_TEXTLENGTH-1);
+      if ((coord<1)||(pos==NOLABEL)) {
+         fprintf(stderr,"%s: Error: Faulty label in binary trajectory "
+            "file.\n",progname);
+         exit(FAILURE);
+      }
+      add_label((*st).labels,coord,pos);
+      read_trajectory_bytes(in,text,(size_t)length);
+      for (i=0;i<length;i++) add_label_char((*st).labels,text[i]);
+      read_trajectory_bytes(in,pad,(size_t)((8-length%8)%8));
+      (*st).numlabels++;
+   }
+   return 1;
+} /* end of read_binary_trajectory() */
+
+/*-----------------------------------------------------------------------------
+| The scan_next_trajectory() routine scans the next trajectory of the input
+| |in| into the scratch structure |st|, including any begin and end labels,
+| and returns 1 (true) as soon as the closing 'q' (and any following end
+| label) of the trajectory has been scanned, or 0 (false) if there are no
+| more trajectories in the input. Input in the binary trajectory format is
+| handed over to |read_binary_trajectory()|. Whenever the rolling window |rw|
+| is given (not NULL), the points are handed over to it as they are scanned,
+| instead of being kept in |st|, to be drawn at once.
+-----------------------------------------------------------------------------*/
+short scan_next_trajectory(trajectoryinput *in,stoketraject *st,pmap *map,
+      rollingwindow *rw) {
+   double s1,s2,s3;
+   long numlabels;
+
+   if ((*in).binary) return(read_binary_trajectory(in,st));
+   if (!new_trajectory(in)) return 0;
+   if (rw!=NULL) begin_window_trajectory(rw,map);
+   if ((*map).verbose) fprintf(stdout,
+      "%s: New trajectory detected at line %ld\n",progname,(*in).linenum);
+   readaway_comments_and_blanks(in);
+   if (beginlabel(in)) { /* check for text label at begin point */
+      if ((*map).verbose)
+         fprintf(stdout, "%s: Begin-point label detected at line %ld\n",
+            progname,(*in).linenum);
+      scan_beginlabel(in,st,map,1);
+      readaway_comments_and_blanks(in);
+      if (((*map).verbose)&&((*st).numlabels>0))
+         display_last_label((*st).labels,"begin");
+   }
+   if ((*map).verbose) fprintf(stdout,
+      "%s: Scanning Stokes trajectory starting at line %ld.\n",
+         progname,(*in).linenum);
+   (*st).numcoords=0; /* reset coordinate counter */
+   while (!end_of_trajectory(in)) { /* scan current trajectory */
+      if (peek_trajectory_char(in)==EOF) {
+         fprintf(stderr,"%s: Error: Reached end of trajectory file "
+            "at line %ld without any closing 'q'.\n",progname,(*in).linenum);
+         exit(FAILURE);
+      }
+      if (rw!=NULL) { /* hand the point over to the rolling window */
+         scan_stokes_triplet(in,&s1,&s2,&s3);
+         add_window_point(rw,s1,s2,s3,map);
+         (*st).numcoords=(*rw).numcoords; /* as the point of any label */
+         readaway_comments_and_blanks(in);
+         if (tickmark(in)) (*rw).tick[3]=1;
+      } else {
+         scan_for_stokes_triplet(in,st);
+         if ((*map).density!=NULL) add_density_point((*map).density,st);
+         readaway_comments_and_blanks(in);
+         scan_for_tickmark(in,st);
+      }
+      readaway_comments_and_blanks(in);
+      scan_for_tickmarklabel(in,st,map);
+      readaway_comments_and_blanks(in);
+      if (rw!=NULL) resolve_window_labels(rw,st);
+   }
+   if ((*map).verbose) fprintf(stdout,
+      "%s: End of Stokes trajectory detected at line %ld.\n",
+         progname,(*in).linenum);
+   readaway_comments_and_blanks(in);
+   if (endlabel(in)) { /* check for text label at end point */
+      if ((*map).verbose) fprintf(stdout,
+         "%s: End-point label detected at line %ld\n",progname,(*in).linenum);
+      numlabels=(*st).numlabels;
+      scan_endlabel(in,st,map,(*st).numcoords);
+      readaway_comments_and_blanks(in);
+      if (((*map).verbose)&&((*st).numlabels>numlabels))
+         display_last_label((*st).labels,"end");
+   }
+   return 1;
+} /* end of scan_next_trajectory() */
+
+/*-----------------------------------------------------------------------------
+| The scan_trajectory_file() routine parses the trajectories of Stokes
+| parameters from the input file (if a filename containing the path was
+| specified at startup of the program), and keeps them in the trajectory
+| store |ts|. The file is parsed once only, after which the hidden and
+| visible passes of |write_scanned_trajectories()| both operate on the store.
+|
+| This routine also particularly checks for statments of labels to be applied
+| at the begin and end points of the trajectories, that is to say, checking
+| for statements of type 'b <pos> "TeX label string"' or 'e <pos> "TeX label
+| string"' immediately after the 'p' and 'q' statements of each trajectory.
+| These labels could equally well be supplied as regular labels after the
+| first and last triplets of data, but in some cases it is for example in
+| batch mode operation easier to simply concatenate in the Stokes data without
+| having to manually go in and add these label statements. This is the very
+| reason for this additional feature of begin and end label statements in the
+| data syntax as accepted by the program.
+|
+| Throughout the parsing of each Stokes parameter trajectory, the data set is
+| kept in the scratch structure |st| (short for Stokes trajectory), of type
+| |stoketraject| as defined in the definitions section of this program, and
+| is then copied into the store as the end of the trajectory is reached.
+-----------------------------------------------------------------------------*/
+void scan_trajectory_file(trajectorystore *ts,pmap map) {
+   FILE *infileptr = NULL;
+   long decoderpid; /* process decoding a compressed file, if nonzero */
+   trajectoryinput in; /* lexer state for scanning the input file */
+   stoketraject st; /* data structure for keeping track of trajectories */
+
+   initialize_trajectory_store(ts);
+   infileptr=open_infile(map,&decoderpid); /* file of Stokes triplets */
+   /*-------------------------------------------------------------------------
+   | If the file pointer |infileptr| after opening the file with the
+   | |open_infile()| routine points to NULL, this indicates that the filename
+   | was empty, and that now Stokes trajectories hence should be read from
+   | file. If there was a problem opening the file for reading, due to read
+   | permissions, file existence etc, this would automatically have taken
+   | care of by the |open_infile()| routine.
+   -------------------------------------------------------------------------*/
+   if (infileptr!=NULL) {
+      initialize_stoke_trajectory(&st); /* Allocate memory for arrays etc. */
+      st.labels=&((*ts).labels); /* labels are kept in the store's arena */
+      reset_stokes_trajectory_struct(&st); /* Make sure all data is cleared */
+      initialize_trajectory_input(&in,infileptr,decoderpid); /* line 1 */
+      detect_binary_trajectory_input(&in);
+      while (scan_next_trajectory(&in,&st,&map,NULL)) {
+         count_scanned_trajectory(map.stats,&st);
+         store_scanned_trajectory(ts,&st);
+         reset_stokes_trajectory_struct(&st);
+      } /* End of "while (scan_next_trajectory(...)) ..." */
+      if (map.stats!=NULL) (*map.stats).bytesread+=in.numread;
+      close_trajectory_input(&in);
+      free_stoke_trajectory(&st);
+   }
+} /* end of scan_trajectory_file() */
+
+/*-----------------------------------------------------------------------------
+| Draw the trajectories of Stokes parameters, as previously scanned into the
+| trajectory store |ts|, on the Poincare sphere.
+| In order to properly take care of the fact that we might be over-writing
+| parts of the 'visible' parts of the path with 'invisible' parts from the
+| hidden parts of the Poincare sphere, we must traverse the path-drawing
+| routine twice, in the second run only writing the parts that are visible.
+| This is only important when the shade of the front, 'visible' paths are
+| different from the paths in the back, 'invisible' parts of the sphere.
+| Notice that, for example, with hidden parts of the path drawn with black,
+| dashed lines, and visible part drawn with solid black lines, it does not
+| matter whether this two-pass drawing takes place or not.
+|
+| Depending on whether the boolean input variable |viewtype| is |HIDDEN| or
+| |VISIBLE|, this routine will either flush out the hidden or visible parts
+| of the Stokes trajectories. This construction is done in order for the main
+| program to call the routine in two passes after each other, one for the
+| hidden parts and one for the visible parts (which we do not wish to have
+| later overwritten by hidden parts of other trajectories scanned later on.
+| This switch is not explicitly present in the algorithm of this routine, but
+| rather just used as passed on to the routines |add_scanned_trajectory()| and
+| |add_scanned_tickmarks()|, which take care of adding the hidden ans visible
+| trajectories with tickmarks in a coherent manner.
+|
+| As being the key routine in the flushing of the Stokes trajectories to
+| file, this routine also takes care of writing any present tick marks or
+| labels, by calling the |add_scanned_tickmarks()| and |add_scanned_labels()|
+| routines.
+-----------------------------------------------------------------------------*/
+void write_trajectory_layer_prologue(mpbuffer *out,pmap map) {
+   if ((*out).format!=METAPOST_FORMAT) return;
+   mp_printf(out,"  oldahangle:=ahangle;\n");
+   mp_printf(out,"  ahangle:=%f;\n",map.arrowheadangle);
+   mp_printf(out,"  pickup pencircle scaled %f pt;\n",map.paththickness);
+}
+
+void write_trajectory_layer_epilogue(mpbuffer *out) {
+   if ((*out).format!=METAPOST_FORMAT) return;
+   mp_printf(out,"  ahangle:=oldahangle;\n");
+}
+
+void write_scanned_trajectory(mpbuffer *out,stoketraject *st,pmap *map,
+      short viewtype) {
+   add_scanned_trajectory(out,st,map,viewtype);
+   add_scanned_tickmarks(out,st,map,viewtype);
+   add_scanned_labels(out,st,map);
+}
+
+void write_scanned_trajectories(mpbuffer *out,pmap map,
+      trajectorystore *ts,short viewtype) {
+   long k;
+
+   if (map.user_specified_inputfile) {
+      write_trajectory_layer_prologue(out,map);
+      for (k=1;k<=(*ts).numtrajectories;k++)
+         write_scanned_trajectory(out,&((*ts).trajectory[k]),&map,
+            viewtype);
+      write_trajectory_layer_epilogue(out);
+   }
+} /* end of write_scanned_trajectories() */
+
+/*
+ * The write_trajectory_share() routine does the work of one thread of
+ * |write_threaded_trajectories()|, as described by the |trajectoryworker|
+ * pointed to by |arg|.
+ */
+void *write_trajectory_share(void *arg) {
+   trajectoryworker *w=(trajectoryworker *)arg;
+   long k;
+   for (k=(*w).first;k<=(*w).last;k++) {
+      write_scanned_trajectory(&((*w).hidden),&((*(*w).ts).trajectory[k]),
+         (*w).map,HIDDEN);
+      write_scanned_trajectory(&((*w).visible),&((*(*w).ts).trajectory[k]),
+         (*w).map,VISIBLE);
+   }
+   return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+| The write_threaded_trajectories() routine is used instead of the two passes
+| of |write_scanned_trajectories()| whenever the --threads option asks for
+| more than one thread. The trajectories of the store are then divided into
+| consecutive shares of roughly the same number of coordinates, one for each
+| thread, each of which maps both layers of its share into buffers of its
+| own. Once all threads are done, the hidden layers of all shares are
+| appended to the output in order, followed by the visible layers, giving
+| the very same output as the serial passes.
+|
+| Only the mapping of the trajectories is made in parallel, since the
+| trajectories never share any data while being mapped; the parameter map is
+| only read. On systems without POSIX threads, or if a thread could not be
+| created, the shares are simply mapped one after the other.
+-----------------------------------------------------------------------------*/
+void write_threaded_trajectories(mpbuffer *out,pmap map,trajectorystore *ts) {
+   trajectoryworker *worker;
+#ifdef POSIX_SYSTEM
+   pthread_t *thread;
+   short *started;
+#endif
+   double total=0.0,sum=0.0;
+   long k;
+   int w,nw=map.num_threads;
+
+   if (nw>(*ts).numtrajectories) nw=(int)(*ts).numtrajectories;
+   if ((nw<=1)||(!map.user_specified_inputfile)) {
+      write_scanned_trajectories(out,map,ts,HIDDEN);
+      write_scanned_trajectories(out,map,ts,VISIBLE);
+      return;
+   }
+   if ((worker=(trajectoryworker *)malloc(nw*sizeof(trajectoryworker)))
+         ==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "write_threaded_trajectories()\n",progname);
+      exit(FAILURE);
+   }
+   for (k=1;k<=(*ts).numtrajectories;k++)
+      total+=(double)((*ts).trajectory[k].numcoords+1);
+   for (w=0,k=1;w<nw;w++) { /* consecutive shares of about total/nw each */
+      worker[w].map=&map;
+      worker[w].ts=ts;
+      worker[w].first=k;
+      do { /* leaving at least one trajectory for each remaining share */
+         sum+=(double)((*ts).trajectory[k].numcoords+1);
+         k++;
+      } while ((k<=(*ts).numtrajectories-(nw-1-w))
+         &&((w==nw-1)||(sum<total*(w+1)/nw)));
+      worker[w].last=k-1;
+      initialize_mpbuffer(&(worker[w].hidden),NULL);
+      initialize_mpbuffer(&(worker[w].visible),NULL);
+      worker[w].hidden.format=worker[w].visible.format=(*out).format;
+   }
+#ifdef POSIX_SYSTEM
+   thread=(pthread_t *)malloc(nw*sizeof(pthread_t));
+   started=svector(0,nw-1);
+   for (w=0;w<nw;w++) {
+      started[w]=((thread!=NULL)&&(pthread_create(&thread[w],NULL,
+         write_trajectory_share,&worker[w])==0));
+      if (!started[w]) write_trajectory_share(&worker[w]);
+   }
+   for (w=0;w<nw;w++) if (started[w]) pthread_join(thread[w],NULL);
+   free_svector(started,0,nw-1);
+   free(thread);
+#else
+   for (w=0;w<nw;w++) write_trajectory_share(&worker[w]);
+#endif
+   write_trajectory_layer_prologue(out,map);
+   for (w=0;w<nw;w++) {
+      append_mpbuffer(out,&(worker[w].hidden));
+      free_mpbuffer(&(worker[w].hidden));
+   }
+   write_trajectory_layer_epilogue(out);
+   write_trajectory_layer_prologue(out,map);
+   for (w=0;w<nw;w++) {
+      append_mpbuffer(out,&(worker[w].visible));
+      free_mpbuffer(&(worker[w].visible));
+   }
+   write_trajectory_layer_epilogue(out);
+   free(worker);
+} /* end of write_threaded_trajectories() */
+
+/*-----------------------------------------------------------------------------
+| The stream_trajectory_file() routine is used instead of the pair of
+| |scan_trajectory_file()| and |write_scanned_trajectories()| whenever the
+| trajectories are read from stdin (--inputfile -) or from a compressed
+| file, or in memory save mode (--save_memory). Each trajectory is then
+| mapped as soon as its closing 'q' has arrived, after which its memory is
+| reused for the next one, so that the memory needed is bounded by the
+| largest single trajectory rather than by the whole input. Wherever the
+| rolling window applies, as by |rolling_window_applies()|, even a single
+| trajectory is drawn while it is scanned, with the memory bounded by the
+| buffers of the layers rather than by the length of the trajectory.
+|
+| Since all hidden parts must be drawn before any visible parts, the hidden
+| layer is written directly to the output, while the visible layer is
+| spilled to a temporary file, which is appended to the output once the end
+| of the input is reached. The generated MetaPost code is identical to that
+| obtained when reading the same trajectories from a regular file.
+-----------------------------------------------------------------------------*/
+void stream_trajectory_file(mpbuffer *out,pmap map) {
+   FILE *spillfileptr;
+   mpbuffer spill; /* buffer for the visible layer, spilled to file */
+   trajectoryinput in; /* lexer state for scanning the input stream */
+   stoketraject st; /* data structure for keeping track of trajectories */
+   labelarena labels; /* labels of the trajectory currently being drawn */
+   rollingwindow rw; /* state of the trajectory drawn while it is scanned */
+   short windowed;
+   char buf[BUFSIZ];
+   size_t n;
+   FILE *infileptr;
+   long decoderpid; /* process decoding a compressed file, if nonzero */
+
+   if ((spillfileptr=tmpfile())==NULL) {
+      fprintf(stderr,"%s: Error: Couldn't open temporary file for the "
+         "visible layer of trajectories.\n",progname);
+      exit(FAILURE);
+   }
+   initialize_mpbuffer(&spill,spillfileptr);
+   spill.format=(*out).format;
+   write_trajectory_layer_prologue(out,map);
+   write_trajectory_layer_prologue(&spill,map);
+   initialize_stoke_trajectory(&st);
+   initialize_label_arena(&labels);
+   st.labels=&labels;
+   reset_stokes_trajectory_struct(&st);
+   infileptr=open_infile(map,&decoderpid);
+   initialize_trajectory_input(&in,infileptr,decoderpid);
+   detect_binary_trajectory_input(&in);
+   windowed=rolling_window_applies(out,&map,&in);
+   if (windowed) initialize_rolling_window(&rw,out,&spill);
+   while (scan_next_trajectory(&in,&st,&map,(windowed?&rw:NULL))) {
+      if (windowed) {
+         end_window_trajectory(&rw,&st,&map);
+      } else {
+         write_scanned_trajectory(out,&st,&map,HIDDEN);
+         write_scanned_trajectory(&spill,&st,&map,VISIBLE);
+         count_scanned_trajectory(map.stats,&st);
+         count_drawn_segments(map.stats,&st);
+      }
+      flush_mpbuffer(out);
+      reset_label_arena(&labels);
+      reset_stokes_trajectory_struct(&st);
+   }
+   if (windowed) free_rolling_window(&rw);
+   if (map.stats!=NULL) (*map.stats).bytesread+=in.numread;
+   close_trajectory_input(&in);
+   free_stoke_trajectory(&st);
+   free_label_arena(&labels);
+   write_trajectory_layer_epilogue(out);
+   write_trajectory_layer_epilogue(&spill);
+   if (spill.llx<=spill.urx) { /* merge the bounding box of the layer */
+      vec_extend_bbox(out,spill.llx,spill.lly);
+      vec_extend_bbox(out,spill.urx,spill.ury);
+   }
+   free_mpbuffer(&spill);
+   rewind(spillfileptr);
+   while ((n=fread(buf,1,BUFSIZ,spillfileptr))>0) mp_write(out,buf,n);
+   fclose(spillfileptr);
+} /* end of stream_trajectory_file() */
+
+/*
+ * The write_binary_word() routine writes |v| to |outfileptr| as an unsigned
+ * 64-bit little-endian word of the binary trajectory format.
+ */
+void write_binary_word(FILE *outfileptr,unsigned long v) {
+   unsigned char b[8];
+   int k;
+   for (k=0;k<8;k++) {
+      b[k]=(unsigned char)(v&0xff);
+      v=(v>>4)>>4; /* two shifts, since |v| may be only 32 bits wide */
+   }
+   fwrite(b,1,8,outfileptr);
+}
+
+void write_binary_doubles(FILE *outfileptr,double *v,long n) {
+   unsigned char b[8];
+   long k;
+   if (binary_word_order()) {
+      fwrite(v,8,(size_t)n,outfileptr);
+   } else {
+      for (k=0;k<n;k++) {
+         memcpy(b,&(v[k]),8);
+         swap_binary_words(b,1);
+         fwrite(b,1,8,outfileptr);
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+| The write_binary_trajectory_file() routine is the converter from the text
+| format of trajectories to the binary format, as described together with
+| |read_binary_trajectory()|, writing all trajectories of the store |ts| to
+| the file specified with the --binaryoutput option. The offsets of the index
+| are computed from the sizes of the trajectories before anything is written.
+-----------------------------------------------------------------------------*/
+void write_binary_trajectory_file(pmap map,trajectorystore *ts) {
+   static const char zeros[8]={0,0,0,0,0,0,0,0};
+   FILE *outfileptr;
+   stoketraject *tr;
+   unsigned long offset;
+   long k;
+   int j;
+
+   if ((outfileptr=fopen(map.binfilename,"wb"))==NULL) {
+      fprintf(stderr,"%s: Couldn't open file %s for binary output!\n",
+         progname,map.binfilename);
+      exit(FAILURE);
+   }
+   if (map.verbose)
+      printf("%s: Writing binary trajectories to %s\n",progname,
+         map.binfilename);
+   fwrite(BINARY_MAGIC,1,8,outfileptr);
+   write_binary_word(outfileptr,BINARY_VERSION);
+   write_binary_word(outfileptr,(unsigned long)(*ts).numtrajectories);
+   offset=8*(3+(unsigned long)(*ts).numtrajectories);
+   for (k=1;k<=(*ts).numtrajectories;k++) {
+      tr=&((*ts).trajectory[k]);
+      write_binary_word(outfileptr,offset);
+      offset+=8*(3+3*(unsigned long)(*tr).numcoords+(*tr).numtickmarks);
+      for (j=(*tr).firstlabel+1;j<=(*tr).firstlabel+(*tr).numlabels;j++)
+         offset+=8*(3+((unsigned long)(*ts).labels.length[j]+7)/8);
+   }
+   if (map.stats!=NULL) (*map.stats).byteswritten+=offset; /* file size */
+   for (k=1;k<=(*ts).numtrajectories;k++) {
+      tr=&((*ts).trajectory[k]);
+      write_binary_word(outfileptr,(unsigned long)(*tr).numcoords);
+      write_binary_word(outfileptr,(unsigned long)(*tr).numtickmarks);
+      write_binary_word(outfileptr,(unsigned long)(*tr).numlabels);
+      write_binary_doubles(outfileptr,&((*tr).s1[1]),(*tr).numcoords);
+      write_binary_doubles(outfileptr,&((*tr).s2[1]),(*tr).numcoords);
+      write_binary_doubles(outfileptr,&((*tr).s3[1]),(*tr).numcoords);
+      for (j=1;j<=(*tr).numtickmarks;j++)
+         write_binary_word(outfileptr,(unsigned long)(*tr).tickmark[j]);
+      for (j=(*tr).firstlabel+1;j<=(*tr).firstlabel+(*tr).numlabels;j++) {
+         write_binary_word(outfileptr,(unsigned long)(*ts).labels.coord[j]);
+         write_binary_word(outfileptr,(unsigned long)(*ts).labels.pos[j]);
+         write_binary_word(outfileptr,(unsigned long)(*ts).labels.length[j]);
+         fwrite(&((*ts).labels.text[(*ts).labels.offset[j]]),1,
+            (size_t)(*ts).labels.length[j],outfileptr);
+         fwrite(zeros,1,(size_t)((8-(*ts).labels.length[j]%8)%8),outfileptr);
+      }
+   }
+   if (ferror(outfileptr)||fclose(outfileptr)) {
+      fprintf(stderr,"%s: Error: Failed writing binary trajectories to %s\n",
+         progname,map.binfilename);
+      exit(FAILURE);
+   }
+} /* end of write_binary_trajectory_file() */
+
+/*-----------------------------------------------------------------------------
+| Draw any additional arrows (if specified by user) onto the Poincare sphere.
+| This feature is useful for example whenever there is a distinct transition
+| between two polarization states that need to be pointed out, or whenever
+| just a principal change is to be pointed out.
+-----------------------------------------------------------------------------*/
+/*
+ * The get_arrow_screen_coordinates() routine calculates the screen
+ * coordinates (x,y) of the point at the parameter |t| (0<=t<=1) along the
+ * great circle of an additional arrow from the Stokes triplet
+ * (s1a,s2a,s3a) towards (s1b,s2b,s3b).
+ */
+void get_arrow_screen_coordinates(double *x,double *y,double t,
+      double s1a,double s2a,double s3a,double s1b,double s2b,double s3b,
+      pmap map) {
+   double s1,s2,s3,snorm;
+   s1=(1.0 - t)*s1a + t*s1b;
+   s2=(1.0 - t)*s2a + t*s2b;
+   s3=(1.0 - t)*s3a + t*s3b;
+   snorm=sqrt(s1*s1+s2*s2+s3*s3);
+   s1 /= snorm;
+   s2 /= snorm;
+   s3 /= snorm;
+   (*x)= s1*sin(map.rot_psi)+s2*cos(map.rot_psi);
+   (*y)=-s1*cos(map.rot_psi)*sin(map.rot_phi) + \
+           s2*sin(map.rot_psi)*sin(map.rot_phi) + \
+           s3*cos(map.rot_phi);
+}
+
+/*-----------------------------------------------------------------------------
+| The write_native_arrows() routine is the counterpart of
+| |write_additional_arrows()| for the native vector output. As in the
+| MetaPost code, the first half of each arrow carries the arrow head, while
+| the second half continues to the end point.
+-----------------------------------------------------------------------------*/
+void write_native_arrows(mpbuffer *out,pmap map) {
+   double x[NUM_ARROW_POINTS+1],y[NUM_ARROW_POINTS+1],a[4],b[4],snorm,gray;
+   double radius=map.scalefactor*BP_PER_MM;
+   int i,j,k,half;
+   short dashed;
+
+   for (i=1;i<=map.numarrows;i++) {
+      for (j=1;j<=3;j++) {
+         a[j]=map.arrows[j][i];
+         b[j]=map.arrows[j+3][i];
+      }
+      if (map.use_normalized_stokes_params) {
+         snorm=sqrt(a[1]*a[1]+a[2]*a[2]+a[3]*a[3]);
+         for (j=1;j<=3;j++) a[j]/=snorm;
+         snorm=sqrt(b[1]*b[1]+b[2]*b[2]+b[3]*b[3]);
+         for (j=1;j<=3;j++) b[j]/=snorm;
+      }
+      if ((-0.5<=map.arrows[7][i])&&(map.arrows[7][i]<0.5)) {
+         dashed=0;
+      } else if ((0.5<=map.arrows[7][i])&&(map.arrows[7][i]<1.5)) {
+         dashed=1;
+      } else {
+         continue; /* as in the MetaPost code, other styles are not drawn */
+      }
+      gray=1.0-map.arrows[8][i];
+      for (half=0;half<=1;half++) {
+         for (k=1;k<=NUM_ARROW_POINTS;k++) {
+            get_arrow_screen_coordinates(&x[k],&y[k],
+               0.5*(half+(k-1.0)/(NUM_ARROW_POINTS-1)),
+               a[1],a[2],a[3],b[1],b[2],b[3],map);
+            x[k]*=radius;
+            y[k]*=radius;
+         }
+         vec_stroke(out,x,y,NUM_ARROW_POINTS,1,gray,0.5*BP_PER_PT,dashed);
+         if (half==0)
+            vec_arrowhead(out,x[NUM_ARROW_POINTS],y[NUM_ARROW_POINTS],
+               x[NUM_ARROW_POINTS-1],y[NUM_ARROW_POINTS-1],
+               METAPOST_AHANGLE,gray);
+      }
+   }
+} /* end of write_native_arrows() */
+
+void write_additional_arrows(mpbuffer *out,pmap map) {
+   int i;
+   double s1a,s2a,s3a,s1b,s2b,s3b,t,dt=0.02,xtmp,ytmp;
+   if ((*out).format!=METAPOST_FORMAT) {
+      write_native_arrows(out,map);
+      return;
+   }
+   if (map.numarrows > 0) {
+      mp_printf(out,
+         "%%\n"
+         "%% Draw the paths of the arrows specified by the user.\n"
+         "%%\n");
+      mp_printf(out,"   pickup pencircle scaled 0.5pt;\n");
+      for (i=1;i<=map.numarrows;i++) {
+         s1a=map.arrows[1][i];
+         s2a=map.arrows[2][i];
+         s3a=map.arrows[3][i];
+         s1b=map.arrows[4][i];
+         s2b=map.arrows[5][i];
+         s3b=map.arrows[6][i];
+         if (map.use_normalized_stokes_params) {
+            xtmp=sqrt(s1a*s1a+s2a*s2a+s3a*s3a);
+            s1a=s1a/xtmp;
+            s2a=s2a/xtmp;
+            s3a=s3a/xtmp;
+            xtmp=sqrt(s1b*s1b+s2b*s2b+s3b*s3b);
+            s1b=s1b/xtmp;
+            s2b=s2b/xtmp;
+            s3b=s3b/xtmp;
+         }
+         mp_printf(out,"   p := makepath makepen\n");
+         mp_printf(out,"      ");
+         for (t=0.0;t<=0.5+dt/1000.0;t+=dt) {
+            if (t > dt) mp_printf(out,"                  ");
+            if (t > 0.0) mp_printf(out,"..");
+            get_arrow_screen_coordinates(&xtmp,&ytmp,t,s1a,s2a,s3a,
+               s1b,s2b,s3b,map);
+            mp_printf(out,"(%f,%f)",xtmp,ytmp);
+            if ((t > (0.0+dt/1000.0)) && (t < (0.5-dt/1000.0)))
+               mp_printf(out,"\n");
+         }
+         mp_printf(out,";\n");
+         if ((-0.5 <= map.arrows[7][i]) && (map.arrows[7][i] < 0.5)) {
+            mp_printf(out,\
+               "   drawarrow p scaled radius withcolor %f [white,black];\n",\
+                                                          map.arrows[8][i]);
+         } else if ((0.5 <= map.arrows[7][i]) && (map.arrows[7][i] < 1.5)) {
+            mp_printf(out,\
+               "   drawarrow p scaled radius dashed evenly withcolor %f"
+               " [white,black];\n", map.arrows[8][i]);
+         }
+         mp_printf(out,"   p := makepath makepen\n");
+         mp_printf(out,"      ");
+         for (t=0.5;t<=1.0+dt/1000.0;t+=dt) {
+            if (t > 0.5+dt) mp_printf(out,"                  ");
+            if (t > 0.5) mp_printf(out,"..");
+            get_arrow_screen_coordinates(&xtmp,&ytmp,t,s1a,s2a,s3a,
+               s1b,s2b,s3b,map);
+            mp_printf(out,"(%f,%f)",xtmp,ytmp);
+            if ((t > (0.5+dt/1000.0)) && (t < (1.0-dt/1000.0)))
+               mp_printf(out,"\n");
+         }
+         mp_printf(out,";\n");
+         if ((-0.5 <= map.arrows[7][i]) && (map.arrows[7][i] < 0.5)) {
+            mp_printf(out,\
+               "   draw p scaled radius withcolor %f [white,black];\n",\
+                                                           map.arrows[8][i]);
+         } else if ((0.5 <= map.arrows[7][i]) && (map.arrows[7][i] < 1.5)) {
+            mp_printf(out,\
+               "   draw p scaled radius dashed evenly withcolor %f"
+               " [white,black];\n", map.arrows[8][i]);
+         }
+      }
+   }
+}
+
+/*-----------------------------------------------------------------------------
+| The write_native_axis() routine draws, for the native vector output, the
+| coordinate axis along the projected unit vector (ex,ey), from |neglen|
+| behind origo (if the axes are to be drawn inside the sphere) to |poslen|
+| outside it, with the label |text| at its arrow head. The
+| write_native_coordinate_axes() routine is the counterpart of both
+| |write_coordinate_axes()| and |write_additional_coordinate_axes()|.
+-----------------------------------------------------------------------------*/
+void write_native_axis(mpbuffer *out,pmap map,double ex,double ey,
+      double neglen,double poslen,const char *text,short labelpos) {
+   double x[3],y[3],width,radius=map.scalefactor*BP_PER_MM;
+
+   width=map.coordaxisthickness*BP_PER_PT;
+   if (map.draw_axes_inside_sphere) {
+      x[1]=-neglen*radius*ex;
+      y[1]=-neglen*radius*ey;
+      x[2]=radius*ex;
+      y[2]=radius*ey;
+      vec_stroke(out,x,y,2,0,1.0-0.85,width,1);
+   }
+   x[1]=radius*ex;
+   y[1]=radius*ey;
+   x[2]=poslen*radius*ex;
+   y[2]=poslen*radius*ey;
+   vec_stroke(out,x,y,2,0,0.0,width,0);
+   vec_arrowhead(out,x[2],y[2],x[1],y[1],METAPOST_AHANGLE,0.0);
+   vec_label(out,text,1,x[2],y[2],labelpos);
+}
+
+void write_native_coordinate_axes(mpbuffer *out,pmap map) {
+   double spsi,cpsi,sphi,cphi;
+
+   write_native_axis(out,map,map.view[0][0],map.view[1][0],
+      map.neg_axis_length_s1,map.pos_axis_length_s1,
+      (map.user_specified_axislabels ? map.axislabel_s1
+         : (map.use_normalized_stokes_params ? "S_1/S_0" : "S_1")),
+      label_position(map.axislabelposition_s1));
+   write_native_axis(out,map,map.view[0][1],map.view[1][1],
+      map.neg_axis_length_s2,map.pos_axis_length_s2,
+      (map.user_specified_axislabels ? map.axislabel_s2
+         : (map.use_normalized_stokes_params ? "S_2/S_0" : "S_2")),
+      label_position(map.axislabelposition_s2));
+   write_native_axis(out,map,map.view[0][2],map.view[1][2],
+      map.neg_axis_length_s3,map.pos_axis_length_s3,
+      (map.user_specified_axislabels ? map.axislabel_s3
+         : (map.use_normalized_stokes_params ? "S_3/S_0" : "S_3")),
+      label_position(map.axislabelposition_s3));
+   if (!map.user_specified_additional_coordinate_system) return;
+   spsi=sin(map.rot_psi+map.delta_rot_psi);
+   cpsi=cos(map.rot_psi+map.delta_rot_psi);
+   sphi=sin(map.rot_phi+map.delta_rot_phi);
+   cphi=cos(map.rot_phi+map.delta_rot_phi);
+   if (map.user_specified_xtra_axislabel_x)
+      write_native_axis(out,map,spsi,-cpsi*sphi,map.xtra_neg_axis_length_x,
+         map.xtra_pos_axis_length_x,map.xtra_axislabel_x,BOTTOMLABEL);
+   if (map.user_specified_xtra_axislabel_y)
+      write_native_axis(out,map,cpsi,spsi*sphi,map.xtra_neg_axis_length_y,
+         map.xtra_pos_axis_length_y,map.xtra_axislabel_y,BOTTOMLABEL);
+   if (map.user_specified_xtra_axislabel_z)
+      write_native_axis(out,map,0.0,cphi,map.xtra_neg_axis_length_z,
+         map.xtra_pos_axis_length_z,map.xtra_axislabel_z,TOPLABEL);
+} /* end of write_native_coordinate_axes() */
+
+/*-----------------------------------------------------------------------------
+| Draw the coordinate axes of the $(S_1,S_2,S_3)$-space.
+-----------------------------------------------------------------------------*/
+void write_coordinate_axes(mpbuffer *out,pmap map) {
+if ((*out).format!=METAPOST_FORMAT) {
+   write_native_coordinate_axes(out,map);
+   return;
+}
+mp_printf(out,
+ "%%\n"
+ "%% Draw the $S_1$-, $S_2$- and $S_3$-axis of the Poincare sphere.\n"
+ "%% First of all, calculate the transformations of the intersections\n"
+ "%% for the unity sphere.\n"
+ "%%\n");
+mp_printf(out,
+ "%% Used variables:\n"
+ "%%\n"
+ "%%    behind_distance : Specifies the relative distance of the coordi-\n"
+ "%%                      axes to be plotted behind origo (in negative di-\n"
+ "%%                      rection of respective axis.\n"
+ "%%\n");
+mp_printf(out,
+ "%%   outside_distance_s1 : The relative distance from origo to the point\n"
+ "%%                         of the arrow head of the coordinate axis S1.\n"
+ "%%                         If this is set to 1.0, the arrow head will\n"
+ "%%                         point directly at the Poincare sphere.\n"
+ "%%\n");
+mp_printf(out,
+ "%%   outside_distance_s2 : Same as above, except that this one controls\n"
+ "%%                         the S2 coordinate axis instead.\n"
+ "%%\n");
+mp_printf(out,
+ "%%   outside_distance_s3 : Same as above, except that this one controls\n"
+ "%%                         the S3 coordinate axis instead.\n"
+ "%%\n");
+mp_printf(out,
+ "%%    insidecolval :    Specifies the shade of gray to use for the parts\n"
+ "%%                      of the coordinate axes that are inside the Poin-\n"
+ "%%                      care sphere. Values must be between 0 and 1,\n"
+ "%%                      where:  '0.0' <=> 'white';  '1.0' <=> 'black'\n"
+ "%%\n");
+mp_printf(out,
+ "   behind_distance_s1  := -%f;\n"
+ "   behind_distance_s2  := -%f;\n"
+ "   behind_distance_s3  := -%f;\n"
+ "   outside_distance_s1 :=  %f;\n"
+ "   outside_distance_s2 :=  %f;\n"
+ "   outside_distance_s3 :=  %f;\n"
+ "   insidecolval := .85;    %% '0.0' <=> 'white';  '1.0' <=> 'black'\n"
+ "\n",
+   map.neg_axis_length_s1, map.neg_axis_length_s2, map.neg_axis_length_s3,
+   map.pos_axis_length_s1, map.pos_axis_length_s2, map.pos_axis_length_s3);
+   mp_printf(out,
+     "   pickup pencircle scaled %f pt;\n",map.coordaxisthickness);
+
+mp_printf(out,
+ "%%\n"
+ "%% Start with drawing the x-axis...\n"
+ "%%\n"
+ "   x_bis_start :=  radius*behind_distance_s1*cosd(rot_psi)*cosd(rot_phi);\n"
+ "   y_bis_start :=  radius*behind_distance_s1*sind(rot_psi);\n"
+ "   z_bis_start := -radius*behind_distance_s1*cosd(rot_psi)*sind(rot_phi);\n"
+ "   x_bis_intersect :=  radius*cosd(rot_psi)*cosd(rot_phi);\n"
+ "   y_bis_intersect :=  radius*sind(rot_psi);\n"
+ "   z_bis_intersect := -radius*cosd(rot_psi)*sind(rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (outside_distance_s1*y_bis_intersect,\n"
+ "              outside_distance_s1*z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.%s(btex $%s$ etex,\n"
+ "             (outside_distance_s1*y_bis_intersect,\n"
+ "              outside_distance_s1*z_bis_intersect));\n"
+ "\n",map.axislabelposition_s1,
+(map.user_specified_axislabels ? map.axislabel_s1
+   : (map.use_normalized_stokes_params ? "S_1/S_0" : "S_1")));
+
+mp_printf(out,
+ "%%\n"
+ "%% ... then draw the y-axis ...\n"
+ "%%\n"
+ "   x_bis_start := -radius*behind_distance_s2*sind(rot_psi)*cosd(rot_phi);\n"
+ "   y_bis_start :=  radius*behind_distance_s2*cosd(rot_psi);\n"
+ "   z_bis_start :=  radius*behind_distance_s2*sind(rot_psi)*sind(rot_phi);\n"
+ "   x_bis_intersect := -radius*sind(rot_psi)*cosd(rot_phi);\n"
+ "   y_bis_intersect :=  radius*cosd(rot_psi);\n"
+ "   z_bis_intersect :=  radius*sind(rot_psi)*sind(rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (outside_distance_s2*y_bis_intersect,\n"
+ "              outside_distance_s2*z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.%s(btex $%s$ etex,\n"
+ "             (outside_distance_s2*y_bis_intersect,\n"
+ "              outside_distance_s2*z_bis_intersect));\n"
+ "\n",map.axislabelposition_s2,
+(map.user_specified_axislabels ? map.axislabel_s2
+   : (map.use_normalized_stokes_params ? "S_2/S_0" : "S_2")));
+
+mp_printf(out,
+ "%%\n"
+ "%% ... then, finally, draw the z-axis.\n"
+ "%%\n"
+ "   x_bis_start := radius*behind_distance_s3*sind(rot_phi);\n"
+ "   y_bis_start := 0.0;\n"
+ "   z_bis_start := radius*behind_distance_s3*cosd(rot_phi);\n"
+ "   x_bis_intersect := radius*sind(rot_phi);\n"
+ "   y_bis_intersect := 0.0;\n"
+ "   z_bis_intersect := radius*cosd(rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (outside_distance_s3*y_bis_intersect,\n"
+ "              outside_distance_s3*z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.%s(btex $%s$ etex,\n"  /* For z-label to the right of S_3 axis */
+ "             (outside_distance_s3*y_bis_intersect,\n"
+ "              outside_distance_s3*z_bis_intersect));\n"
+ "\n",map.axislabelposition_s3,
+(map.user_specified_axislabels ? map.axislabel_s3
+   : (map.use_normalized_stokes_params ? "S_3/S_0" : "S_3")));
+}
+
+/*-----------------------------------------------------------------------------
+| In case the user has specified that an additional coordinate system should
+| be drawn, draw the coordinate axes of the additional $(x,y,z)$-space.
+| The rule is that only coordinate axes that have explicitly declared
+| axis labels should be drawn.  The reason for that I have chosen this
+| way of operation is that the rotated, additional coordinate system might
+| still have one axis in common with the original one, potentially making
+| ugly double-drawn axes with corresponding labels.
+-----------------------------------------------------------------------------*/
+void write_additional_coordinate_axes(mpbuffer *out,pmap map) {
+if ((*out).format!=METAPOST_FORMAT) return; /* see write_coordinate_axes() */
+if (map.user_specified_additional_coordinate_system)  /* whoaaaou again ... */
+{
+mp_printf(out,
+ "%%\n"
+ "%% Draw the $S_1$-, $S_2$- and $S_3$-axis of the Poincare sphere.\n"
+ "%% First of all, calculate the transformations of the intersections\n"
+ "%% for the unity sphere.\n"
+ "%%\n");
+mp_printf(out,
+ "%% Used variables are similar to the ones described for\n"
+ "%% drawing the original coordinate system.\n"
+ "%%\n");
+mp_printf(out,
+ "   xtra_behind_distance_x  := -%f;\n"
+ "   xtra_behind_distance_y  := -%f;\n"
+ "   xtra_behind_distance_z  := -%f;\n",
+   map.xtra_neg_axis_length_x,
+   map.xtra_neg_axis_length_y,
+   map.xtra_neg_axis_length_z);
+mp_printf(out,
+ "   xtra_outside_distance_x :=  %f;\n"
+ "   xtra_outside_distance_y :=  %f;\n"
+ "   xtra_outside_distance_z :=  %f;\n",
+   map.xtra_pos_axis_length_x,
+   map.xtra_pos_axis_length_y,
+   map.xtra_pos_axis_length_z);
+mp_printf(out,
+ "   insidecolval := .85;    %% '0.0' <=> 'white';  '1.0' <=> 'black'\n\n");
+
+if (map.user_specified_xtra_axislabel_x)
+{
+mp_printf(out,
+ "%%\n"
+ "%% Start with drawing the x-axis...\n"
+ "%%\n");
+mp_printf(out,
+ "   x_bis_start :=  radius * xtra_behind_distance_x\n"
+ "                          * cosd(rot_psi + delta_rot_psi)\n"
+ "                          * cosd(rot_phi + delta_rot_phi);\n"
+ "   y_bis_start :=  radius * xtra_behind_distance_x\n"
+ "                          * sind(rot_psi + delta_rot_psi);\n"
+ "   z_bis_start := -radius * xtra_behind_distance_x\n"
+ "                          * cosd(rot_psi + delta_rot_psi)\n"
+ "                          * sind(rot_phi + delta_rot_phi);\n");
+mp_printf(out,
+ "   x_bis_intersect :=  radius * cosd(rot_psi + delta_rot_psi)\n"
+ "                              * cosd(rot_phi + delta_rot_phi);\n"
+ "   y_bis_intersect :=  radius * sind(rot_psi + delta_rot_psi);\n"
+ "   z_bis_intersect := -radius * cosd(rot_psi + delta_rot_psi)\n"
+ "                              * sind(rot_phi + delta_rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (xtra_outside_distance_x * y_bis_intersect,\n"
+ "              xtra_outside_distance_x * z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.bot(btex $%s$ etex,\n"
+ "             (xtra_outside_distance_x * y_bis_intersect,\n"
+ "              xtra_outside_distance_x * z_bis_intersect));\n"
+ "\n", map.xtra_axislabel_x);
+}
+
+if (map.user_specified_xtra_axislabel_y)
+{
+mp_printf(out,
+ "%%\n"
+ "%% ... then draw the y-axis ...\n"
+ "%%\n");
+mp_printf(out,
+ "   x_bis_start := -radius * xtra_behind_distance_y\n"
+ "                          * sind(rot_psi + delta_rot_psi)\n"
+ "                          * cosd(rot_phi + delta_rot_phi);\n"
+ "   y_bis_start :=  radius * xtra_behind_distance_y\n"
+ "                          * cosd(rot_psi + delta_rot_psi);\n"
+ "   z_bis_start :=  radius * xtra_behind_distance_y\n"
+ "                          * sind(rot_psi + delta_rot_psi)\n"
+ "                          * sind(rot_phi + delta_rot_phi);\n");
+mp_printf(out,
+ "   x_bis_intersect := -radius * sind(rot_psi + delta_rot_psi)\n"
+ "                              * cosd(rot_phi + delta_rot_phi);\n"
+ "   y_bis_intersect :=  radius * cosd(rot_psi + delta_rot_psi);\n"
+ "   z_bis_intersect :=  radius * sind(rot_psi + delta_rot_psi)\n"
+ "                              * sind(rot_phi + delta_rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (xtra_outside_distance_y * y_bis_intersect,\n"
+ "              xtra_outside_distance_y * z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.bot(btex $%s$ etex,\n"
+ "             (xtra_outside_distance_y * y_bis_intersect,\n"
+ "              xtra_outside_distance_y * z_bis_intersect));\n"
+ "\n", map.xtra_axislabel_y);
+}
+
+if (map.user_specified_xtra_axislabel_z)
+{
+mp_printf(out,
+ "%%\n"
+ "%% ... then, finally, draw the z-axis.\n"
+ "%%\n"
+ "   x_bis_start := radius * xtra_behind_distance_z\n"
+ "                         * sind(rot_phi + delta_rot_phi);\n"
+ "   y_bis_start := 0.0;\n"
+ "   z_bis_start := radius * xtra_behind_distance_z\n"
+ "                         * cosd(rot_phi + delta_rot_phi);\n"
+ "   x_bis_intersect := radius * sind(rot_phi + delta_rot_phi);\n"
+ "   y_bis_intersect := 0.0;\n"
+ "   z_bis_intersect := radius * cosd(rot_phi + delta_rot_phi);\n");
+if (map.draw_axes_inside_sphere) mp_printf(out,
+ "   p := makepath makepen \n"
+ "             (y_bis_start,z_bis_start)--(y_bis_intersect,z_bis_intersect);\n"
+ "   draw p dashed evenly withcolor insidecolval [white,black];\n");
+mp_printf(out,
+ "   p := makepath makepen (y_bis_intersect,z_bis_intersect)--\n"
+ "             (xtra_outside_distance_z * y_bis_intersect,\n"
+ "              xtra_outside_distance_z * z_bis_intersect);\n"
+ "   drawarrow p;\n");
+mp_printf(out,
+ "   label.top(btex $%s$ etex,\n"
+ "             (xtra_outside_distance_z * y_bis_intersect,\n"
+ "              xtra_outside_distance_z * z_bis_intersect));\n"
+ "\n", map.xtra_axislabel_z);
+}
+}
+}
+
+void write_included_auxiliary_source(mpbuffer *out,pmap map) {
+   if ((*out).format!=METAPOST_FORMAT) {
+      if (map.user_specified_auxfile)
+         fprintf(stderr,"%s: Warning: The MetaPost source %s (--auxsource) "
+            "is ignored in %s output.\n",progname,map.auxfilename,
+            ((*out).format==SVG_FORMAT)?"SVG":"PDF");
+      return;
+   }
+   if (map.user_specified_auxfile) {
+      mp_printf(out,
+         "%%\n"
+         "%% The following external file is included"
+         " (using the --auxsource option):\n%%    %s  [MetaPost source]\n"
+         "%%\n"
+         "   input %s\n",map.auxfilename, map.auxfilename);
+   }
+   mp_printf(out,"   endfig;\n");
+}
+
+/*-----------------------------------------------------------------------------
+| The write_vector_document() routine wraps the body of the native vector
+| output, as collected in |body|, into a complete SVG document or PDF file,
+| kept in memory in |out| (for the offsets of the PDF file) and to be handed
+| over to a file or sink by the caller, as write_vector_figure() does for
+| the file |fileptr|. The page is given the bounding box of the figure,
+| extended by VECTOR_FIGURE_MARGIN on each side. The PDF file consists of a
+| single page, using the standard Times fonts of PDF for its labels.
+-----------------------------------------------------------------------------*/
+void write_vector_document(mpbuffer *doc,mpbuffer *body,pmap map) {
+   mpbuffer out;
+   char prologue[128],entry[32];
+   long offset[7];
+   double llx,lly,urx,ury;
+   int k;
+
+   if ((*body).llx>(*body).urx) { /* nothing drawn at all */
+      (*body).llx=(*body).lly=(*body).urx=(*body).ury=0.0;
+   }
+   llx=floor((*body).llx-VECTOR_FIGURE_MARGIN);
+   lly=floor((*body).lly-VECTOR_FIGURE_MARGIN);
+   urx=ceil((*body).urx+VECTOR_FIGURE_MARGIN);
+   ury=ceil((*body).ury+VECTOR_FIGURE_MARGIN);
+   initialize_mpbuffer(&out,NULL); /* kept in memory for the PDF offsets */
+   if (map.output_format==SVG_FORMAT) {
+      mp_printf(&out,
+         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         "<!-- Map of Stokes parameters, generated by %s v.%s -->\n"
+         "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\"\n"
+         "     width=\"%1.0fpt\" height=\"%1.0fpt\""
+         " viewBox=\"%1.0f %1.0f %1.0f %1.0f\">\n"
+         "<g stroke-linecap=\"round\" stroke-linejoin=\"round\">\n",
+         progname,VERSION_NUMBER,urx-llx,ury-lly,llx,0.0-ury,urx-llx,ury-lly);
+      mp_write(&out,(*body).buf,(*body).len);
+      mp_printf(&out,"</g>\n</svg>\n");
+   } else {
+      sprintf(prologue,"1 0 0 1 %1.0f %1.0f cm 1 J 1 j\n",-llx,-lly);
+      mp_printf(&out,"%%PDF-1.4\n");
+      offset[1]=(long)out.len;
+      mp_printf(&out,"1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+      offset[2]=(long)out.len;
+      mp_printf(&out,
+         "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+      offset[3]=(long)out.len;
+      mp_printf(&out,"3 0 obj\n<< /Type /Page /Parent 2 0 R"
+         " /MediaBox [0 0 %1.0f %1.0f]\n"
+         "   /Resources << /Font << /F1 5 0 R /F2 6 0 R >> >>"
+         " /Contents 4 0 R >>\nendobj\n",urx-llx,ury-lly);
+      offset[4]=(long)out.len;
+      mp_printf(&out,"4 0 obj\n<< /Length %ld >>\nstream\n%s",
+         (long)(strlen(prologue)+(*body).len),prologue);
+      mp_write(&out,(*body).buf,(*body).len);
+      mp_printf(&out,"\nendstream\nendobj\n");
+      offset[5]=(long)out.len;
+      mp_printf(&out,"5 0 obj\n<< /Type /Font /Subtype /Type1"
+         " /BaseFont /Times-Roman >>\nendobj\n");
+      offset[6]=(long)out.len;
+      mp_printf(&out,"6 0 obj\n<< /Type /Font /Subtype /Type1"
+         " /BaseFont /Times-Italic >>\nendobj\n");
+      offset[0]=(long)out.len;
+      mp_printf(&out,"xref\n0 7\n0000000000 65535 f \n");
+      for (k=1;k<=6;k++) {
+         sprintf(entry,"%010ld 00000 n \n",offset[k]);
+         mp_puts(&out,entry);
+      }
+      mp_printf(&out,"trailer\n<< /Size 7 /Root 1 0 R >>\nstartxref\n%ld\n"
+         "%%%%EOF\n",offset[0]);
+   }
+   *doc=out;
+} /* end of write_vector_document() */
+
+void write_vector_figure(FILE *fileptr,mpbuffer *body,pmap map) {
+   mpbuffer out;
+
+   write_vector_document(&out,body,map);
+   out.fileptr=fileptr; /* hand the complete file over to |fileptr| */
+   free_mpbuffer(&out);
+   (*body).numwritten+=out.numwritten;
+   if (map.verbose)
+      fprintf(stdout,"%s: Wrote %s figure of %1.0f x %1.0f bp to %s\n",
+         progname,(map.output_format==SVG_FORMAT)?"SVG":"PDF",
+         ceil((*body).urx+VECTOR_FIGURE_MARGIN)
+            -floor((*body).llx-VECTOR_FIGURE_MARGIN),
+         ceil((*body).ury+VECTOR_FIGURE_MARGIN)
+            -floor((*body).lly-VECTOR_FIGURE_MARGIN),map.outfilename);
+} /* end of write_vector_figure() */
+
+/*-----------------------------------------------------------------------------
+| Routines for the SHA-256 message digest (FIPS 180-2), as used for the keys
+| of the EPS cache (--cache). The 32-bit words of the algorithm are kept in
+| unsigned long integers, being at least 32 bits wide, masked to 32 bits
+| wherever they may overflow. The |sha256state| struct keeps the hash |h|
+| of all complete 64-byte blocks so far, the |n| bytes of the current block
+| in |block|, and the total number of bytes hashed in |len_lo| and |len_hi|
+| (as the lower and upper 32 bits).
+-----------------------------------------------------------------------------*/
+#define SHA256_MASK (0xffffffffUL)
+#define SHA256_ROTR(x,n) ((((x)>>(n))|((x)<<(32-(n))))&SHA256_MASK)
+
+typedef struct {
+   unsigned long h[8];
+   unsigned long len_lo,len_hi;
+   unsigned char block[64];
+   int n;
+} sha256state;
+
+void sha256_init(sha256state *s) {
+   static const unsigned long h0[8]={
+      0x6a09e667UL,0xbb67ae85UL,0x3c6ef372UL,0xa54ff53aUL,
+      0x510e527fUL,0x9b05688cUL,0x1f83d9abUL,0x5be0cd19UL};
+   int i;
+   for (i=0;i<8;i++) (*s).h[i]=h0[i];
+   (*s).len_lo=(*s).len_hi=0;
+   (*s).n=0;
+}
+
+void sha256_block(sha256state *s) {
+   static const unsigned long k[64]={
+      0x428a2f98UL,0x71374491UL,0xb5c0fbcfUL,0xe9b5dba5UL,0x3956c25bUL,
+      0x59f111f1UL,0x923f82a4UL,0xab1c5ed5UL,0xd807aa98UL,0x12835b01UL,
+      0x243185beUL,0x550c7dc3UL,0x72be5d74UL,0x80deb1feUL,0x9bdc06a7UL,
+      0xc19bf174UL,0xe49b69c1UL,0xefbe4786UL,0x0fc19dc6UL,0x240ca1ccUL,
+      0x2de92c6fUL,0x4a7484aaUL,0x5cb0a9dcUL,0x76f988daUL,0x983e5152UL,
+      0xa831c66dUL,0xb00327c8UL,0xbf597fc7UL,0xc6e00bf3UL,0xd5a79147UL,
+      0x06ca6351UL,0x14292967UL,0x27b70a85UL,0x2e1b2138UL,0x4d2c6dfcUL,
+      0x53380d13UL,0x650a7354UL,0x766a0abbUL,0x81c2c92eUL,0x92722c85UL,
+      0xa2bfe8a1UL,0xa81a664bUL,0xc24b8b70UL,0xc76c51a3UL,0xd192e819UL,
+      0xd6990624UL,0xf40e3585UL,0x106aa070UL,0x19a4c116UL,0x1e376c08UL,
+      0x2748774cUL,0x34b0bcb5UL,0x391c0cb3UL,0x4ed8aa4aUL,0x5b9cca4fUL,
+      0x682e6ff3UL,0x748f82eeUL,0x78a5636fUL,0x84c87814UL,0x8cc70208UL,
+      0x90befffaUL,0xa4506cebUL,0xbef9a3f7UL,0xc67178f2UL};
+   unsigned long w[64],a,b,c,d,e,f,g,h,t1,t2;
+   int i;
+
+   for (i=0;i<16;i++)
+      w[i]=((unsigned long)(*s).block[4*i]<<24)
+         |((unsigned long)(*s).block[4*i+1]<<16)
+         |((unsigned long)(*s).block[4*i+2]<<8)
+         |((unsigned long)(*s).block[4*i+3]);
+   for (i=16;i<64;i++)
+      w[i]=(w[i-16]+(SHA256_ROTR(w[i-15],7)^SHA256_ROTR(w[i-15],18)
+         ^(w[i-15]>>3))+w[i-7]+(SHA256_ROTR(w[i-2],17)
+         ^SHA256_ROTR(w[i-2],19)^(w[i-2]>>10)))&SHA256_MASK;
+   a=(*s).h[0]; b=(*s).h[1]; c=(*s).h[2]; d=(*s).h[3];
+   e=(*s).h[4]; f=(*s).h[5]; g=(*s).h[6]; h=(*s).h[7];
+   for (i=0;i<64;i++) {
+      t1=(h+(SHA256_ROTR(e,6)^SHA256_ROTR(e,11)^SHA256_ROTR(e,25))
+         +((e&f)^((~e)&g))+k[i]+w[i])&SHA256_MASK;
+      t2=((SHA256_ROTR(a,2)^SHA256_ROTR(a,13)^SHA256_ROTR(a,22))
+         +((a&b)^(a&c)^(b&c)))&SHA256_MASK;
+      h=g; g=f; f=e;
+      e=(d+t1)&SHA256_MASK;
+      d=c; c=b; b=a;
+      a=(t1+t2)&SHA256_MASK;
+   }
+   (*s).h[0]=((*s).h[0]+a)&SHA256_MASK;
+   (*s).h[1]=((*s).h[1]+b)&SHA256_MASK;
+   (*s).h[2]=((*s).h[2]+c)&SHA256_MASK;
+   (*s).h[3]=((*s).h[3]+d)&SHA256_MASK;
+   (*s).h[4]=((*s).h[4]+e)&SHA256_MASK;
+   (*s).h[5]=((*s).h[5]+f)&SHA256_MASK;
+   (*s).h[6]=((*s).h[6]+g)&SHA256_MASK;
+   (*s).h[7]=((*s).h[7]+h)&SHA256_MASK;
+}
+
+void sha256_update(sha256state *s,const unsigned char *data,size_t n) {
+   size_t i;
+   for (i=0;i<n;i++) {
+      (*s).block[(*s).n++]=data[i];
+      if ((*s).n==64) {
+         sha256_block(s);
+         (*s).n=0;
+      }
+      (*s).len_lo=((*s).len_lo+1)&SHA256_MASK;
+      if ((*s).len_lo==0) (*s).len_hi=((*s).len_hi+1)&SHA256_MASK;
+   }
+}
+
+/*
+ * The sha256_final() routine pads the message and writes the digest, as 64
+ * lowercase hexadecimal digits and a terminating null, to |hex|.
+ */
+void sha256_final(sha256state *s,char *hex) {
+   unsigned long hi,lo;
+   int i;
+
+   hi=(((*s).len_hi<<3)|((*s).len_lo>>29))&SHA256_MASK;
+   lo=((*s).len_lo<<3)&SHA256_MASK;
+   (*s).block[(*s).n++]=0x80;
+   if ((*s).n>56) {
+      while ((*s).n<64) (*s).block[(*s).n++]=0;
+      sha256_block(s);
+      (*s).n=0;
+   }
+   while ((*s).n<56) (*s).block[(*s).n++]=0;
+   for (i=0;i<4;i++) {
+      (*s).block[56+i]=(unsigned char)((hi>>(24-8*i))&0xff);
+      (*s).block[60+i]=(unsigned char)((lo>>(24-8*i))&0xff);
+   }
+   sha256_block(s);
+   for (i=0;i<8;i++) sprintf(hex+8*i,"%08lx",(*s).h[i]);
+}
+
+/*
+ * The sha256_file() routine adds the contents of the file |filename| to the
+ * digest |s|, leaving out all lines starting with '%', being the comments of
+ * MetaPost, which carry the creation time and other data of no concern for
+ * the compiled figure. Returns 0 if the file could not be read.
+ */
+short sha256_file(sha256state *s,char *filename) {
+   FILE *fileptr;
+   unsigned char buf[4096];
+   size_t n=0;
+   short linestart=1,comment=0;
+   int ch;
+
+   if ((fileptr=fopen(filename,"rb"))==NULL) return(0);
+   while ((ch=getc(fileptr))!=EOF) {
+      if (linestart) comment=(ch=='%');
+      linestart=(ch=='\n');
+      if (comment) continue;
+      buf[n++]=(unsigned char)ch;
+      if (n==sizeof(buf)) {
+         sha256_update(s,buf,n);
+         n=0;
+      }
+   }
+   sha256_update(s,buf,n);
+   fclose(fileptr);
+   return(1);
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the cache of EPS figures of the --cache option. A figure is
+| kept in the cache directory as <key>.eps, with its bounding box, as found
+| by |scan_for_boundingbox()|, kept in <key>.bb, where <key> is the SHA-256
+| digest of the MetaPost source (comments left out, as for |sha256_file()|),
+| of any included --auxsource file, and of EPS_CACHE_TOOLCHAIN, describing
+| the commands run by |generate_eps_image()|. Whenever a figure is found in
+| the cache, it is hard linked (or, where this fails, copied) to the EPS
+| file of the job, and the external commands are skipped altogether.
+|
+| The cache is only an aid; any failure in storing a figure in it is
+| reported as a warning, after which the program carries on as usual.
+-----------------------------------------------------------------------------*/
+short get_eps_cache_key(pmap map,char *key) {
+   sha256state s;
+
+   sha256_init(&s);
+   sha256_update(&s,(const unsigned char *)EPS_CACHE_TOOLCHAIN,
+      strlen(EPS_CACHE_TOOLCHAIN)+1);
+   if (!sha256_file(&s,map.outfilename)) return(0);
+   if (map.user_specified_auxfile) {
+      sha256_update(&s,(const unsigned char *)"",1);
+      if (!sha256_file(&s,map.auxfilename)) return(0);
+   }
+   sha256_final(&s,key);
+   return(1);
+}
+
+void get_eps_cache_filename(char *filename,pmap map,char *key,
+      const char *suffix) {
+   sprintf(filename,"%s/%s%s",map.cachedirname,key,suffix);
+}
+
+/*
+ * The copy_file() routine copies the file |from| to |to|, hard linking the
+ * two instead whenever |hardlink| is set and the system supports it. Returns 1 if
+ * successful, otherwise 0. Any old |to| is removed first rather than written
+ * through, since it may be a hard link into the EPS cache.
+ */
+short copy_file(char *from,char *to,short hardlink) {
+   FILE *inptr,*outptr;
+   char buf[4096];
+   size_t n;
+   short ok=1;
+
+   remove(to);
+#ifdef POSIX_SYSTEM
+   if (hardlink&&(link(from,to)==0)) return(1);
+#endif
+   if ((inptr=fopen(from,"rb"))==NULL) return(0);
+   if ((outptr=fopen(to,"wb"))==NULL) {
+      fclose(inptr);
+      return(0);
+   }
+   while ((n=fread(buf,1,sizeof(buf),inptr))>0)
+      if (fwrite(buf,1,n,outptr)!=n) ok=0;
+   if (ferror(inptr)) ok=0;
+   fclose(inptr);
+   if (fclose(outptr)!=0) ok=0;
+   return(ok);
+}
+
+short fetch_cached_eps(pmap map,char *key,
+      long int *llx,long int *lly,long int *urx,long int *ury) {
+   char filename[MAX_FILENAME_TEXTLENGTH+80],epsname[MAX_FILENAME_TEXTLENGTH+8];
+   FILE *bbptr;
+   int n;
+
+   get_eps_cache_filename(filename,map,key,".bb");
+   if ((bbptr=fopen(filename,"r"))==NULL) return(0);
+   n=fscanf(bbptr,"%ld %ld %ld %ld",llx,lly,urx,ury);
+   fclose(bbptr);
+   if (n!=4) return(0);
+   get_eps_cache_filename(filename,map,key,".eps");
+   sprintf(epsname,"%s.eps",map.epsjobname);
+   if (!copy_file(filename,epsname,1)) return(0);
+   if (map.verbose)
+      fprintf(stdout,"%s: Found %s in EPS cache, as %s\n",
+         progname,epsname,filename);
+   return(1);
+}
+
+void store_cached_eps(pmap map,char *key,
+      long int llx,long int lly,long int urx,long int ury) {
+   char filename[MAX_FILENAME_TEXTLENGTH+80],tmpname[MAX_FILENAME_TEXTLENGTH+96];
+   char epsname[MAX_FILENAME_TEXTLENGTH+8];
+   FILE *bbptr;
+
+#ifdef POSIX_SYSTEM
+   if ((mkdir(map.cachedirname,0777)!=0)&&(errno!=EEXIST)) {
+      fprintf(stderr,"%s: Warning: Couldn't create EPS cache directory %s\n",
+         progname,map.cachedirname);
+      return;
+   }
+   sprintf(tmpname,"%s/%s.%ld.tmp",map.cachedirname,key,(long)getpid());
+#else
+   sprintf(tmpname,"%s/%s.tmp",map.cachedirname,key);
+#endif
+   sprintf(epsname,"%s.eps",map.epsjobname);
+   get_eps_cache_filename(filename,map,key,".eps");
+   if ((!copy_file(epsname,tmpname,0))||(rename(tmpname,filename)!=0)) {
+      remove(tmpname);
+      fprintf(stderr,"%s: Warning: Couldn't store %s in EPS cache %s\n",
+         progname,epsname,map.cachedirname);
+      return;
+   }
+   get_eps_cache_filename(filename,map,key,".bb");
+   if ((bbptr=fopen(tmpname,"w"))==NULL) {
+      fprintf(stderr,"%s: Warning: Couldn't store bounding box in EPS "
+         "cache %s\n",progname,map.cachedirname);
+      return;
+   }
+   fprintf(bbptr,"%ld %ld %ld %ld\n",llx,lly,urx,ury);
+   if ((fclose(bbptr)!=0)||(rename(tmpname,filename)!=0)) {
+      remove(tmpname);
+      fprintf(stderr,"%s: Warning: Couldn't store bounding box in EPS "
+         "cache %s\n",progname,map.cachedirname);
+      return;
+   }
+   if (map.verbose)
+      fprintf(stdout,"%s: Stored %s in EPS cache, as %s\n",
+         progname,epsname,filename);
+}
+
+/*-----------------------------------------------------------------------
+| The tex_page_text() routine returns the page by which TeX sets the
+| figures compiled by MetaPost on a page of their own, being either the
+| single figure <name>.1, or with --views, the panels <name>.1, ...,
+| <name>.<n> of the views, tiled in rows of ceil(sqrt(n)) panels each.
+| The page is made large enough for any number of panels, the tight
+| bounding box being left to dvips -E. The text is allocated by malloc(),
+| and is to be freed by the caller.
+-----------------------------------------------------------------------*/
+char *tex_page_text(pmap map,char *name) {
+   char *text,*p;
+   int k,n=map.num_views,columns;
+
+   if ((text=(char *)malloc(256+(n+1)*(strlen(name)+32)))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "tex_page_text()\n",progname);
+      exit(FAILURE);
+   }
+   if (n<1) {
+      sprintf(text,"\\input epsf\\nopagenumbers"
+         "\\centerline{\\epsfbox{%s.1}}\\bye",name);
+      return(text);
+   }
+   for (columns=1;columns*columns<n;columns++);
+   p=text+sprintf(text,"\\input epsf\\nopagenumbers"
+      "\\hsize=100in\\vsize=200in");
+   for (k=1;k<=n;k++) {
+      if ((k-1)%columns==0)
+         p+=sprintf(p,"%s\\centerline{",(k>1)?"}\\medskip":"");
+      else
+         p+=sprintf(p,"\\hskip1em");
+      p+=sprintf(p,"\\epsfbox{%s.%d}",name,k);
+   }
+   sprintf(p,"}\\bye");
+   return(text);
+} /* end of tex_page_text() */
+
+/*-----------------------------------------------------------------------
+| Extract the bounding box of the generated Encapsulated PostScript file,
+| in order to get an idea of the natural physical size of the figure.
+| This is useful in order to enter correct settings as the resulting
+| image is included in for example TeX documents, in which case the
+| typical inclusion yields
+|    \input epsf
+|    \centerline{\epsfxsize=<reported x-size>\epsfbox{<filename>.eps}}
+| With the --cache option, the figure is then stored in the cache under
+| its |key|, for the next time.
+-----------------------------------------------------------------------*/
+void report_eps_bounding_box(pmap map,
+      long int llx,long int lly,long int urx,long int ury) {
+   fprintf(stdout,"%s: Bounding box of %s.eps:\n"
+      "     width=%-4.2f mm (%ld pts), height=%-4.2f mm (%ld pts)\n",
+      progname,map.epsjobname,(urx-llx)*(25.4/72.27),urx-llx,
+               (ury-lly)*(25.4/72.27),ury-lly);
+}
+
+void finish_eps_image(pmap map,char *key) {
+   char tmpstr[MAX_FILENAME_TEXTLENGTH+8];
+   long int llx,lly,urx,ury;
+
+   sprintf(tmpstr,"%s.eps",map.epsjobname);
+   scan_for_boundingbox(tmpstr,&llx,&lly,&urx,&ury);
+   if (map.user_specified_cachedir&&(strlen(key)>0))
+      store_cached_eps(map,key,llx,lly,urx,ury);
+   report_eps_bounding_box(map,llx,lly,urx,ury);
+}
+
+/*-----------------------------------------------------------------------------
+| Routines of the |epsrunner| of the -e option, generating the EPS figures
+| by the toolchain of MetaPost, TeX and DVIPS. Each stage of a job is run as
+| a process of its own, by fork() and execvp(), without any shell, in the
+| work directory <name>.tmp of the job. Up to |maxjobs| jobs (--jobs) are
+| run at the same time, the next stage of a job being started as soon as
+| the previous one has finished, and the remaining stages of a job being
+| skipped as soon as one of them fails. As with make, a stage is skipped
+| altogether if its outputs are no older than its inputs, as told by
+| eps_stage_is_current(), so that a figure of the same MetaPost code as in
+| the previous run is not compiled again.
+|
+| Without POSIX, the stages are instead run by system(), one job at a time,
+| in the current directory, as done by run_eps_toolchain().
+-----------------------------------------------------------------------------*/
+const char *eps_stage_name(int stage) {
+   switch (stage) {
+      case MPOST_STAGE: return("mpost");
+      case TEX_STAGE: return("tex");
+      default: return("dvips");
+   }
+}
+
+const char *eps_stage_phase(int stage) {
+   switch (stage) {
+      case MPOST_STAGE: return("system: mpost");
+      case TEX_STAGE: return("system: tex");
+      default: return("system: dvips");
+   }
+}
+
+#ifdef POSIX_SYSTEM
+char *eps_job_basename(epsjob *job) {
+   char *p=strrchr((*job).map.epsjobname,'/');
+   return((p!=NULL)?(p+1):(*job).map.epsjobname);
+}
+
+/*
+ * The get_eps_job_filename() routine gives the name of file No |k| of the
+ * files of |level| of |job|, the files of level No |s| being the inputs of
+ * stage No |s| and the outputs of stage No |s-1|, namely the copy
+ * <workdir>/<base>.mp of the MetaPost code, the figures <workdir>/<base>.1,
+ * ..., <workdir>/<base>.<n>, the DVI file <workdir>/<base>.dvi, and the EPS
+ * output <name>.eps, with <base> being the last part of <name>.
+ */
+int num_eps_job_files(epsjob *job,int level) {
+   return(((level==1)&&((*job).map.num_views>0))?(*job).map.num_views:1);
+}
+
+void get_eps_job_filename(char *filename,epsjob *job,int level,int k) {
+   switch (level) {
+      case 0:
+         sprintf(filename,"%s/%s.mp",(*job).workdir,eps_job_basename(job));
+         break;
+      case 1:
+         sprintf(filename,"%s/%s.%d",(*job).workdir,eps_job_basename(job),k);
+         break;
+      case 2:
+         sprintf(filename,"%s/%s.dvi",(*job).workdir,eps_job_basename(job));
+         break;
+      default:
+         sprintf(filename,"%s.eps",(*job).map.epsjobname);
+   }
+}
+
+void remove_eps_job_files(epsjob *job,int level) {
+   char filename[2*MAX_FILENAME_TEXTLENGTH+32];
+   int k;
+
+   for (k=1;k<=num_eps_job_files(job,level);k++) {
+      get_eps_job_filename(filename,job,level,k);
+      remove(filename);
+   }
+}
+
+/*
+ * The get_eps_job_time() routine gives in |*t| the modification time of the
+ * newest (if |newest| is set) or else the oldest of the files of |level| of
+ * |job|, and returns 1, or 0 if any of them is missing.
+ */
+short get_eps_job_time(epsjob *job,int level,short newest,time_t *t) {
+   char filename[2*MAX_FILENAME_TEXTLENGTH+32];
+   struct stat st;
+   int k;
+
+   for (k=1;k<=num_eps_job_files(job,level);k++) {
+      get_eps_job_filename(filename,job,level,k);
+      if (stat(filename,&st)!=0) return(0);
+      if ((k==1)||(newest?(difftime(st.st_mtime,*t)>0.0)
+            :(difftime(st.st_mtime,*t)<0.0))) *t=st.st_mtime;
+   }
+   return(1);
+}
+
+short eps_stage_is_current(epsjob *job,int stage) {
+   time_t tin,tout;
+
+   return(get_eps_job_time(job,stage,1,&tin)
+      &&get_eps_job_time(job,stage+1,0,&tout)&&(difftime(tout,tin)>=0.0));
+}
+
+/*
+ * The prepare_eps_job() routine sets up the work directory of |job|, with
+ * the copy <base>.mp of the MetaPost code, on which MetaPost is run, so that
+ * the code may be rewritten by the next job at once. The copy is only made
+ * anew if the code differs from that of the previous run in the directory,
+ * as told by the key of the figure kept in <base>.key, in which case all of
+ * the outputs of the previous run are removed. Otherwise, the copy is kept
+ * as it is, with its time, so that the stages already run are skipped.
+ */
+void prepare_eps_job(epsjob *job) {
+   char keyname[2*MAX_FILENAME_TEXTLENGTH+32],filename[2*MAX_FILENAME_TEXTLENGTH+32];
+   char oldkey[65];
+   FILE *keyptr;
+   short same=0;
+   time_t t;
+   int level;
+
+   sprintf((*job).workdir,"%s.tmp",(*job).map.epsjobname);
+   if ((mkdir((*job).workdir,0777)!=0)&&(errno!=EEXIST)) {
+      fprintf(stderr,"%s: Error: Couldn't create work directory %s\n",
+         progname,(*job).workdir);
+      exit(FAILURE);
+   }
+   sprintf(keyname,"%s/%s.key",(*job).workdir,eps_job_basename(job));
+   if ((strlen((*job).key)>0)&&((keyptr=fopen(keyname,"r"))!=NULL)) {
+      same=((fscanf(keyptr,"%64s",oldkey)==1)&&(!strcmp(oldkey,(*job).key)));
+      fclose(keyptr);
+   }
+   if (same&&get_eps_job_time(job,0,1,&t)) return;
+   remove(keyname);
+   for (level=1;level<=NUM_EPS_STAGES;level++) remove_eps_job_files(job,level);
+   get_eps_job_filename(filename,job,0,1);
+   if (!copy_file((*job).map.outfilename,filename,0)) {
+      fprintf(stderr,"%s: Error: Couldn't copy %s to %s\n",
+         progname,(*job).map.outfilename,filename);
+      exit(FAILURE);
+   }
+   if ((strlen((*job).key)>0)&&((keyptr=fopen(keyname,"w"))!=NULL)) {
+      fprintf(keyptr,"%s\n",(*job).key);
+      fclose(keyptr);
+   }
+}
+
+/*
+ * The start_eps_stage() routine starts the current stage of |job|, as a
+ * process of its own in the work directory of the job. With more than one
+ * job at a time, the standard input of the process is /dev/null, so that
+ * no job waits for input from the terminal.
+ */
+void start_eps_stage(epsrunner *runner,epsjob *job) {
+   char *args[8],*base=eps_job_basename(job);
+   char name[MAX_FILENAME_TEXTLENGTH+8],epsname[MAX_FILENAME_TEXTLENGTH+8];
+   pid_t pid;
+   int k;
+
+   args[0]=(char *)eps_stage_name((*job).stage);
+   args[1]="-job-name";
+   args[2]=base;
+   switch ((*job).stage) {
+      case MPOST_STAGE:
+         sprintf(name,"%s.mp",base);
+         args[3]=name;
+         args[4]=NULL;
+         break;
+      case TEX_STAGE:
+         (*job).texpage=tex_page_text((*job).map,base);
+         args[3]=(*job).texpage;
+         args[4]=NULL;
+         break;
+      default: /* not to write through a hard link into the EPS cache */
+         remove_eps_job_files(job,NUM_EPS_STAGES);
+         sprintf(name,"%s.dvi",base);
+         sprintf(epsname,"../%s.eps",base);
+         args[1]="-D1200";
+         args[2]="-E";
+         args[3]=name;
+         args[4]="-o";
+         args[5]=epsname;
+         args[6]=NULL;
+   }
+   if ((*job).map.verbose) {
+      fprintf(stdout,"%s: Executing",progname);
+      for (k=0;args[k]!=NULL;k++) fprintf(stdout," %s",args[k]);
+      fprintf(stdout," (in %s)\n",(*job).workdir);
+   }
+   fflush(NULL);
+   (*job).starttime=start_stats_phase((*job).map.stats);
+   if ((pid=fork())<0) {
+      fprintf(stderr,"%s: Error: Couldn't start %s.\n",progname,args[0]);
+      exit(FAILURE);
+   }
+   if (pid==0) { /* the stage, run in the work directory of the job */
+      if (chdir((*job).workdir)!=0) {
+         fprintf(stderr,"%s: Error: Couldn't enter work directory %s.\n",
+            progname,(*job).workdir);
+         _exit(FAILURE);
+      }
+      if ((*runner).mpinputs!=NULL) setenv("MPINPUTS",(*runner).mpinputs,1);
+      if ((*runner).texinputs!=NULL)
+         setenv("TEXINPUTS",(*runner).texinputs,1);
+      if ((*runner).maxjobs>1) freopen("/dev/null","r",stdin);
+      execvp(args[0],args);
+      fprintf(stderr,"%s: Error: Couldn't run %s.\n",progname,args[0]);
+      _exit(FAILURE);
+   }
+   (*job).pid=(long)pid;
+}
+
+void remove_eps_job(epsrunner *runner,int j) {
+   (*runner).job[j]=(*runner).job[--(*runner).numjobs];
+}
+
+/*
+ * The advance_eps_job() routine starts the first stage of job No |j|, from
+ * its current stage on, that is not up to date, or if all of its stages are
+ * done, finishes the job by finish_eps_image().
+ */
+void advance_eps_job(epsrunner *runner,int j) {
+   epsjob *job=&((*runner).job[j]);
+
+   while (((*job).stage<NUM_EPS_STAGES)&&eps_stage_is_current(job,(*job).stage)) {
+      if ((*job).map.verbose)
+         fprintf(stdout,"%s: Skipping %s for %s.eps, being up to date\n",
+            progname,eps_stage_name((*job).stage),(*job).map.epsjobname);
+      (*job).stage++;
+   }
+   if ((*job).stage<NUM_EPS_STAGES) {
+      start_eps_stage(runner,job);
+   } else {
+      finish_eps_image((*job).map,(*job).key);
+      remove_eps_job(runner,j);
+   }
+}
+
+/*
+ * The wait_for_eps_stage() routine waits for the stage of any of the jobs
+ * being run to finish, after which the job goes on with its next stage, or
+ * if the stage failed, is stopped, with the outputs of the stage removed.
+ * The routine blocks until any child process ends, and then matches its pid
+ * against the stages being run. Any other child is passed over, although
+ * none is expected, since the trajectory input of a figure, with any
+ * decoder of a compressed file, is closed before its EPS job is submitted.
+ */
+void wait_for_eps_stage(epsrunner *runner) {
+   epsjob *job;
+   pid_t pid;
+   int j=(*runner).numjobs,status=0;
+
+   while (j==(*runner).numjobs) {
+      while (((pid=waitpid(-1,&status,0))<0)&&(errno==EINTR));
+      if (pid<0) {
+         fprintf(stderr,"%s: Error: Lost track of the EPS jobs.\n",progname);
+         exit(FAILURE);
+      }
+      for (j=0;(j<(*runner).numjobs)&&((pid_t)(*runner).job[j].pid!=pid);
+         j++);
+   }
+   job=&((*runner).job[j]);
+   end_stats_phase((*job).map.stats,eps_stage_phase((*job).stage),
+      (*job).starttime);
+   (*job).pid=0;
+   free((*job).texpage);
+   (*job).texpage=NULL;
+   if ((!WIFEXITED(status))||(WEXITSTATUS(status)!=0)) {
+      fprintf(stderr,"%s: Error: Failed executing %s for %s.eps, skipping "
+         "the remaining stages.\n",progname,eps_stage_name((*job).stage),
+         (*job).map.epsjobname);
+      remove_eps_job_files(job,(*job).stage+1);
+      (*runner).numfailed++;
+      remove_eps_job(runner,j);
+      return;
+   }
+   (*job).stage++;
+   advance_eps_job(runner,j);
+}
+#else
+/*
+ * The append_quoted_argument() routine appends the argument |arg| to the
+ * command |cmd| of the shell, after a space and within single quotes, with
+ * any quote of its own written as '\'', so that the shell passes on every
+ * file name and the page of TeX as they are. The argument takes at most
+ * 4*strlen(arg)+3 characters of the command.
+ */
+void append_quoted_argument(char *cmd,const char *arg) {
+   char *p=cmd+strlen(cmd);
+
+   *p++=' ';
+   *p++='\'';
+   for (;*arg!='\0';arg++) {
+      if (*arg=='\'') {
+         strcpy(p,"'\\''");
+         p+=4;
+      } else {
+         *p++=*arg;
+      }
+   }
+   *p++='\'';
+   *p='\0';
+}
+
+/*-----------------------------------------------------------------------
+| Run the external commands generating Encapsulated PostScript output
+| from the MetaPost-source, by system() in the current directory, and
+| return 1 if all of them succeeded, or 0 as soon as one has failed.
+| The command is allocated for the longest of the stages, with every
+| argument quoted by append_quoted_argument().
+-----------------------------------------------------------------------*/
+short run_eps_toolchain(pmap map) {
+   char *cmd,*texpage,name[MAX_FILENAME_TEXTLENGTH+8];
+   char epsname[MAX_FILENAME_TEXTLENGTH+8];
+   int stage,status;
+   double t;
+
+   texpage=tex_page_text(map,map.epsjobname);
+   if ((cmd=(char *)malloc(4*(strlen(texpage)+strlen(map.outfilename)
+         +2*strlen(map.epsjobname))+64))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "run_eps_toolchain()\n",progname);
+      exit(FAILURE);
+   }
+   for (stage=0;stage<NUM_EPS_STAGES;stage++) {
+      switch (stage) {
+         case MPOST_STAGE:
+            strcpy(cmd,"mpost -job-name");
+            append_quoted_argument(cmd,map.epsjobname);
+            append_quoted_argument(cmd,map.outfilename);
+            break;
+         case TEX_STAGE:
+            strcpy(cmd,"tex -job-name");
+            append_quoted_argument(cmd,map.epsjobname);
+            append_quoted_argument(cmd,texpage);
+            break;
+         default: /* not to write through a hard link into the EPS cache */
+            sprintf(name,"%s.dvi",map.epsjobname);
+            sprintf(epsname,"%s.eps",map.epsjobname);
+            remove(epsname);
+            strcpy(cmd,"dvips -D1200 -E");
+            append_quoted_argument(cmd,name);
+            strcat(cmd," -o");
+            append_quoted_argument(cmd,epsname);
+      }
+      if (map.verbose)
+         fprintf(stdout,"%s: Executing system command: %s\n",progname,cmd);
+      t=start_stats_phase(map.stats);
+      status=system(cmd);
+      end_stats_phase(map.stats,eps_stage_phase(stage),t);
+      if (status) {  /* Anything but 0 in return is a failure */
+         fprintf(stderr,"%s: Error: Failed executing %s, skipping the "
+            "remaining stages.\n",progname,cmd);
+         break;
+      }
+   }
+   free(cmd);
+   free(texpage);
+   return(stage==NUM_EPS_STAGES);
+} /* end of run_eps_toolchain() */
+#endif
+
+#ifdef POSIX_SYSTEM
+/*-----------------------------------------------------------------------
+| The search_path() routine returns the search path ".:<dir>:<old>" as
+| a newly allocated string, with <old> the search path of the environment
+| variable |var|, or NULL at allocation failure.
+-----------------------------------------------------------------------*/
+char *search_path(char *dir,char *var) {
+   char *old,*path;
+
+   old=getenv(var);
+   if ((path=(char *)malloc(strlen(dir)
+         +((old!=NULL)?strlen(old):0)+8))!=NULL)
+      sprintf(path,".:%s:%s",dir,(old!=NULL)?old:"");
+   return(path);
+}
+#endif
+
+void initialize_eps_runner(epsrunner *runner,int maxjobs) {
+#ifdef POSIX_SYSTEM
+   char cwd[4096];
+#endif
+
+   (*runner).numjobs=0;
+   (*runner).maxjobs=maxjobs;
+   (*runner).numfailed=0;
+   (*runner).job=NULL;
+   (*runner).mpinputs=NULL;
+   (*runner).texinputs=NULL;
+#ifdef POSIX_SYSTEM
+   if (((*runner).job=(epsjob *)malloc(maxjobs*sizeof(epsjob)))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "initialize_eps_runner()\n",progname);
+      exit(FAILURE);
+   }
+   if (getcwd(cwd,sizeof(cwd))!=NULL) {
+      (*runner).mpinputs=search_path(cwd,"MPINPUTS");
+      (*runner).texinputs=search_path(cwd,"TEXINPUTS");
+   }
+#endif
+}
+
+void free_eps_runner(epsrunner *runner) {
+   free((*runner).job);
+   free((*runner).mpinputs);
+   free((*runner).texinputs);
+   (*runner).job=NULL;
+   (*runner).mpinputs=NULL;
+   (*runner).texinputs=NULL;
+}
+
+/*-----------------------------------------------------------------------
+| The submit_eps_job() routine generates Encapsulated PostScript output
+| from the MetaPost-source of |map|. With the --cache option, the EPS
+| cache is looked up first, and the toolchain is only run if the figure
+| was not found there. Otherwise, the job is started as soon as fewer
+| than |maxjobs| jobs are being run, and any job of the same EPS figure
+| has finished, after which the routine returns at once, the job being
+| carried out along with the others, until finish_eps_jobs().
+-----------------------------------------------------------------------*/
+void submit_eps_job(epsrunner *runner,pmap map) {
+   char key[65];
+   long int llx,lly,urx,ury;
+   double t;
+#ifdef POSIX_SYSTEM
+   epsjob *job;
+   int j=0;
+
+   while (j<(*runner).numjobs) {
+      if (!strcmp((*runner).job[j].map.epsjobname,map.epsjobname)) {
+         wait_for_eps_stage(runner);
+         j=0;
+      } else {
+         j++;
+      }
+   }
+#endif
+   if (!get_eps_cache_key(map,key)) strcpy(key,"");
+   if (map.user_specified_cachedir&&(strlen(key)>0)) {
+      t=start_stats_phase(map.stats);
+      if (fetch_cached_eps(map,key,&llx,&lly,&urx,&ury)) {
+         end_stats_phase(map.stats,"fetch_cached_eps",t);
+         report_eps_bounding_box(map,llx,lly,urx,ury);
+         return;
+      }
+      end_stats_phase(map.stats,"fetch_cached_eps",t);
+   }
+#ifdef POSIX_SYSTEM
+   while ((*runner).numjobs>=(*runner).maxjobs) wait_for_eps_stage(runner);
+   job=&((*runner).job[(*runner).numjobs++]);
+   (*job).map=map;
+   (*job).stage=MPOST_STAGE;
+   (*job).pid=0;
+   (*job).texpage=NULL;
+   strcpy((*job).key,key);
+   prepare_eps_job(job);
+   advance_eps_job(runner,(*runner).numjobs-1);
+#else
+   if (run_eps_toolchain(map)) {
+      finish_eps_image(map,key);
+   } else {
+      (*runner).numfailed++;
+   }
+#endif
+}
+
+/*
+ * The finish_eps_jobs() routine waits for all jobs of |runner| to finish,
+ * and exits with an error if the toolchain of any of them failed.
+ */
+void finish_eps_jobs(epsrunner *runner) {
+#ifdef POSIX_SYSTEM
+   while ((*runner).numjobs>0) wait_for_eps_stage(runner);
+#endif
+   if ((*runner).numfailed>0) {
+      fprintf(stderr,"%s: Error: Couldn't generate %ld of the EPS figures.\n",
+         progname,(*runner).numfailed);
+      exit(FAILURE);
+   }
+}
+
+/*-----------------------------------------------------------------------
+| Generate Encapsulated PostScript output from the MetaPost-source, as a
+| single job of its own, as by submit_eps_job().
+-----------------------------------------------------------------------*/
+void generate_eps_image(pmap map) {
+   epsrunner runner;
+
+   initialize_eps_runner(&runner,1);
+   submit_eps_job(&runner,map);
+   finish_eps_jobs(&runner);
+   free_eps_runner(&runner);
+}
+
+/*
+ * The write_trailer() routine ends the MetaPost file, after the last of the
+ * figures written to it.
+ */
+void write_trailer(mpbuffer *out) {
+   mp_printf(out,"end\n");
+}
+
+/*-----------------------------------------------------------------------------
+| Routines for the |backdropcache| of the batch mode. The backdrop of a
+| figure, that is, the shaded sphere and its equators, only depends on the
+| view and shading parameters compared by |same_backdrop()|, and the
+| write_backdrop() routine reuses the text kept in |*cache| whenever these
+| are the same as for the previous figure. If |cache| is NULL, the backdrop
+| is simply written to |out|.
+-----------------------------------------------------------------------------*/
+void initialize_backdrop_cache(backdropcache *cache) {
+   (*cache).valid=0;
+   initialize_mpbuffer(&((*cache).text),NULL);
+}
+
+void free_backdrop_cache(backdropcache *cache) {
+   free_mpbuffer(&((*cache).text));
+   (*cache).valid=0;
+}
+
+short same_backdrop(pmap a,pmap b) {
+   return((a.output_format==b.output_format)
+      &&(a.scalefactor==b.scalefactor)
+      &&(a.rot_psi==b.rot_psi)&&(a.rot_phi==b.rot_phi)
+      &&(a.user_specified_additional_coordinate_system
+         ==b.user_specified_additional_coordinate_system)
+      &&(a.delta_rot_psi==b.delta_rot_psi)&&(a.delta_rot_phi==b.delta_rot_phi)
+      &&(a.phi_source==b.phi_source)&&(a.theta_source==b.theta_source)
+      &&(a.upper_whiteness_value==b.upper_whiteness_value)
+      &&(a.lower_whiteness_value==b.lower_whiteness_value)
+      &&(a.rho_divisor==b.rho_divisor)&&(a.phi_divisor==b.phi_divisor)
+      &&(a.precompute_shading==b.precompute_shading)
+      &&(a.shading_levels==b.shading_levels)
+      &&(a.coordaxisthickness==b.coordaxisthickness));
+}
+
+void write_backdrop(mpbuffer *out,pmap map,backdropcache *cache) {
+   if (cache==NULL) {
+      write_shaded_sphere(out,map); /* Generate the background sphere */
+      write_equators(out,map); /* Generate the equators S_k=0, k=1,2,3 */
+      return;
+   }
+   if (!((*cache).valid&&same_backdrop((*cache).map,map))) {
+      reset_mpbuffer(&((*cache).text));
+      (*cache).text.format=(*out).format;
+      write_shaded_sphere(&((*cache).text),map);
+      write_equators(&((*cache).text),map);
+      (*cache).map=map;
+      (*cache).valid=1;
+   } else if (map.verbose) {
+      fprintf(stdout,"%s: Reusing the shaded sphere and equators of the "
+         "previous figure\n",progname);
+   }
+   append_mpbuffer(out,&((*cache).text));
+}
+
+/*-----------------------------------------------------------------------------
+| The write_figure_overlay() routine writes everything drawn on top of the
+| backdrop of the figure described by |map|, that is, the trajectories, as
+| kept in the store |ts| (or as streamed from the input, if |ts| is NULL), the
+| additional arrows and the coordinate axes, up to the end of the figure,
+| with everything after the trajectories written by write_figure_annotations().
+-----------------------------------------------------------------------------*/
+void write_figure_annotations(mpbuffer *out,pmap map) {
+   write_additional_arrows(out,map);
+   write_coordinate_axes(out,map);
+   write_additional_coordinate_axes(out,map);
+   write_included_auxiliary_source(out,map);
+}
+
+void write_figure_overlay(mpbuffer *out,pmap map,trajectorystore *ts) {
+   if (ts==NULL) {
+      stream_trajectory_file(out,map); /* Map as trajectories arrive */
+   } else if ((map.num_threads>1)&&(!map.verbose)) {
+      write_threaded_trajectories(out,map,ts);
+   } else {
+      write_scanned_trajectories(out,map,ts,HIDDEN);
+      write_scanned_trajectories(out,map,ts,VISIBLE);
+   }
+   write_figure_annotations(out,map);
+} /* end of write_figure_overlay() */
+
+/*-----------------------------------------------------------------------------
+| The get_density_cell_outline() routine computes the screen coordinates
+| |x[1..6]|, |y[1..6]| of the outline of the cell of band No |i| and sector
+| No |j| of |g|, on the unit sphere, with the lower and upper edges of the
+| cell given by their end points and midpoints, and returns 1 (true) if the
+| centre of the cell is on the visible side of the sphere, as by visible().
+-----------------------------------------------------------------------------*/
+short get_density_cell_outline(double *x,double *y,densitygrid *g,
+      int i,int j,pmap *map) {
+   double z[3],phi[3],rho;
+   int a,b,n=0;
+   z[0]=-1.0+(2.0*(i-1))/(*g).numbands;
+   z[2]=-1.0+(2.0*i)/(*g).numbands;
+   z[1]=0.5*(z[0]+z[2]);
+   phi[0]=-PI+(2.0*PI*(j-1))/(*g).numsectors;
+   phi[2]=-PI+(2.0*PI*j)/(*g).numsectors;
+   phi[1]=0.5*(phi[0]+phi[2]);
+   for (a=0;a<=2;a+=2) {
+      rho=sqrt(1.0-z[a]*z[a]);
+      for (b=0;b<=2;b++) {
+         n++;
+         get_screen_coordinates(&x[n],&y[n],rho*cos(phi[(a)?2-b:b]),
+            rho*sin(phi[(a)?2-b:b]),z[a],map);
+      }
+   }
+   rho=sqrt(1.0-z[1]*z[1]);
+   return(visible(rho*cos(phi[1]),rho*sin(phi[1]),z[1],map));
+}
+
+/*-----------------------------------------------------------------------------
+| The write_density_grid() routine draws the cells of the density grid |g|
+| on the sphere, the hidden cells first, and then the visible ones, each
+| filled with a gray tone going from white for no points to black for the
+| largest number of points of any cell, with the hidden cells lightened
+| towards white by the hidden gray tone, in the same way as hidden paths.
+| Empty cells are not drawn at all, so that the sphere shows through.
+-----------------------------------------------------------------------------*/
+void write_density_grid(mpbuffer *out,pmap map,densitygrid *g) {
+   double x[7],y[7],gray,radius=map.scalefactor*BP_PER_MM;
+   int i,j,pass,m;
+   long c;
+
+   if ((*g).maxcount==0) return;
+   if ((*out).format==METAPOST_FORMAT)
+      mp_printf(out,
+        "%%\n"
+        "%% Draw the density grid of %ld points, in cells of %d bands and "
+        "%d sectors\n"
+        "%%\n",(*g).numpoints,(*g).numbands,(*g).numsectors);
+   for (pass=HIDDEN;pass<=VISIBLE;pass++) {
+      for (i=1;i<=(*g).numbands;i++) {
+         for (j=1;j<=(*g).numsectors;j++) {
+            c=(*g).count[(long)(i-1)*(*g).numsectors+j];
+            if (c==0) continue;
+            if (get_density_cell_outline(x,y,g,i,j,&map)!=(pass==VISIBLE))
+               continue;
+            gray=1.0-((double)c)/((double)(*g).maxcount);
+            if (pass==HIDDEN) gray=map.hiddengraytone
+               +(1.0-map.hiddengraytone)*gray;
+            if ((*out).format==METAPOST_FORMAT) {
+               mp_printf(out,"   fill (");
+               for (m=1;m<=6;m++) {
+                  if (m==NUM_COORDS_PER_METAPOST_LINE+1)
+                     mp_printf(out,"\n    ");
+                  mp_pair(out,x[m],y[m]);
+                  mp_write(out,"--",2);
+               }
+               mp_printf(out,"cycle)\n    scaled radius withcolor %1.4f"
+                  "[black,white];\n",gray);
+            } else {
+               for (m=1;m<=6;m++) {
+                  x[m]*=radius;
+                  y[m]*=radius;
+               }
+               vec_fill(out,x,y,6,0,gray);
+            }
+         }
+      }
+   }
+} /* end of write_density_grid() */
+
+/*-----------------------------------------------------------------------------
+| The scan_density_file() routine scans the trajectories of the input file
+| of |map| into the density grid |g| of --density, in the same way as
+| scan_trajectory_file(), but with every point binned into |g| as soon as it
+| has been scanned, and never kept, so that the memory needed does not
+| depend on the number of points (for text input; binary trajectory files
+| are still read one trajectory at a time).
+-----------------------------------------------------------------------------*/
+void scan_density_file(densitygrid *g,pmap map) {
+   FILE *infileptr;
+   long decoderpid; /* process decoding a compressed file, if nonzero */
+   trajectoryinput in; /* lexer state for scanning the input file */
+   stoketraject st; /* scratch structure of the trajectory being scanned */
+   labelarena labels; /* labels of the trajectory being scanned */
+
+   infileptr=open_infile(map,&decoderpid);
+   if (infileptr==NULL) return;
+   map.density=g;
+   initialize_stoke_trajectory(&st);
+   initialize_label_arena(&labels);
+   st.labels=&labels;
+   reset_stokes_trajectory_struct(&st);
+   initialize_trajectory_input(&in,infileptr,decoderpid);
+   detect_binary_trajectory_input(&in);
+   while (scan_next_trajectory(&in,&st,&map,NULL)) {
+      if (in.binary) add_density_trajectory(g,&st);
+      count_scanned_trajectory(map.stats,&st);
+      reset_label_arena(&labels);
+      reset_stokes_trajectory_struct(&st);
+   }
+   if (map.stats!=NULL) {
+      (*map.stats).bytesread+=in.numread;
+      if (!in.binary) (*map.stats).numpoints+=(*g).numpoints;
+   }
+   close_trajectory_input(&in);
+   free_stoke_trajectory(&st);
+   free_label_arena(&labels);
+} /* end of scan_density_file() */
+
+/*-----------------------------------------------------------------------------
+| The write_density_figure() routine is the counterpart of write_figure() for
+| the density mode (--density), writing the shaded sphere, the density grid
+| of the points of the input file, and the equators on top of the grid,
+| followed by the arrows and coordinate axes. The figure of the points
+| already binned into |g| is written by write_binned_density_figure().
+-----------------------------------------------------------------------------*/
+void write_binned_density_figure(mpbuffer *out,pmap map,densitygrid *g) {
+   double t;
+
+   t=start_stats_phase(map.stats);
+   write_shaded_sphere(out,map);
+   end_stats_phase(map.stats,"write_shaded_sphere",t);
+   if (map.verbose)
+      fprintf(stdout,"%s: Binned %ld points into %d cells of the density "
+         "grid, at most %ld per cell\n",progname,(*g).numpoints,
+         (*g).numbands*(*g).numsectors,(*g).maxcount);
+   t=start_stats_phase(map.stats);
+   write_density_grid(out,map,g);
+   end_stats_phase(map.stats,"write_density_grid",t);
+   write_equators(out,map);
+   write_figure_annotations(out,map);
+} /* end of write_binned_density_figure() */
+
+void write_density_figure(mpbuffer *out,pmap map) {
+   densitygrid g;
+   double t;
+
+   initialize_density_grid(&g,map.density_bands);
+   t=start_stats_phase(map.stats);
+   scan_density_file(&g,map);
+   end_stats_phase(map.stats,"scan_density_file",t);
+   write_binned_density_figure(out,map,&g);
+   free_density_grid(&g);
+} /* end of write_density_figure() */
+
+/*-----------------------------------------------------------------------------
+| The write_figure() routine writes the figure described by |map| to |out|,
+| from the specification of the view (for MetaPost code, including the
+| beginfig() of the figure, as written by write_figure_specs()) to the end
+| of the figure, with the backdrop of the figure taken from |cache|, if any,
+| as described for write_backdrop().
+-----------------------------------------------------------------------------*/
+void write_figure_specs(mpbuffer *out,pmap map) {
+   double t;
+
+   if (map.output_format==METAPOST_FORMAT) {
+      t=start_stats_phase(map.stats);
+      write_euler_angle_specs(out,map);
+      end_stats_phase(map.stats,"write_euler_angle_specs",t);
+      t=start_stats_phase(map.stats);
+      write_sphere_shading_specs(out,map);
+      end_stats_phase(map.stats,"write_sphere_shading_specs",t);
+   }
+}
+
+void write_figure(mpbuffer *out,pmap map,backdropcache *cache) {
+   trajectorystore ts; /* All Stokes trajectories scanned from file */
+   double t;
+   long k;
+
+   write_figure_specs(out,map);
+   if (map.density_bands>0) { /* --density, instead of any paths */
+      write_density_figure(out,map);
+      return;
+   }
+   t=start_stats_phase(map.stats);
+   write_backdrop(out,map,cache);
+   end_stats_phase(map.stats,"write_backdrop",t);
+   if (map.stream_input||map.save_memory
+         ||(map.input_compression!=NO_COMPRESSION)) {
+      t=start_stats_phase(map.stats);
+      write_figure_overlay(out,map,NULL);
+      end_stats_phase(map.stats,"write_figure_overlay",t);
+   } else {
+      t=start_stats_phase(map.stats);
+      scan_trajectory_file(&ts,map); /* Parse input trajectories once only */
+      end_stats_phase(map.stats,"scan_trajectory_file",t);
+      t=start_stats_phase(map.stats);
+      write_figure_overlay(out,map,&ts);
+      end_stats_phase(map.stats,"write_figure_overlay",t);
+      for (k=1;k<=ts.numtrajectories;k++)
+         count_drawn_segments(map.stats,&(ts.trajectory[k]));
+      free_trajectory_store(&ts);
+   }
+} /* end of write_figure() */
+
+/*-----------------------------------------------------------------------------
+| The share_trajectory_store() routine sets up |view| as a copy of the store
+| |ts|, sharing the Stokes parameters, tick marks and labels of all of its
+| trajectories, but with screen coordinates, visibility flags and visibility
+| segments of its own, so that the trajectories can be projected for several
+| views at the same time. The free_shared_trajectory_store() routine releases
+| such a view, leaving the shared data of |ts| untouched.
+-----------------------------------------------------------------------------*/
+void share_trajectory_store(trajectorystore *view,trajectorystore *ts) {
+   stoketraject *tr;
+   long k;
+
+   (*view).numtrajectories=(*view).maxtrajectories=(*ts).numtrajectories;
+   if (((*view).trajectory=(stoketraject *)malloc((size_t)
+         (((*ts).numtrajectories+1)*sizeof(stoketraject))))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "share_trajectory_store()\n",progname);
+      exit(FAILURE);
+   }
+   initialize_label_arena(&((*view).labels)); /* the labels stay in |ts| */
+   for (k=1;k<=(*ts).numtrajectories;k++) {
+      tr=&((*view).trajectory[k]);
+      *tr=(*ts).trajectory[k];
+      (*tr).x=dvector(1,(*tr).maxcoords);
+      (*tr).y=dvector(1,(*tr).maxcoords);
+      (*tr).visible=svector(1,(*tr).maxcoords);
+      allocate_stoke_segments(tr);
+   }
+} /* end of share_trajectory_store() */
+
+void free_shared_trajectory_store(trajectorystore *view) {
+   long k;
+   stoketraject *tr;
+   for (k=1;k<=(*view).numtrajectories;k++) {
+      tr=&((*view).trajectory[k]);
+      free_dvector((*tr).x,1,(*tr).maxcoords);
+      free_dvector((*tr).y,1,(*tr).maxcoords);
+      free_svector((*tr).visible,1,(*tr).maxcoords);
+      free_stoke_segments(tr);
+   }
+   free((char*) (*view).trajectory);
+   initialize_trajectory_store(view);
+} /* end of free_shared_trajectory_store() */
+
+/*
+ * The sweep_frame_filename() routine writes to |name| the file name of frame
+ * No |k| of a rotation sweep of |n| frames in SVG or PDF, being the name
+ * |base| of the output file with the frame number inserted before its
+ * suffix, as in aout-001.svg, aout-002.svg, ...
+ */
+void sweep_frame_filename(char *name,char *base,int k,int n) {
+   char *dot=strrchr(base,'.'),*slash=strrchr(base,'/');
+   int width;
+
+   for (width=1;n>=10;n/=10) width++;
+   if (width<3) width=3;
+   if ((dot==NULL)||((slash!=NULL)&&(dot<slash))) dot=base+strlen(base);
+   if (strlen(base)+width+2>MAX_FILENAME_TEXTLENGTH) {
+      fprintf(stderr,"%s: Error: The file name %s is too long for numbering "
+         "the frames of the rotation sweep.\n",progname,base);
+      exit(FAILURE);
+   }
+   sprintf(name,"%.*s-%0*d%s",(int)(dot-base),base,width,k,dot);
+}
+
+/*
+ * The set_sweep_frame() routine sets the parameters |*frame| of frame No |k|
+ * of the rotation sweep described by |map|, with the swept angles stepped
+ * evenly from their start to their stop values, both included, or with the
+ * angles of view No |k| of --views, and with |nthreads| threads for mapping
+ * the trajectories of the frame.
+ */
+void set_sweep_frame(pmap *frame,pmap map,int k,int nthreads) {
+   double t;
+
+   t=((map.num_sweep_frames>1)?
+      ((double)(k-1))/((double)(map.num_sweep_frames-1)):0.0);
+   *frame=map;
+   if (map.num_views>0) {
+      (*frame).rot_psi=map.views_psi[k];
+      (*frame).rot_phi=map.views_phi[k];
+   }
+   if (map.sweep_psi)
+      (*frame).rot_psi=map.sweep_psi_start
+         +t*(map.sweep_psi_stop-map.sweep_psi_start);
+   if (map.sweep_phi)
+      (*frame).rot_phi=map.sweep_phi_start
+         +t*(map.sweep_phi_stop-map.sweep_phi_start);
+   (*frame).figure_number=k;
+   (*frame).num_threads=nthreads;
+   if (map.output_format!=METAPOST_FORMAT)
+      sweep_frame_filename((*frame).outfilename,map.outfilename,k,
+         map.num_sweep_frames);
+   update_view_transform(frame);
+} /* end of set_sweep_frame() */
+
+/*
+ * The write_sweep_frame() routine does the work of one thread of
+ * |run_rotation_sweep()|, as described by the |frameworker| pointed to by
+ * |arg|, writing the complete frame to its buffer.
+ */
+void *write_sweep_frame(void *arg) {
+   frameworker *w=(frameworker *)arg;
+
+   reset_mpbuffer(&((*w).text));
+   if ((*w).map.output_format==METAPOST_FORMAT) {
+      write_euler_angle_specs(&((*w).text),(*w).map);
+      if ((*w).map.figure_number==1)
+         write_light_source_specs(&((*w).text),(*w).map);
+      begin_shaded_figure(&((*w).text),(*w).map);
+   }
+   append_mpbuffer(&((*w).text),(*w).sphere);
+   write_equators(&((*w).text),(*w).map);
+   write_figure_overlay(&((*w).text),(*w).map,&((*w).view));
+   return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+| The run_rotation_sweep() routine generates the frames of the rotation sweep
+| given by the --sweeppsi and --sweepphi options, for animations. In contrast
+| to running the program once for every frame, the input file is parsed only
+| once, and the shaded sphere, which only depends on the light source and
+| not on the view, is generated only once, its text then being copied into
+| every frame. What remains for each frame is the view transform, the
+| equators, and the projection and visibility split of the trajectories.
+|
+| The frames are rendered in waves of up to |num_threads| frames in parallel
+| (with any threads left over given to the frames for mapping their
+| trajectories), each thread with its own view of the trajectory store, as
+| set up by |share_trajectory_store()|. The frames of a wave are then written
+| in order, for MetaPost code as beginfig(1), beginfig(2), ... of a single
+| file, and for SVG and PDF as files of their own, named as described for
+| |sweep_frame_filename()|. In verbose mode, the frames are rendered one at a
+| time.
+-----------------------------------------------------------------------------*/
+void run_rotation_sweep(pmap map,int argc,char *argv[]) {
+   FILE *outfileptr=NULL;
+   mpbuffer out;          /* The output buffer for MetaPost code */
+   mpbuffer sphere;       /* The shaded sphere, common to all frames */
+   trajectorystore ts;    /* All Stokes trajectories scanned from file */
+   frameworker *worker;
+#ifdef POSIX_SYSTEM
+   pthread_t *thread;
+   short *started;
+#endif
+   int k,w,m,nw,n=map.num_sweep_frames;
+   long j;
+   double t;
+
+   nw=(map.verbose?1:map.num_threads);
+   if (nw>n) nw=n;
+   t=start_stats_phase(map.stats);
+   scan_trajectory_file(&ts,map); /* Parse input trajectories once only */
+   end_stats_phase(map.stats,"scan_trajectory_file",t);
+   initialize_mpbuffer(&sphere,NULL);
+   sphere.format=map.output_format;
+   t=start_stats_phase(map.stats);
+   write_shaded_sphere(&sphere,map);
+   end_stats_phase(map.stats,"write_shaded_sphere",t);
+   if ((worker=(frameworker *)malloc(nw*sizeof(frameworker)))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "run_rotation_sweep()\n",progname);
+      exit(FAILURE);
+   }
+   for (w=0;w<nw;w++) {
+      share_trajectory_store(&(worker[w].view),&ts);
+      worker[w].sphere=&sphere;
+      initialize_mpbuffer(&(worker[w].text),NULL);
+      worker[w].text.format=map.output_format;
+   }
+   if (map.output_format==METAPOST_FORMAT) {
+      outfileptr=open_outfile(map);
+      initialize_mpbuffer(&out,outfileptr);
+      write_header(&out,map,argc,argv);
+   }
+#ifdef POSIX_SYSTEM
+   thread=(pthread_t *)malloc(nw*sizeof(pthread_t));
+   started=svector(0,nw-1);
+#endif
+   for (k=1;k<=n;k+=nw) {
+      m=((n-k+1<nw)?(n-k+1):nw);
+      for (w=0;w<m;w++) {
+         set_sweep_frame(&(worker[w].map),map,k+w,
+            ((map.num_threads/nw>1)?(map.num_threads/nw):1));
+         if (map.verbose)
+            fprintf(stdout,"%s: %s %d of %d, at psi=%f and phi=%f "
+               "degrees\n",progname,(map.num_views>0)?"View":"Frame",
+               k+w,n,(180/PI)*worker[w].map.rot_psi,
+               (180/PI)*worker[w].map.rot_phi);
+      }
+      t=start_stats_phase(map.stats);
+#ifdef POSIX_SYSTEM
+      for (w=0;w<m;w++) {
+         started[w]=((m>1)&&(thread!=NULL)&&(pthread_create(&thread[w],NULL,
+            write_sweep_frame,&worker[w])==0));
+         if (!started[w]) write_sweep_frame(&worker[w]);
+      }
+      for (w=0;w<m;w++) if (started[w]) pthread_join(thread[w],NULL);
+#else
+      for (w=0;w<m;w++) write_sweep_frame(&worker[w]);
+#endif
+      end_stats_phase(map.stats,"write_sweep_frame",t);
+      for (w=0;w<m;w++) {
+         for (j=1;j<=worker[w].view.numtrajectories;j++)
+            count_drawn_segments(map.stats,&(worker[w].view.trajectory[j]));
+         t=start_stats_phase(map.stats);
+         if (map.output_format==METAPOST_FORMAT) {
+            append_mpbuffer(&out,&(worker[w].text));
+         } else {
+            outfileptr=open_outfile(worker[w].map);
+            write_vector_figure(outfileptr,&(worker[w].text),worker[w].map);
+            fclose(outfileptr);
+            if (map.stats!=NULL)
+               (*map.stats).byteswritten+=worker[w].text.numwritten;
+            worker[w].text.numwritten=0;
+         }
+         end_stats_phase(map.stats,(map.output_format==METAPOST_FORMAT)?
+            "append_mpbuffer":"write_vector_figure",t);
+      }
+   }
+#ifdef POSIX_SYSTEM
+   free_svector(started,0,nw-1);
+   free(thread);
+#endif
+   if (map.output_format==METAPOST_FORMAT) {
+      write_trailer(&out);
+      free_mpbuffer(&out); /* flushes the remaining MetaPost code to file */
+      if (map.stats!=NULL) (*map.stats).byteswritten+=out.numwritten;
+      if (map.stream_output) {
+         fflush(outfileptr);
+      } else {
+         fclose(outfileptr);
+      }
+   }
+   for (w=0;w<nw;w++) {
+      free_shared_trajectory_store(&(worker[w].view));
+      free_mpbuffer(&(worker[w].text));
+   }
+   free(worker);
+   free_mpbuffer(&sphere);
+   free_trajectory_store(&ts);
+} /* end of run_rotation_sweep() */
+
+/*-----------------------------------------------------------------------------
+| Routines for the watch mode (--watch), in which the input file is checked
+| for appended trajectories every |watch_interval| seconds, for example as
+| written by a polarimeter during acquisition. Only complete trajectories,
+| up to the closing 'q' (and any 'e' end label on the following line), are
+| taken from the file, while a trajectory still being written is left for
+| the next time, as found by |complete_trajectory_text()|. An end label
+| written separately from, and after, the closing 'q' of its trajectory
+| thus comes too late, and is ignored with a warning. The new
+| trajectories are parsed and mapped into the |watchstate| once only, with
+| the hidden and visible layers of all trajectories so far kept as text,
+| and the figure is then reassembled from these together with the shaded
+| sphere, kept in the backdrop cache, by |write_watched_figure()|. This way,
+| the cost of each refresh is proportional to the new data, apart from the
+| writing of the figure itself.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   backdropcache backdrop;
+   mpbuffer hidden,visible; /* the layers of all trajectories so far */
+   long offset;  /* bytes of the file taken so far */
+   long linenum; /* line number of the file at |offset| */
+   long numtrajectories;
+} watchstate;
+
+/*
+ * The complete_trajectory_text() routine returns the length of the part of
+ * the |len| characters of |text| that ends with a complete trajectory, that
+ * is, up to and including the last complete line starting with 'q', along
+ * with a directly following line starting with 'e', if complete.
+ */
+size_t complete_trajectory_text(char *text,size_t len) {
+   size_t k,start,end=0;
+   short afterq=0;
+   for (start=0,k=0;k<len;k++) {
+      if (text[k]!='\n') continue;
+      while ((start<k)&&isspace((unsigned char)text[start])) start++;
+      if ((start<k)&&(text[start]=='q')) {
+         end=k+1;
+         afterq=1;
+      } else {
+         if (afterq&&(start<k)&&(text[start]=='e')) end=k+1;
+         if (start<k) afterq=0;
+      }
+      start=k+1;
+   }
+   return(end);
+} /* end of complete_trajectory_text() */
+
+/*
+ * The watch_file_size() routine returns the size of the file |filename|,
+ * or -1 if it cannot be found.
+ */
+long watch_file_size(char *filename) {
+#ifdef POSIX_SYSTEM
+   struct stat sb;
+   if (stat(filename,&sb)!=0) return(-1);
+   return((long)sb.st_size);
+#else
+   return(-1);
+#endif
+}
+
+/*
+ * The watch_sleep() routine waits for |seconds| seconds.
+ */
+void watch_sleep(double seconds) {
+#ifdef POSIX_SYSTEM
+   struct timespec ts;
+   ts.tv_sec=(time_t)seconds;
+   ts.tv_nsec=(long)((seconds-(double)ts.tv_sec)*1.0e9);
+   while ((nanosleep(&ts,&ts)!=0)&&(errno==EINTR));
+#endif
+}
+
+/*
+ * The reset_watchstate() routine forgets all trajectories of |ws|, as when
+ * starting from the beginning of the file, keeping only its backdrop.
+ */
+void reset_watchstate(watchstate *ws,pmap map) {
+   reset_mpbuffer(&((*ws).hidden));
+   reset_mpbuffer(&((*ws).visible));
+   (*ws).hidden.format=(*ws).visible.format=map.output_format;
+   (*ws).offset=0;
+   (*ws).linenum=1;
+   (*ws).numtrajectories=0;
+}
+
+/*-----------------------------------------------------------------------------
+| The read_appended_trajectories() routine takes the complete trajectories
+| appended to the file of |map| since the previous call, parses them, and
+| adds their hidden and visible parts to the layers of |ws|, returning the
+| number of new trajectories. If the file has shrunk, as when rewritten from
+| the start, all of it is taken anew, and -1 is returned if so, as the figure
+| then has to be regenerated even without any new trajectories.
+-----------------------------------------------------------------------------*/
+long read_appended_trajectories(watchstate *ws,pmap map) {
+   FILE *fileptr;
+   trajectoryinput in;
+   stoketraject st;
+   labelarena labels;
+   char *text;
+   long size,n=0,restarted=0;
+   size_t len;
+
+   if ((size=watch_file_size(map.infilename))<0) return(0);
+   if (size<(*ws).offset) {
+      if (map.verbose)
+         fprintf(stdout,"%s: File %s has shrunk, reading it anew\n",
+            progname,map.infilename);
+      reset_watchstate(ws,map);
+      restarted=1;
+   }
+   if (size==(*ws).offset) return(restarted?-1:0);
+   if ((fileptr=fopen(map.infilename,"rb"))==NULL) return(restarted?-1:0);
+   len=(size_t)(size-(*ws).offset);
+   if ((text=(char *)malloc(len))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "read_appended_trajectories()\n",progname);
+      exit(FAILURE);
+   }
+   if ((fseek(fileptr,(*ws).offset,SEEK_SET)!=0)
+         ||((len=fread(text,1,len,fileptr))==0)) {
+      fclose(fileptr);
+      free(text);
+      return(restarted?-1:0);
+   }
+   fclose(fileptr);
+   if (((*ws).offset==0)&&(len>=8)&&(!memcmp(text,BINARY_MAGIC,8))) {
+      fprintf(stderr,"%s: Error: Binary trajectory files cannot be watched "
+         "(--watch).\n",progname);
+      exit(FAILURE);
+   }
+   if ((len=complete_trajectory_text(text,len))==0) {
+      free(text);
+      return(restarted?-1:0);
+   }
+   (*ws).offset+=(long)len;
+   initialize_trajectory_text(&in,text,len,(*ws).linenum);
+   readaway_comments_and_blanks(&in);
+   if (endlabel(&in)) { /* end label of a trajectory already mapped */
+      fprintf(stderr,"%s: Warning: Ignoring end label at line %ld, "
+         "appended after its trajectory was mapped.\n",progname,in.linenum);
+      while ((in.pos<in.len)&&(in.buf[in.pos]!='\n')) in.pos++;
+   }
+   initialize_stoke_trajectory(&st);
+   initialize_label_arena(&labels);
+   st.labels=&labels;
+   reset_stokes_trajectory_struct(&st);
+   while (scan_next_trajectory(&in,&st,&map,NULL)) {
+      write_scanned_trajectory(&((*ws).hidden),&st,&map,HIDDEN);
+      write_scanned_trajectory(&((*ws).visible),&st,&map,VISIBLE);
+      count_scanned_trajectory(map.stats,&st);
+      count_drawn_segments(map.stats,&st);
+      reset_label_arena(&labels);
+      reset_stokes_trajectory_struct(&st);
+      n++;
+   }
+   for (;in.pos<in.len;in.pos++) if (in.buf[in.pos]=='\n') in.linenum++;
+   (*ws).linenum=in.linenum;
+   (*ws).numtrajectories+=n;
+   if (map.stats!=NULL) (*map.stats).bytesread+=in.numread;
+   close_trajectory_input(&in);
+   free_stoke_trajectory(&st);
+   free_label_arena(&labels);
+   return((restarted&&(n==0))?-1:n);
+} /* end of read_appended_trajectories() */
+
+/*
+ * The write_watched_figure() routine writes the figure of the watch mode to
+ * |out|, in the same way as write_figure(), but with the trajectories taken
+ * from the layers of |ws| as mapped so far, and the backdrop from its cache.
+ */
+void write_watched_figure(mpbuffer *out,pmap map,watchstate *ws) {
+   if (map.output_format==METAPOST_FORMAT) {
+      write_euler_angle_specs(out,map);
+      write_sphere_shading_specs(out,map);
+   }
+   write_backdrop(out,map,&((*ws).backdrop));
+   write_trajectory_layer_prologue(out,map);
+   append_mpbuffer(out,&((*ws).hidden));
+   write_trajectory_layer_epilogue(out);
+   write_trajectory_layer_prologue(out,map);
+   append_mpbuffer(out,&((*ws).visible));
+   write_trajectory_layer_epilogue(out);
+   write_figure_annotations(out,map);
+} /* end of write_watched_figure() */
+
+/*-----------------------------------------------------------------------------
+| The run_watch_mode() routine carries out the watch mode, regenerating the
+| figure whenever trajectories have been appended to the input file, until
+| interrupted. The figure is first written to a temporary file next to the
+| output file, which is then renamed, so that the output file is always
+| complete, as seen by other programs.
+-----------------------------------------------------------------------------*/
+void run_watch_mode(pmap map,int argc,char *argv[]) {
+   watchstate ws;
+   mpbuffer out;
+   pmap tmpmap;
+   FILE *outfileptr;
+   long n;
+   double t;
+   short first=1;
+
+#ifndef POSIX_SYSTEM
+   fprintf(stderr,"%s: Error: The --watch option requires a POSIX "
+      "system.\n",progname);
+   exit(FAILURE);
+#endif
+   if (watch_file_size(map.infilename)<0) {
+      fprintf(stderr,"%s: Couldn't open trajectory file %s for reading\n",
+         progname,map.infilename);
+      exit(FAILURE);
+   }
+   if (strlen(map.outfilename)+5>MAX_FILENAME_TEXTLENGTH) {
+      fprintf(stderr,"%s: Error: Too long name of output file for "
+         "--watch.\n",progname);
+      exit(FAILURE);
+   }
+   tmpmap=map;
+   sprintf(tmpmap.outfilename,"%s.tmp",map.outfilename);
+   initialize_backdrop_cache(&(ws.backdrop));
+   initialize_mpbuffer(&(ws.hidden),NULL);
+   initialize_mpbuffer(&(ws.visible),NULL);
+   reset_watchstate(&ws,map);
+   for (;;) {
+      t=start_stats_phase(map.stats);
+      n=read_appended_trajectories(&ws,map);
+      end_stats_phase(map.stats,"read_appended_trajectories",t);
+      if ((n!=0)||first) {
+         if (map.verbose)
+            fprintf(stdout,"%s: Regenerating %s with %ld new trajectories "
+               "(%ld in total)\n",progname,map.outfilename,(n>0)?n:0,
+               ws.numtrajectories);
+         t=start_stats_phase(map.stats);
+         outfileptr=open_outfile(tmpmap);
+         if (map.output_format==METAPOST_FORMAT) {
+            initialize_mpbuffer(&out,outfileptr);
+            write_header(&out,map,argc,argv);
+            write_watched_figure(&out,map,&ws);
+            write_trailer(&out);
+            free_mpbuffer(&out); /* flushes the remaining code to file */
+         } else {
+            initialize_mpbuffer(&out,NULL);
+            out.format=map.output_format;
+            write_watched_figure(&out,map,&ws);
+            write_vector_figure(outfileptr,&out,map);
+            free_mpbuffer(&out);
+         }
+         fclose(outfileptr);
+         if (rename(tmpmap.outfilename,map.outfilename)!=0) {
+            fprintf(stderr,"%s: Error: Couldn't rename %s to %s!\n",
+               progname,tmpmap.outfilename,map.outfilename);
+            exit(FAILURE);
+         }
+         if (map.stats!=NULL) (*map.stats).byteswritten+=out.numwritten;
+         end_stats_phase(map.stats,"write_watched_figure",t);
+         if (map.generate_eps_output) generate_eps_image(map);
+         fflush(stdout);
+         first=0;
+      }
+      watch_sleep(map.watch_interval);
+   }
+} /* end of run_watch_mode() */
+
+/*
+ * The split_batch_line() routine splits a |line| of the batch manifest into
+ * its arguments, separated by blanks, with arguments containing blanks
+ * enclosed in double quotes. Pointers to at most |maxargs| arguments, being
+ * terminated in place, are returned in |args|, and their number is returned,
+ * or -1 if there were too many. Lines starting with '%' or '#' are comments.
+ */
+int split_batch_line(char *line,char **args,int maxargs) {
+   char *p=line,*q;
+   int n=0;
+
+   for (;;) {
+      while (isspace((int)((unsigned char)(*p)))) p++;
+      if ((*p=='\0')||((n==0)&&((*p=='%')||(*p=='#')))) break;
+      if (n>=maxargs) return(-1);
+      if (*p=='"') {
+         for (q=++p;(*p!='"')&&(*p!='\0');p++);
+      } else {
+         for (q=p;(*p!='\0')&&(!isspace((int)((unsigned char)(*p))));p++);
+      }
+      if (*p!='\0') *p++='\0';
+      args[n++]=q;
+   }
+   return(n);
+}
+
+/*-----------------------------------------------------------------------------
+| The run_batch_manifest() routine carries out all jobs of the batch manifest
+| given with the --batch option. Each line of the manifest describes one job
+| by a list of options, in the same syntax as on the command line, which are
+| applied after the options given on the command line itself, so that these
+| serve as defaults for all jobs. Empty lines and lines starting with '%' or
+| '#' are ignored. All jobs share one output buffer, and the backdrop of the
+| figures is reused by every job with the same view and shading parameters
+| as the previous one, as described for write_backdrop().
+|
+| With the --batchoutput option, all figures are written to a single MetaPost
+| file, as beginfig(1), beginfig(2), ..., in the order of the manifest, so
+| that MetaPost compiles all of them in one run; otherwise, each job writes
+| its figure to its own output file (-o), with EPS output (-e) if requested,
+| whose toolchain is run by submit_eps_job() along with those of up to
+| --jobs other jobs, while the next jobs are being mapped.
+-----------------------------------------------------------------------------*/
+void run_batch_manifest(pmap map,int argc,char *argv[]) {
+   FILE *manifestptr,*outfileptr=NULL;
+   mpbuffer out;          /* The output buffer shared by all jobs */
+   backdropcache cache;   /* The backdrop of the previous figure */
+   epsrunner runner;      /* The EPS jobs (-e) being run */
+   pmap jobmap;           /* The parameters of the current job */
+   char line[MAX_BATCH_LINELENGTH],**jobargv;
+   long linenum=0,numjobs=0;
+   int k,jobargc;
+   double t;
+
+   if ((manifestptr=fopen(map.batchfilename,"r"))==NULL) {
+      fprintf(stderr,"%s: Couldn't open batch manifest %s for reading\n",
+         progname,map.batchfilename);
+      exit(FAILURE);
+   }
+   if ((jobargv=(char **)malloc((argc+MAX_BATCH_ARGUMENTS)*sizeof(char *)))
+         ==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "run_batch_manifest()\n",progname);
+      exit(FAILURE);
+   }
+   for (k=0;k<argc;k++) jobargv[k]=argv[k];
+   initialize_mpbuffer(&out,NULL);
+   initialize_backdrop_cache(&cache);
+   initialize_eps_runner(&runner,map.num_jobs);
+   if (map.user_specified_batchoutput) {
+      if ((outfileptr=fopen(map.batchoutfilename,"w"))==NULL) {
+         fprintf(stderr,"Couldn't open file %s for output!\n",
+            map.batchoutfilename);
+         exit(FAILURE);
+      }
+      out.fileptr=outfileptr;
+      strcpy(map.outfilename,map.batchoutfilename);
+      write_header(&out,map,argc,argv);
+   }
+   while (fgets(line,MAX_BATCH_LINELENGTH,manifestptr)!=NULL) {
+      linenum++;
+      if ((strchr(line,'\n')==NULL)&&(!feof(manifestptr))) {
+         fprintf(stderr,"%s: Error: Line %ld of batch manifest %s is longer "
+            "than %d characters.\n",progname,linenum,map.batchfilename,
+            MAX_BATCH_LINELENGTH-2);
+         exit(FAILURE);
+      }
+      if ((jobargc=split_batch_line(line,jobargv+argc,MAX_BATCH_ARGUMENTS))<0) {
+         fprintf(stderr,"%s: Error: More than %d arguments at line %ld of "
+            "batch manifest %s.\n",progname,MAX_BATCH_ARGUMENTS,linenum,
+            map.batchfilename);
+         exit(FAILURE);
+      }
+      if (jobargc==0) continue;
+      t=start_stats_phase(map.stats);
+      jobmap=parse_command_line(argc+jobargc,jobargv);
+      end_stats_phase(map.stats,"parse_command_line",t);
+      jobmap.stats=map.stats;
+      numjobs++;
+      if (jobmap.verbose)
+         fprintf(stdout,"%s: Batch job No %ld, at line %ld of %s\n",
+            progname,numjobs,linenum,map.batchfilename);
+      display_arrow_specs(jobmap);
+      if (map.user_specified_batchoutput) {
+         if (jobmap.output_format!=METAPOST_FORMAT) {
+            fprintf(stderr,"%s: Error: The --batchoutput option requires "
+               "MetaPost code (--format mp), at line %ld of %s.\n",
+               progname,linenum,map.batchfilename);
+            exit(FAILURE);
+         }
+         if (jobmap.sweep_psi||jobmap.sweep_phi||(jobmap.num_views>0)) {
+            fprintf(stderr,"%s: Error: A rotation sweep or --views cannot be "
+               "combined with --batchoutput, at line %ld of %s.\n",
+               progname,linenum,map.batchfilename);
+            exit(FAILURE);
+         }
+         jobmap.figure_number=(int)numjobs;
+         write_figure(&out,jobmap,&cache);
+      } else if (jobmap.sweep_psi||jobmap.sweep_phi) {
+         run_rotation_sweep(jobmap,argc+jobargc,jobargv);
+      } else if (jobmap.num_views>0) {
+         run_rotation_sweep(jobmap,argc+jobargc,jobargv);
+         if (jobmap.generate_eps_output) submit_eps_job(&runner,jobmap);
+      } else {
+         outfileptr=open_outfile(jobmap);
+         reset_mpbuffer(&out);
+         out.format=jobmap.output_format;
+         if (jobmap.output_format==METAPOST_FORMAT) {
+            out.fileptr=outfileptr;
+            t=start_stats_phase(map.stats);
+            write_header(&out,jobmap,argc+jobargc,jobargv);
+            end_stats_phase(map.stats,"write_header",t);
+         }
+         write_figure(&out,jobmap,&cache);
+         t=start_stats_phase(map.stats);
+         if (jobmap.output_format==METAPOST_FORMAT) {
+            write_trailer(&out);
+            flush_mpbuffer(&out);
+            end_stats_phase(map.stats,"write_trailer",t);
+         } else {
+            write_vector_figure(outfileptr,&out,jobmap);
+            end_stats_phase(map.stats,"write_vector_figure",t);
+         }
+         out.fileptr=NULL;
+         if (jobmap.stream_output) {
+            fflush(outfileptr);
+         } else {
+            fclose(outfileptr);
+         }
+         if (jobmap.generate_eps_output) submit_eps_job(&runner,jobmap);
+      }
+      free_matrix(jobmap.arrows,1,8,1,24);
+   }
+   fclose(manifestptr);
+   finish_eps_jobs(&runner);
+   free_eps_runner(&runner);
+   if (map.user_specified_batchoutput) {
+      write_trailer(&out);
+      flush_mpbuffer(&out);
+      fclose(outfileptr);
+   }
+   free_mpbuffer(&out);
+   if (map.stats!=NULL) (*map.stats).byteswritten+=out.numwritten;
+   free_backdrop_cache(&cache);
+   free(jobargv);
+   if (map.verbose)
+      fprintf(stdout,"%s: Batch of %ld jobs done\n",progname,numjobs);
+} /* end of run_batch_manifest() */
+
+/*-----------------------------------------------------------------------------
+| Routines of the |poincarefigure| interface, as described in poincare.h. The
+| trajectories of the caller are copied into the trajectory store of the
+| figure by way of its scratch trajectory |st|, as if scanned from a file,
+| and the figure is then written by the very same routines as for a file,
+| with the store in place of the file. The MetaPost code is handed over to
+| the sink of the caller as it is written, while the SVG document or PDF
+| file is kept in memory until complete, as for the command line.
+-----------------------------------------------------------------------------*/
+poincarefigure *poincare_new_figure(int argc,char *argv[]) {
+   poincarefigure *fig;
+
+   if ((fig=(poincarefigure *)malloc(sizeof(poincarefigure)))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in "
+         "poincare_new_figure()\n",progname);
+      exit(FAILURE);
+   }
+   if (argc>0) {
+      (*fig).map=parse_command_line(argc,argv);
+   } else { /* the defaults of the program */
+      initialize_variables(&((*fig).map));
+      (*fig).map.arrows=matrix(1,8,1,24);
+      update_view_transform(&((*fig).map));
+   }
+   initialize_trajectory_store(&((*fig).ts));
+   initialize_stoke_trajectory(&((*fig).st));
+   return(fig);
+}
+
+void poincare_set_view(poincarefigure *fig,double psi,double phi) {
+   (*fig).map.rot_psi=psi*(PI/180);
+   (*fig).map.rot_phi=phi*(PI/180);
+   update_view_transform(&((*fig).map));
+}
+
+void poincare_free_figure(poincarefigure *fig) {
+   free_trajectory_store(&((*fig).ts));
+   free_stoke_trajectory(&((*fig).st));
+   free_matrix((*fig).map.arrows,1,8,1,24);
+   free(fig);
+}
+
+/*
+ * The check_figure_point() routine terminates with an error message if the
+ * point No |k| (counting from zero), of the tick mark or label |what|, is
+ * outside of a trajectory of |n| points.
+ */
+void check_figure_point(long k,long n,const char *what) {
+   if ((k<0)||(k>=n)) {
+      fprintf(stderr,"%s: Error: The %s at point No %ld is outside the "
+         "trajectory of %ld points.\n",progname,what,k,n);
+      exit(FAILURE);
+   }
+}
+
+void poincare_add_trajectory(poincarefigure *fig,const double *s1,
+      const double *s2,const double *s3,long n,const long *tickmark,
+      long numtickmarks,const poincarelabel *label,long numlabels) {
+   stoketraject *st=&((*fig).st);
+   const char *c;
+   long k;
+
+   (*st).labels=&((*fig).ts.labels); /* labels are kept in the store */
+   reset_stokes_trajectory_struct(st);
+   while ((*st).maxcoords<n) grow_stoke_coordinates(st);
+   for (k=0;k<n;k++) {
+      (*st).s1[k+1]=s1[k];
+      (*st).s2[k+1]=s2[k];
+      (*st).s3[k+1]=s3[k];
+   }
+   (*st).numcoords=n;
+   while ((*st).maxtickmarks<numtickmarks) grow_stoke_tickmarks(st);
+   for (k=0;k<numtickmarks;k++) {
+      check_figure_point(tickmark[k],n,"tick mark");
+      if ((k>0)&&(tickmark[k]<tickmark[k-1])) {
+         fprintf(stderr,"%s: Error: The tick marks of a trajectory must be "
+            "given in increasing order.\n",progname);
+         exit(FAILURE);
+      }
+      (*st).tickmark[k+1]=tickmark[k]+1;
+   }
+   (*st).numtickmarks=numtickmarks;
+   for (k=0;k<numlabels;k++) {
+      check_figure_point(label[k].point,n,"label");
+      if ((label[k].pos<TOPLABEL)||(label[k].pos>UPPERRIGHTLABEL)) {
+         fprintf(stderr,"%s: Error: Invalid position %d of the label at "
+            "point No %ld.\n",progname,label[k].pos,label[k].point);
+         exit(FAILURE);
+      }
+      if ((strlen(label[k].text)>=MAX_LABEL_TEXTLENGTH)
+            ||(strpbrk(label[k].text,"\"\n")!=NULL)) {
+         fprintf(stderr,"%s: Error: The text of the label at point No %ld "
+            "is longer than %d characters, or contains a quote mark or "
+            "newline.\n",progname,label[k].point,MAX_LABEL_TEXTLENGTH-1);
+         exit(FAILURE);
+      }
+      if (label[k].text[0]=='\0') continue; /* empty labels are not drawn */
+      add_label((*st).labels,label[k].point+1,label[k].pos);
+      for (c=label[k].text;*c!='\0';c++) add_label_char((*st).labels,*c);
+      (*st).numlabels++;
+   }
+   count_scanned_trajectory((*fig).map.stats,st);
+   store_scanned_trajectory(&((*fig).ts),st);
+} /* end of poincare_add_trajectory() */
+
+void poincare_render(poincarefigure *fig,poincaresink sink,void *data) {
+   pmap map=(*fig).map;
+   mpbuffer out,doc;
+   densitygrid g;
+   char *args[1];
+   long k;
+
+   map.user_specified_inputfile=1; /* with the store in place of the file */
+   initialize_mpbuffer(&out,NULL);
+   out.format=map.output_format;
+   if (map.output_format==METAPOST_FORMAT) {
+      out.sink=sink;
+      out.sinkdata=data;
+      args[0]=progname;
+      write_header(&out,map,1,args);
+   }
+   write_figure_specs(&out,map);
+   if (map.density_bands>0) { /* --density, of all points of the store */
+      initialize_density_grid(&g,map.density_bands);
+      for (k=1;k<=(*fig).ts.numtrajectories;k++)
+         add_density_trajectory(&g,&((*fig).ts.trajectory[k]));
+      write_binned_density_figure(&out,map,&g);
+      free_density_grid(&g);
+   } else {
+      write_backdrop(&out,map,NULL);
+      write_figure_overlay(&out,map,&((*fig).ts));
+   }
+   if (map.output_format==METAPOST_FORMAT) {
+      write_trailer(&out);
+   } else {
+      write_vector_document(&doc,&out,map);
+      doc.sink=sink;
+      doc.sinkdata=data;
+      free_mpbuffer(&doc);
+   }
+   free_mpbuffer(&out);
+} /* end of poincare_render() */
+
+/*
+ * The poincare_render_to_buffer() routine renders the figure into the buffer
+ * |buf| of |size| characters, truncated if need be, and terminated by a null
+ * character whenever |size| is nonzero, returning the length of the complete
+ * figure, as snprintf() does, with its sink routine copy_to_renderbuffer().
+ */
+typedef struct {
+   char *buf;
+   size_t size,len;
+} renderbuffer;
+
+void copy_to_renderbuffer(const char *text,size_t len,void *data) {
+   renderbuffer *rb=(renderbuffer *)data;
+   size_t n=0;
+   if ((*rb).len+1<(*rb).size) {
+      n=(*rb).size-1-(*rb).len;
+      if (n>len) n=len;
+      memcpy((*rb).buf+(*rb).len,text,n);
+   }
+   (*rb).len+=len;
+}
+
+/*
+ * The poincare_render_to_file() routine renders the figure to the file
+ * |fileptr| of the caller, which is left open, with its sink routine
+ * write_to_renderfile().
+ */
+void write_to_renderfile(const char *text,size_t len,void *data) {
+   if (fwrite(text,1,len,(FILE *)data)!=len) {
+      fprintf(stderr,"%s: Error: Couldn't write the figure to file.\n",
+         progname);
+      exit(FAILURE);
+   }
+}
+
+void poincare_render_to_file(poincarefigure *fig,FILE *fileptr) {
+   poincare_render(fig,write_to_renderfile,fileptr);
+}
+
+size_t poincare_render_to_buffer(poincarefigure *fig,char *buf,size_t size) {
+   renderbuffer rb;
+   rb.buf=buf;
+   rb.size=size;
+   rb.len=0;
+   poincare_render(fig,copy_to_renderbuffer,&rb);
+   if (size>0) buf[(rb.len<size)?rb.len:size-1]='\0';
+   return(rb.len);
+}
@@ -0,0 +1,592 @@
+/*-----------------------------------------------------------------------------
+| File: libpoincare.h [ANSI-C conforming source code]                         |
+| Description:                                                                |
+|       Internal definitions of libpoincare, the library of routines behind   |
+|       the poincare program: the parsing of the options into a map of        |
+|       parameters (pmap), the scanning of trajectory files, the projection   |
+|       of the trajectories onto the sphere, and the writing of the figures   |
+|       as MetaPost code, SVG or PDF. This header is shared by libpoincare.c  |
+|       and the command line front end poincare.c only, while other programs  |
+|       drawing trajectories kept in memory use the poincarefigure interface  |
+|       of poincare.h, which is included below.                               |
+|                                                                             |
+| Copyright (C) 1997-2025, Fredrik Jonsson, under Gnu General Public License  |
+| (GPL) v3. See the enclosed LICENSE for details.                             |
+-----------------------------------------------------------------------------*/
+#ifndef LIBPOINCARE_H
+#define LIBPOINCARE_H
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdarg.h>
+#include "poincare.h"
+
+#define VERSION_NUMBER "1.53"
+
+/*-----------------------------------------------------------------------------
+| PI should have been defined from <math.h>, but let's be on the safe side
+| (since I have found strange behaviour on some SPARC:s).
+-----------------------------------------------------------------------------*/
+#ifndef PI
+#define PI (3.14159265358979323846)
+#endif
+
+/*-----------------------------------------------------------------------------
+| Likewise, NAN should be defined by <math.h>, but I have found that this is
+| not to rely on. The easiest way to let the system generate a NAN for use in
+| the program is simply to define it as 0.0/0.0. (Yes indeed, this simple!)
+-----------------------------------------------------------------------------*/
+#ifndef NAN
+#define NAN (0.0/0.0)
+#endif
+
+/*-----------------------------------------------------------------------------
+| Definitions of the number of coordinates and labels per trajectory, as used
+| in the allocation of memory. These parameters determine the following:
+|    INITIAL_NUM_STOKE_COORDS  Initially allocated coordinates per trajectory
+|    INITIAL_NUM_TICKMARKS     Initially allocated tick marks per trajectory
+|    INITIAL_NUM_SEGMENTS      Initially allocated visibility segments
+|    INITIAL_NUM_LABELS        Initially allocated labels of the label arena
+|    INITIAL_LABEL_TEXTSIZE    Initially allocated characters of label texts
+|    MAX_LABEL_TEXTLENGTH      Maximum number of characters per text label
+| The arrays holding coordinates, tick marks, segments and labels are doubled
+| in size whenever they get full, so the number of points and labels of a
+| trajectory is limited only by the available memory.
+-----------------------------------------------------------------------------*/
+#define INITIAL_NUM_STOKE_COORDS (1024)
+#define INITIAL_NUM_TICKMARKS (64)
+#define INITIAL_NUM_SEGMENTS (16)
+#define INITIAL_NUM_LABELS (64)
+#define INITIAL_LABEL_TEXTSIZE (4096)
+#define MAX_LABEL_TEXTLENGTH (256)
+#define MAX_FILENAME_TEXTLENGTH (256)
+
+/*-----------------------------------------------------------------------------
+| Definitions for the lexer used in scanning trajectory files:
+|    TRAJECTORY_INPUT_BUFSIZE  Number of characters of the input buffer
+|    MAX_NUMBER_TOKENLENGTH    Maximum number of characters of a number
+|    MAX_FAST_NUMBER_DIGITS    Maximum number of significant digits of numbers
+|                              converted without the help of strtod()
+-----------------------------------------------------------------------------*/
+#define TRAJECTORY_INPUT_BUFSIZE (1048576)
+#define MAX_NUMBER_TOKENLENGTH (128)
+#define MAX_FAST_NUMBER_DIGITS (15)
+
+/*-----------------------------------------------------------------------------
+| Magic string and version of the binary trajectory format, as described in
+| connection to the |read_binary_trajectory()| routine.
+-----------------------------------------------------------------------------*/
+#define BINARY_MAGIC "POINCARB"
+#define BINARY_VERSION (1)
+
+/*-----------------------------------------------------------------------------
+| Compressions of trajectory files recognized by their magic bytes, as
+| described in connection to the |detect_compressed_input()| routine, and
+| the programs used for decoding them.
+-----------------------------------------------------------------------------*/
+#define NO_COMPRESSION (0)
+#define GZIP_COMPRESSION (1)
+#define ZSTD_COMPRESSION (2)
+#define GZIP_MAGIC "\037\213"
+#define ZSTD_MAGIC "\050\265\057\375"
+#define GZIP_DECODER "gzip"
+#define ZSTD_DECODER "zstd"
+
+/*-----------------------------------------------------------------------------
+| Definitions for the buffered output of MetaPost code:
+|    MP_BUFFER_SIZE    Number of characters of the output buffer
+|    MP_FIXED_LIMIT    Upper limit of |x*10^prec| for the fixed-point
+|                      formatting of mp_fixed(), beyond which sprintf()
+|                      is used instead
+-----------------------------------------------------------------------------*/
+#define MP_BUFFER_SIZE (1048576)
+#define MP_FIXED_LIMIT (1.0e15)
+#define MAX_NUM_THREADS (1024) /* upper limit of worker threads (--threads) */
+#define MAX_NUM_JOBS (256) /* upper limit of concurrent EPS jobs (--jobs) */
+#define MAX_BATCH_LINELENGTH (4096) /* characters per line of batch manifest */
+#define MAX_BATCH_ARGUMENTS (256)   /* arguments per job of batch manifest */
+#define MAX_NUM_STATS_PHASES (64) /* distinct timed phases of --stats */
+#define MAX_BEZIER_ITERATIONS (4) /* reparameterizations per fit of --fit */
+#define MAX_NUM_VIEWS (64) /* views of one sheet of figures, by --views */
+#define EPS_CACHE_TOOLCHAIN "mpost; tex \\input epsf\\nopagenumbers" \
+   "\\centerline{\\epsfbox{}}\\bye; dvips -D1200 -E" /* see --cache */
+
+/*-----------------------------------------------------------------------------
+| Definitions for the native vector output (--format svg|pdf), in which all
+| lengths are given in PostScript points (bp):
+|    ARROWHEAD_LENGTH     Length of arrow heads, as MetaPost's |ahlength|
+|    METAPOST_AHANGLE     MetaPost's default |ahangle| (degrees)
+|    LABEL_FONTSIZE       Font size of labels, as of MetaPost's cmr10
+|    LABEL_SCRIPTSIZE     Font size of sub- and superscripts of labels
+|    LABEL_OFFSET         Distance of labels, as MetaPost's |labeloffset|
+|    NUM_EQUATOR_POINTS   Number of points along each drawn equator
+|    NUM_ARROW_POINTS     Number of points along each half of an arrow
+|    VECTOR_FIGURE_MARGIN Margin around the bounding box of the figure
+-----------------------------------------------------------------------------*/
+#define METAPOST_FORMAT (0)
+#define SVG_FORMAT (1)
+#define PDF_FORMAT (2)
+#define NO_STATS (0)    /* formats of the statistics of --stats */
+#define TEXT_STATS (1)
+#define JSON_STATS (2)
+#define BP_PER_MM (72.0/25.4)  /* PostScript points per millimetre */
+#define BP_PER_PT (72.0/72.27) /* PostScript points per TeX point */
+#define ARROWHEAD_LENGTH (4.0)
+#define METAPOST_AHANGLE (45.0)
+#define LABEL_FONTSIZE (10.0)
+#define LABEL_SCRIPTSIZE (7.0)
+#define LABEL_OFFSET (3.0)
+#define NUM_EQUATOR_POINTS (33)
+#define NUM_ARROW_POINTS (26)
+#define VECTOR_FIGURE_MARGIN (2.0)
+
+#define SUCCESS 0  /* Return code for successful program termination */
+#define FAILURE 1  /* Return code for unsuccessful program termination */
+
+#define DEFAULT_OUTFILENAME "aout.mp"
+#define DEFAULT_EPSJOBNAME "aout"
+#define DEFAULT_AXISLABEL_S1 "S_1"
+#define DEFAULT_AXISLABEL_S2 "S_2"
+#define DEFAULT_AXISLABEL_S3 "S_3"
+#define DEFAULT_AXISLABELPOSITION_S1 "urgt"
+#define DEFAULT_AXISLABELPOSITION_S2 "urgt"
+#define DEFAULT_AXISLABELPOSITION_S3 "urgt"
+
+#define DEFAULT_ROT_PSI   (-40.0*(PI/180))      /* Angle in radians */
+#define DEFAULT_ROT_PHI   (15.0*(PI/180))       /* Angle in radians */
+
+#define DEFAULT_PHI_SOURCE   (30.0*(PI/180))    /* Angle in radians */
+#define DEFAULT_THETA_SOURCE (30.0*(PI/180))    /* Angle in radians */
+
+#define DEFAULT_MAX_WHITENESS (0.99)  /*  '0.0' <=> black; '1.0' <=> white */
+#define DEFAULT_MIN_WHITENESS (0.75)  /*  '0.0' <=> black; '1.0' <=> white */
+#define DEFAULT_HIDDEN_GRAYTONE (0.65)
+#define DEFAULT_SHADING_LEVELS (64) /* gray levels of precomputed shading */
+
+#define DEFAULT_RHO_DIVISOR  (50.0)
+#define DEFAULT_PHI_DIVISOR  (80.0)
+
+#define DEFAULT_POSITIVE_AXIS_LENGTH (1.5)
+#define DEFAULT_NEGATIVE_AXIS_LENGTH (0.1)
+
+#define DEFAULT_PATH_THICKNESS  (1.0)
+#define DEFAULT_ARROW_THICKNESS (0.6)
+#define DEFAULT_ARROW_HEADANGLE (30.0)
+#define DEFAULT_TICKSIZE (0.056426)  /* in units of the radius */
+
+/* Number of coordinates per line in the generated MetaPost code for the map */
+#define NUM_COORDS_PER_METAPOST_LINE (3)
+
+/* Largest number of knots of each path of the generated MetaPost code, with
+   longer sub-trajectories drawn as several paths, as by add_subtrajectory() */
+#define MAX_METAPOST_PATH_KNOTS (1000)
+
+/* Largest number of latitude bands of the density grid of --density */
+#define MAX_DENSITY_BANDS (1000)
+
+#define MAKE_VERBOSE_REALLY_VERBOSE (1)  /* Avoid TOO much of ASCII */
+
+/* Definition of values taken by flags determining whether hidden or visible
+ * parts of trajectories should be flushed to file.
+ */
+#define HIDDEN (0)
+#define VISIBLE (1)
+
+/*---------------------------------------------------------------------
+| The only global variables allowed in my programs are `optarg`, which is
+| the string of characters that specified the call from the command line,
+| and `progname`, which simply is the string containing the name of the
+| program, as it was invoked from the command line. The latter is defined
+| in libpoincare.c, and is set by parse_command_line().
+---------------------------------------------------------------------*/
+extern char *optarg;
+extern char *progname;
+
+/*-----------------------------------------------------------------------------
+| The |runstats| struct keeps the statistics reported by the --stats option,
+| in the |format| TEXT_STATS or JSON_STATS. The wall time spent in each of
+| the |numphases| distinct phases of the run, as named by |phase|, is summed
+| up in |seconds| over the |calls| of the phase, counted from |starttime|.
+| The remaining fields count the bytes of trajectory input read and of
+| figures written, and the trajectories, points, tick marks and labels
+| scanned, as well as the visibility segments drawn in the hidden and
+| visible layers of the figures.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   short format;
+   int numphases;
+   const char *phase[MAX_NUM_STATS_PHASES];
+   double seconds[MAX_NUM_STATS_PHASES];
+   long calls[MAX_NUM_STATS_PHASES];
+   double starttime;
+   unsigned long bytesread,byteswritten;
+   long numtrajectories,numpoints,numtickmarks,numlabels;
+   long numhiddensegments,numvisiblesegments;
+} runstats;
+
+/*-----------------------------------------------------------------------------
+| The |densitygrid| struct keeps the counts of the density mode (--density),
+| in which the normalized Stokes vectors are binned into a grid of equal-area
+| cells on the sphere, being the |numbands| bands of equal height in s3 (of
+| equal area, by the theorem of Archimedes), each divided into |numsectors|
+| sectors of equal azimuth. The number of points of the cell of band No |i|
+| and sector No |j| is kept in |count[(i-1)*numsectors+j]|, with |maxcount|
+| being the largest of these, and |numpoints| the number of points binned.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   int numbands,numsectors;
+   long *count,maxcount;
+   long numpoints;
+} densitygrid;
+
+typedef struct {
+   double **arrows;
+   int numarrows;
+   short verbose;
+   short save_memory;
+   short use_normalized_stokes_params;
+   short use_bezier_curves;
+   short user_specified_inputfile;
+   short stream_input,stream_output;
+   short input_compression; /* NO_COMPRESSION, GZIP_ or ZSTD_COMPRESSION */
+   short user_specified_binaryfile;
+   short user_specified_batchfile,user_specified_batchoutput;
+   short user_specified_auxfile;
+   short user_specified_cachedir;
+   short user_specified_axislabels;
+   short user_specified_additional_coordinate_system;
+   short user_specified_xtra_axislabel_x;
+   short user_specified_xtra_axislabel_y;
+   short user_specified_xtra_axislabel_z;
+   short draw_hidden_dashed;
+   short draw_paths_as_arrows;
+   short reverse_arrow_paths;
+   short last_point_infront;
+   short current_point_is_a_beginlabelpoint,
+         current_point_is_an_endlabelpoint;
+   short draw_axes_inside_sphere;
+   short currently_drawing_path;
+   short generate_eps_output;
+   short stats_format; /* NO_STATS, TEXT_STATS or JSON_STATS, by --stats */
+   runstats *stats;    /* statistics of the run, or NULL if not requested */
+   int density_bands;  /* latitude bands of the grid of --density, or zero */
+   densitygrid *density; /* grid binning the points scanned, if not NULL */
+   char infilename[MAX_FILENAME_TEXTLENGTH];
+   char outfilename[MAX_FILENAME_TEXTLENGTH];
+   char binfilename[MAX_FILENAME_TEXTLENGTH];
+   char batchfilename[MAX_FILENAME_TEXTLENGTH];
+   char batchoutfilename[MAX_FILENAME_TEXTLENGTH];
+   char auxfilename[MAX_FILENAME_TEXTLENGTH];
+   char epsjobname[MAX_FILENAME_TEXTLENGTH];
+   char cachedirname[MAX_FILENAME_TEXTLENGTH];
+   char axislabel_s1[MAX_LABEL_TEXTLENGTH];
+   char axislabel_s2[MAX_LABEL_TEXTLENGTH];
+   char axislabel_s3[MAX_LABEL_TEXTLENGTH];
+   char axislabelposition_s1[8],
+        axislabelposition_s2[8],
+        axislabelposition_s3[8];
+   char xtra_axislabel_x[MAX_LABEL_TEXTLENGTH];
+   char xtra_axislabel_y[MAX_LABEL_TEXTLENGTH];
+   char xtra_axislabel_z[MAX_LABEL_TEXTLENGTH];
+   double xtra_neg_axis_length_x;
+   double xtra_neg_axis_length_y;
+   double xtra_neg_axis_length_z;
+   double xtra_pos_axis_length_x;
+   double xtra_pos_axis_length_y;
+   double xtra_pos_axis_length_z;
+   char labelstr_beginpoint[MAX_LABEL_TEXTLENGTH];
+   char labelstr_endpoint[MAX_LABEL_TEXTLENGTH];
+   double scalefactor;
+   double rot_psi, rot_phi;
+   double delta_rot_psi, delta_rot_phi;
+   double phi_source, theta_source;
+   double upper_whiteness_value;
+   double lower_whiteness_value;
+   double hiddengraytone;
+   double rho_divisor;
+   double phi_divisor;
+   double xpos_beginpoint;
+   double ypos_beginpoint;
+   double xpos_endpoint;
+   double ypos_endpoint;
+   double neg_axis_length_s1;
+   double neg_axis_length_s2;
+   double neg_axis_length_s3;
+   double pos_axis_length_s1;
+   double pos_axis_length_s2;
+   double pos_axis_length_s3;
+   double paththickness;
+   double arrowthickness;
+   double arrowheadangle;
+   double coordaxisthickness;
+   double ticksize; /* length of tick marks, in units of the radius */
+   double tickevery; /* arc length between the tick marks of --tickevery */
+   double simplify_tolerance;
+   double fit_tolerance; /* tolerance (pt) of the Bezier fit of --fit */
+   short precompute_shading;
+   int shading_levels;
+   short output_format; /* METAPOST_FORMAT, SVG_FORMAT or PDF_FORMAT */
+   int num_threads; /* number of worker threads for mapping trajectories */
+   int num_jobs; /* number of EPS jobs of -e run at the same time, --jobs */
+   int figure_number; /* number of the figure, as in beginfig() */
+   short sweep_psi,sweep_phi; /* rotation sweep, by --sweeppsi, --sweepphi */
+   double sweep_psi_start,sweep_psi_stop,sweep_phi_start,sweep_phi_stop;
+   int num_sweep_frames;
+   int num_views; /* views given by --views, or zero */
+   double views_psi[MAX_NUM_VIEWS+1],views_phi[MAX_NUM_VIEWS+1]; /* 1..n */
+   double watch_interval; /* seconds between polls of --watch, or zero */
+   double view[3][3]; /* view transform, as set by update_view_transform() */
+} pmap;
+
+/*-----------------------------------------------------------------------------
+| The |labelarena| struct keeps the text labels of all trajectories of a run,
+| in the order scanned, as the records |1..numlabels| (of |maxlabels|
+| allocated) of the coordinate index |coord|, the position |pos| (TOPLABEL,
+| ..., UPPERRIGHTLABEL), and the |length| characters of text starting at
+| |text[offset]|. The texts of all labels are kept one after the other in
+| the single buffer |text[0..textlength-1]|, of |textsize| allocated
+| characters, so that the memory of the labels follows their actual number
+| and lengths, and all of it is freed in one step by |free_label_arena()|.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   long numlabels,maxlabels;
+   long *coord,*offset;
+   int *length;
+   short *pos;
+   char *text;
+   long textlength,textsize;
+} labelarena;
+
+/*-----------------------------------------------------------------------------
+| The |stoketraject| struct keeps one Stokes trajectory, with its labels
+| being the records |firstlabel+1..firstlabel+numlabels| of the label arena
+| pointed to by |labels|. The tick marks placed by --tickevery are kept as
+| the points |autotick[1..numautoticks]|, along with the visibility segments
+| of the current view.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   long numcoords;
+   long maxcoords;
+   double *s1,*s2,*s3;
+   double *x,*y;
+   short *visible;
+   int numtickmarks;
+   int maxtickmarks;
+   long *tickmark;
+   labelarena *labels;
+   long firstlabel;
+   long numlabels;
+   long numsegments;
+   long maxsegments;
+   long *segfirst,*seglast; /* runs of points of the same visibility */
+   long *segfrom,*segto;    /* the runs as drawn, overlap included */
+   short *segvisible;
+   long numautoticks;
+   long maxautoticks;
+   long *autotick;
+} stoketraject;
+
+/*-----------------------------------------------------------------------------
+| The |trajectoryinput| struct keeps the state of the lexer used in scanning
+| trajectory files. Characters are scanned directly in the window
+| |buf[pos..len-1]|, which is refilled from the file |fileptr| in blocks of
+| at most |bufsize| characters by |refill_trajectory_input()| as it gets
+| exhausted. The |linenum| field keeps track of the current line number of
+| the input file, as used in error messages and in verbose mode.
+|
+| For regular files on POSIX systems, the whole file is instead memory mapped
+| into |buf|, as indicated by the |mapped| flag, in which case the window
+| covers the entire file from the start and no refilling ever takes place.
+|
+| If the trajectory file is compressed, |fileptr| is the reading end of a
+| pipe from the decoding process |decoderpid|, as started by the
+| |open_decoder_pipe()| routine, and the input is read as a stream.
+|
+| If the input is in the binary trajectory format, as indicated by the
+| |binary| flag, then |binaryindex[1..numbinarytrajectories]| keeps the byte
+| offsets of the trajectories, of which |binarytrajectory| have been read.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   FILE *fileptr;
+   char *buf;
+   size_t pos,len,bufsize;
+   long linenum;
+   short mapped;
+   short binary;
+   long numbinarytrajectories,binarytrajectory,*binaryindex;
+   long decoderpid; /* process decoding compressed input, if nonzero */
+   unsigned long numread; /* characters read from the file, for --stats */
+} trajectoryinput;
+
+/*-----------------------------------------------------------------------------
+| The |mpbuffer| struct keeps the generated MetaPost code in |buf[0..len-1]|,
+| of |bufsize| allocated characters, until handed over to the file |fileptr|.
+| A buffer without file (|fileptr| being NULL) keeps all text in memory.
+| For the native vector output, the |format| of the buffer is SVG_FORMAT or
+| PDF_FORMAT rather than METAPOST_FORMAT, and the bounding box of everything
+| drawn into the buffer is kept in |llx|, |lly|, |urx| and |ury|. The number
+| of characters handed over to file on behalf of the buffer is counted in
+| |numwritten|. Instead of to a file, the text may be handed over to the
+| routine |sink|, called with the text, its length and |sinkdata|, as for
+| the rendering of a |poincarefigure| by poincare_render().
+-----------------------------------------------------------------------------*/
+typedef struct {
+   FILE *fileptr;
+   poincaresink sink;
+   void *sinkdata;
+   char *buf;
+   size_t len,bufsize;
+   short format;
+   double llx,lly,urx,ury;
+   unsigned long numwritten;
+} mpbuffer;
+
+/*-----------------------------------------------------------------------------
+| The |rollingwindow| struct keeps the state of the rolling-window renderer
+| of stream_trajectory_file(), drawing a trajectory while it is scanned. Of
+| the trajectory, only the last three points k-2, k-1 and k are kept, as
+| |s1[1..3]|, ..., with k being |numcoords|, along with whether they carry
+| a tick mark (|tick|) or a tick mark of --tickevery (|autotick|). The path
+| of the current run of points of either layer, as indexed by HIDDEN and
+| VISIBLE, is written to |layer[]| as the points arrive, starting at point
+| |ka[]|, with |n[]| knots in its current chunk and |j[]| points on its
+| current line. The path is |open[]| until its run ends, and |split[]| is
+| set while a split of the path at the last point awaits the next one. The
+| tick marks of either layer are spilled to |ticks[]| and |autoticks[]|, to
+| be appended to the layer after the paths, and labels are given their
+| screen coordinates |labelx[]|, |labely[]| as their points arrive.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   mpbuffer *layer[2];
+   mpbuffer ticks[2],autoticks[2];
+   long numcoords,numtickmarks;
+   double s1[5],s2[5],s3[5],x[5],y[5];
+   short visible[5],tick[5],autotick[5];
+   double arc,nextarc; /* arc length, and that of the next tick mark */
+   long ka[2],first[2],n[2];
+   short j[2],open[2],split[2];
+   short closing; /* the visible path ends, pending the arrow at the last */
+   long numlabels,maxlabels;
+   double *labelx,*labely;
+} rollingwindow;
+
+/*-----------------------------------------------------------------------------
+| The |bezierpath| struct keeps a path to draw as fitted by the --fit option,
+| through the |n| points |x[1..n]|,|y[1..n]|, of which those with |knot[k]|
+| set end a cubic Bezier segment, with the control points |(c1x[k],c1y[k])|
+| and |(c2x[k],c2y[k])|, as set by |fit_bezier_path()|. The arrays are
+| allocated for |maxpoints| points.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   long n,maxpoints;
+   double *x,*y,*c1x,*c1y,*c2x,*c2y;
+   short *fixed,*knot;
+} bezierpath;
+
+/*-----------------------------------------------------------------------------
+| The |trajectorystore| struct keeps all trajectories scanned from the input
+| file in memory, as |trajectory[1..numtrajectories]|, so that the input file
+| only needs to be parsed once, even though the trajectories are written to
+| the MetaPost file in two passes (first all hidden parts, then all visible
+| parts). The |maxtrajectories| field holds the number of allocated elements,
+| and the labels of all trajectories of the store are kept in |labels|.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   long numtrajectories;
+   long maxtrajectories;
+   stoketraject *trajectory;
+   labelarena labels;
+} trajectorystore;
+
+/*-----------------------------------------------------------------------------
+| The |backdropcache| struct keeps the text of the backdrop of the previous
+| figure of the batch mode, that is, of its shaded sphere and equators, as
+| generated with the parameters |map|, if |valid| is set.
+-----------------------------------------------------------------------------*/
+typedef struct {
+   short valid;
+   pmap map;
+   mpbuffer text;
+} backdropcache;
+
+/*-----------------------------------------------------------------------------
+| The |epsjob| struct keeps one job of the EPS toolchain of the -e option,
+| whose stages MPOST_STAGE, TEX_STAGE and DVIPS_STAGE are run one after the
+| other as separate processes in the work directory |workdir| of the job,
+| <name>.tmp for the EPS output <name>.eps. The current |stage| is run by
+| the process |pid|, started at |starttime| (for --stats), with the page of
+| TeX kept in |texpage|. The figure is stored in the EPS cache under |key|,
+| unless this is empty. The |epsrunner| struct keeps the |numjobs| jobs
+| being run at the same time, being at most |maxjobs| (--jobs), with
+| |numfailed| counting the jobs whose toolchain failed, and |mpinputs| and
+| |texinputs| the search paths of MetaPost and TeX through which the stages
+| find files given relative to the directory where the program was started.
+-----------------------------------------------------------------------------*/
+#define MPOST_STAGE (0)
+#define TEX_STAGE (1)
+#define DVIPS_STAGE (2)
+#define NUM_EPS_STAGES (3)
+
+typedef struct {
+   pmap map;
+   int stage;
+   long pid;
+   double starttime;
+   char *texpage;
+   char key[65];
+   char workdir[MAX_FILENAME_TEXTLENGTH+8];
+} epsjob;
+
+typedef struct {
+   int numjobs,maxjobs;
+   epsjob *job;
+   long numfailed;
+   char *mpinputs,*texinputs;
+} epsrunner;
+
+/*-----------------------------------------------------------------------------
+| Routines of libpoincare used by the command line program, poincare.c. All
+| of them report errors on stderr, after which the program is terminated
+| with exit(FAILURE), as with any error on the command line.
+-----------------------------------------------------------------------------*/
+double wall_clock_time(void);
+void initialize_run_stats(runstats *stats,short format,double starttime);
+double start_stats_phase(runstats *stats);
+void end_stats_phase(runstats *stats,const char *name,double t);
+void write_run_stats(runstats *stats);
+void show_banner(void);
+pmap parse_command_line(int argc,char *argv[]);
+void display_arrow_specs(pmap map);
+void initialize_mpbuffer(mpbuffer *out,FILE *fileptr);
+void free_mpbuffer(mpbuffer *out);
+FILE *open_outfile(pmap map);
+void scan_trajectory_file(trajectorystore *ts,pmap map);
+void free_trajectory_store(trajectorystore *ts);
+void write_binary_trajectory_file(pmap map,trajectorystore *ts);
+void write_header(mpbuffer *out,pmap map,int argc,char *argv[]);
+void write_figure(mpbuffer *out,pmap map,backdropcache *cache);
+void write_trailer(mpbuffer *out);
+void write_vector_figure(FILE *fileptr,mpbuffer *body,pmap map);
+void generate_eps_image(pmap map);
+void run_rotation_sweep(pmap map,int argc,char *argv[]);
+void run_watch_mode(pmap map,int argc,char *argv[]);
+void run_batch_manifest(pmap map,int argc,char *argv[]);
+
+/*-----------------------------------------------------------------------------
+| A |poincarefigure| of the interface of poincare.h keeps the |map| of the
+| figure, copied from the options given to poincare_new_figure(), and the
+| trajectories added to it in the store |ts|, by way of the scratch
+| trajectory |st|, as if scanned from a file.
+-----------------------------------------------------------------------------*/
+struct poincarefigure {
+   pmap map;
+   trajectorystore ts;
+   stoketraject st; /* scratch trajectory, as when scanning files */
+};
+
+#endif /* LIBPOINCARE_H */
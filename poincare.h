@@ -0,0 +1,78 @@
+/*-----------------------------------------------------------------------------
+| File: poincare.h [ANSI-C conforming source code]                            |
+| Description:                                                                |
+|       Interface of libpoincare, the library of routines behind the poincare |
+|       program, for programs drawing trajectories of Stokes parameters kept  |
+|       in their own memory, such as simulations of Jones or Mueller          |
+|       matrices, without any trajectory file. The figures are set up and     |
+|       drawn with the poincarefigure routines declared below, while the      |
+|       internals of the library are kept in libpoincare.h.                   |
+|                                                                             |
+| Copyright (C) 1997-2025, Fredrik Jonsson, under Gnu General Public License  |
+| (GPL) v3. See the enclosed LICENSE for details.                             |
+-----------------------------------------------------------------------------*/
+#ifndef POINCARE_H
+#define POINCARE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Definitions of flags used for identifying label positions */
+#define NOLABEL         (0)
+#define TOPLABEL        (1)
+#define UPPERLEFTLABEL  (2)
+#define LEFTLABEL       (3)
+#define LOWERLEFTLABEL  (4)
+#define BOTTOMLABEL     (5)
+#define LOWERRIGHTLABEL (6)
+#define RIGHTLABEL      (7)
+#define UPPERRIGHTLABEL (8)
+
+/*-----------------------------------------------------------------------------
+| The |poincarefigure| interface draws trajectories of Stokes parameters kept
+| in the memory of the calling program, without any trajectory file, text to
+| be parsed, or process to be spawned. The figure is set up by
+| poincare_new_figure() from options given as on the command line, argv[0]
+| being the name of the calling program, for its messages, or with the
+| defaults of the program if |argc| is zero. The view may then be changed by
+| poincare_set_view(), with the angles of --rotatepsi and --rotatephi. The
+| trajectories are added from the arrays s1[0..n-1], s2[0..n-1] and
+| s3[0..n-1] of the caller, copied into the figure, with tick marks at the
+| points tickmark[0..numtickmarks-1] (in increasing order), and the labels
+| label[0..numlabels-1], each at the point |point| (counting from zero) with
+| the position |pos| (TOPLABEL ... UPPERRIGHTLABEL) and the TeX text |text|,
+| as for the labels 'l <pos> "text"' of a trajectory file. The figure is
+| rendered as a whole, in the format of its options (MetaPost code, SVG or
+| PDF), block by block to a sink routine of the caller, to a file opened by
+| the caller, or into a buffer of the caller, as snprintf() does:
+|    char *options[]={"mysim","--normalize","--rotatepsi","-60.0"};
+|    poincarefigure *fig=poincare_new_figure(4,options);
+|    poincare_add_trajectory(fig,s1,s2,s3,n,NULL,0,NULL,0);
+|        . . .
+|    poincare_render(fig,sink,data);
+|    poincare_free_figure(fig);
+| A figure may be rendered any number of times, also in between additions of
+| trajectories. Errors are reported as by the program, with a message on
+| stderr followed by exit().
+-----------------------------------------------------------------------------*/
+typedef void (*poincaresink)(const char *text,size_t len,void *data);
+
+typedef struct {
+   long point;
+   short pos;
+   const char *text;
+} poincarelabel;
+
+typedef struct poincarefigure poincarefigure;
+
+poincarefigure *poincare_new_figure(int argc,char *argv[]);
+void poincare_set_view(poincarefigure *fig,double psi,double phi); /* deg */
+void poincare_add_trajectory(poincarefigure *fig,const double *s1,
+   const double *s2,const double *s3,long n,const long *tickmark,
+   long numtickmarks,const poincarelabel *label,long numlabels);
+void poincare_render(poincarefigure *fig,poincaresink sink,void *data);
+void poincare_render_to_file(poincarefigure *fig,FILE *fileptr);
+size_t poincare_render_to_buffer(poincarefigure *fig,char *buf,size_t size);
+void poincare_free_figure(poincarefigure *fig);
+
+#endif /* POINCARE_H */
@@ -0,0 +1,233 @@
+/*-----------------------------------------------------------------------------
+| File: figure-api.c [ANSI-C conforming source code]                          |
+| Description:                                                                |
+|       Regression test of the poincarefigure interface of libpoincare (see   |
+|       poincare.h and regress/README.md), run by 'make check' next to        |
+|       regress/run-regress.sh. Figures of trajectories generated in memory   |
+|       are rendered through the interface only, into a buffer and to a       |
+|       file, and must be identical to each other and to the golden files     |
+|       regress/golden/figure-api.<ext>, apart from the line of the creation  |
+|       time of the MetaPost header. With --update, the golden files are      |
+|       instead written anew from the current library.                        |
+|                                                                             |
+| Copyright (C) 1997-2025, Fredrik Jonsson, under Gnu General Public License  |
+| (GPL) v3. See the enclosed LICENSE for details.                             |
+|                                                                             |
+| Compile with, from the top directory:                                       |
+|                                                                             |
+|        gcc -O2 -Wall -pedantic -ansi -I. ./regress/figure-api.c \           |
+|           ./libpoincare.a -o ./regress/figure-api -lm -lpthread             |
+-----------------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "poincare.h"
+
+#ifndef PI
+#define PI (3.14159265358979323846)
+#endif
+
+#define SUCCESS 0  /* Return code for successful program termination */
+#define FAILURE 1  /* Return code for unsuccessful program termination */
+
+#define WORKDIR "regress/work"
+#define GOLDENDIR "regress/golden"
+#define NUM_POINTS (200)       /* points per trajectory */
+#define NUM_TICKMARKS (3)
+#define NUM_LABELS (2)
+#define TRUNCATED_SIZE (16)    /* size of the buffer of a truncated render */
+#define TESTNAME "figure-api"  /* the library keeps the global progname */
+
+/*
+ * The read_file() routine returns the contents of the file |filename| in
+ * a newly allocated buffer, with the length in |*len|, or NULL if the file
+ * could not be read.
+ */
+char *read_file(char *filename,size_t *len) {
+   FILE *fileptr;
+   char *buf;
+   long n;
+
+   if ((fileptr=fopen(filename,"rb"))==NULL) return(NULL);
+   if ((fseek(fileptr,0L,SEEK_END)!=0)||((n=ftell(fileptr))<0)
+         ||(fseek(fileptr,0L,SEEK_SET)!=0)
+         ||((buf=(char *)malloc((size_t)n+1))==NULL)) {
+      fclose(fileptr);
+      return(NULL);
+   }
+   *len=fread(buf,1,(size_t)n,fileptr);
+   fclose(fileptr);
+   if (*len!=(size_t)n) {
+      free(buf);
+      return(NULL);
+   }
+   return(buf);
+}
+
+/*
+ * The figure_content() routine removes the line of the creation time of the
+ * MetaPost header from the |len| characters of |text|, in place, and returns
+ * the remaining length, as the sed script content() of run-regress.sh does.
+ */
+size_t figure_content(char *text,size_t len) {
+   const char *key="% Creation time:";
+   size_t i=0,j=0,k;
+
+   while (i<len) {
+      for (k=i;(k<len)&&(text[k]!='\n');k++);
+      if (k<len) k++; /* keep the newline with its line */
+      if ((k-i<strlen(key))||strncmp(text+i,key,strlen(key))) {
+         memmove(text+j,text+i,k-i);
+         j+=k-i;
+      }
+      i=k;
+   }
+   return(j);
+}
+
+/*
+ * The same_content() routine returns 1 if the text |a| of |alen| characters,
+ * without its creation time, is identical to the text |b| of |blen|
+ * characters, and otherwise 0. The text |a| is modified.
+ */
+short same_content(char *a,size_t alen,char *b,size_t blen) {
+   alen=figure_content(a,alen);
+   return((alen==blen)&&(memcmp(a,b,alen)==0));
+}
+
+/*
+ * The add_circle_trajectory() routine adds a trajectory along three quarters
+ * of the great circle through the S1 axis, tilted by |tilt| degrees from the
+ * S1-S2 plane, with tick marks and a label at either end.
+ */
+void add_circle_trajectory(poincarefigure *fig,double tilt,char *begin,
+      char *end) {
+   double s1[NUM_POINTS],s2[NUM_POINTS],s3[NUM_POINTS],t;
+   long tickmark[NUM_TICKMARKS]={50,100,150};
+   poincarelabel label[NUM_LABELS];
+   long k;
+
+   for (k=0;k<NUM_POINTS;k++) {
+      t=1.5*PI*k/(NUM_POINTS-1);
+      s1[k]=cos(t);
+      s2[k]=sin(t)*cos(tilt*(PI/180));
+      s3[k]=sin(t)*sin(tilt*(PI/180));
+   }
+   label[0].point=0;
+   label[0].pos=TOPLABEL;
+   label[0].text=begin;
+   label[1].point=NUM_POINTS-1;
+   label[1].pos=RIGHTLABEL;
+   label[1].text=end;
+   poincare_add_trajectory(fig,s1,s2,s3,NUM_POINTS,tickmark,NUM_TICKMARKS,
+      label,NUM_LABELS);
+}
+
+/*
+ * The check_figure() routine renders a figure with the options |options|,
+ * of which the first |argc| are used, into a buffer and to the file
+ * <WORKDIR>/figure-api.<ext>, and compares the two with each other and with
+ * the golden file <GOLDENDIR>/figure-api.<ext>, or with |update| set writes
+ * the golden file anew, without the creation time. Returns 1 if the figure
+ * is found correct, else 0.
+ */
+short check_figure(int argc,char *options[],char *ext,short update) {
+   char filename[256],goldenname[256],truncated[TRUNCATED_SIZE];
+   char *buf,*filebuf,*goldenbuf;
+   size_t len,filelen,goldenlen;
+   poincarefigure *fig;
+   FILE *fileptr;
+   short ok=1;
+
+   sprintf(filename,"%s/figure-api.%s",WORKDIR,ext);
+   sprintf(goldenname,"%s/figure-api.%s",GOLDENDIR,ext);
+   fig=poincare_new_figure(argc,options);
+   poincare_set_view(fig,-60.0,15.0);
+   add_circle_trajectory(fig,30.0,"$A$","$B$");
+   add_circle_trajectory(fig,-50.0,"$C$","$D$");
+   len=poincare_render_to_buffer(fig,NULL,0);
+   if ((buf=(char *)malloc(len+1))==NULL) {
+      fprintf(stderr,"%s: Error: Allocation failure in check_figure()\n",
+         TESTNAME);
+      exit(FAILURE);
+   }
+   if (poincare_render_to_buffer(fig,buf,len+1)!=len) {
+      fprintf(stdout,"figure-api.%s: FAIL: The length of the figure "
+         "changed between renders.\n",ext);
+      ok=0;
+   }
+   if ((poincare_render_to_buffer(fig,truncated,TRUNCATED_SIZE)!=len)
+         ||(strlen(truncated)!=TRUNCATED_SIZE-1)
+         ||strncmp(truncated,buf,TRUNCATED_SIZE-1)) {
+      fprintf(stdout,"figure-api.%s: FAIL: The figure was not truncated to "
+         "the buffer of %d characters.\n",ext,TRUNCATED_SIZE);
+      ok=0;
+   }
+   len=figure_content(buf,len);
+   if ((fileptr=fopen(filename,"wb"))==NULL) {
+      fprintf(stderr,"%s: Error: Couldn't open %s for writing.\n",
+         TESTNAME,filename);
+      exit(FAILURE);
+   }
+   poincare_render_to_file(fig,fileptr);
+   fclose(fileptr);
+   poincare_free_figure(fig);
+   if ((filebuf=read_file(filename,&filelen))==NULL) {
+      fprintf(stdout,"figure-api.%s: FAIL: Couldn't read %s.\n",ext,
+         filename);
+      ok=0;
+   } else {
+      if (!same_content(filebuf,filelen,buf,len)) {
+         fprintf(stdout,"figure-api.%s: FAIL: The figure rendered to %s "
+            "differs from the one rendered to a buffer.\n",ext,filename);
+         ok=0;
+      }
+      free(filebuf);
+   }
+   if (update) {
+      if (((fileptr=fopen(goldenname,"wb"))==NULL)
+            ||(fwrite(buf,1,len,fileptr)!=len)||(fclose(fileptr)!=0)) {
+         fprintf(stderr,"%s: Error: Couldn't write %s.\n",TESTNAME,
+            goldenname);
+         exit(FAILURE);
+      }
+      fprintf(stdout,"figure-api.%s: updated\n",ext);
+   } else if ((goldenbuf=read_file(goldenname,&goldenlen))==NULL) {
+      fprintf(stdout,"figure-api.%s: FAIL: No golden file %s.\n",ext,
+         goldenname);
+      ok=0;
+   } else {
+      if (!same_content(goldenbuf,goldenlen,buf,len)) {
+         fprintf(stdout,"figure-api.%s: FAIL: The figure differs from %s.\n",
+            ext,goldenname);
+         ok=0;
+      }
+      free(goldenbuf);
+   }
+   if (ok&&!update) fprintf(stdout,"figure-api.%s: ok\n",ext);
+   free(buf);
+   return(ok);
+}
+
+int main(int argc,char *argv[]) {
+   char *options[]={"figureapi","--normalize","--shading","0.75","0.99",
+      "--rhodivisor","10","--phidivisor","16","--paththickness","0.8",
+      "--format","svg"};
+   short update=0,ok=1;
+
+   if ((argc==2)&&!strcmp(argv[1],"--update")) {
+      update=1;
+   } else if (argc!=1) {
+      fprintf(stderr,"Usage: %s [--update]\n",TESTNAME);
+      exit(FAILURE);
+   }
+   if (!check_figure(11,options,"mp",update)) ok=0;
+   if (!check_figure(13,options,"svg",update)) ok=0;
+   if (!ok) {
+      fprintf(stdout,"%s: Regression tests of the interface failed.\n",
+         TESTNAME);
+      exit(FAILURE);
+   }
+   return(SUCCESS);
+}
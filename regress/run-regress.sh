@@ -0,0 +1,211 @@
+#!/bin/sh
+#
+# run-regress.sh: Golden output and performance regression tests of poincare
+#
+# Copyright (C) 1997-2025 under GPLv3, Fredrik Jonsson
+#
+# Usage: sh regress/run-regress.sh [--update]
+#
+# Each case of the corpus below is mapped by ./poincare --stats json, from
+# the top directory, and checked in two ways:
+#
+#    content
+#        The generated MetaPost code must be identical to the golden file
+#        regress/golden/<case>.mp, apart from the line of the creation time
+#        of the header. For the large synthetic cases, only the checksum of
+#        the code (as by cksum) is kept, in regress/golden/<case>.cksum.
+#    performance
+#        The total time of the run, as reported by --stats and taken as the
+#        best of REGRESS_REPEAT runs, must not exceed that of the baseline
+#        regress/baseline by more than the factor REGRESS_TIME_TOLERANCE
+#        plus REGRESS_TIME_SLACK seconds, and its peak memory must not
+#        exceed that of the baseline by more than the factor
+#        REGRESS_MEMORY_TOLERANCE plus REGRESS_MEMORY_SLACK kB.
+#
+# The script exits with a non-zero status if any case fails either check.
+# With --update, the golden files and the baseline are instead written anew
+# from the current program, which should only be done once its output and
+# timings have been found correct, and on the machine where the tests are
+# to be run, as the timings of the baseline are only meaningful there.
+#
+POINCARE=${POINCARE:-./poincare}
+GENTRAJ=${GENTRAJ:-bench/gentraj}
+WORKDIR=regress/work
+GOLDENDIR=regress/golden
+BASELINE=regress/baseline
+REPEAT=${REGRESS_REPEAT:-3}
+TIME_TOLERANCE=${REGRESS_TIME_TOLERANCE:-1.30}
+TIME_SLACK=${REGRESS_TIME_SLACK:-0.05}
+MEMORY_TOLERANCE=${REGRESS_MEMORY_TOLERANCE:-1.10}
+MEMORY_SLACK=${REGRESS_MEMORY_SLACK:-2048}
+
+UPDATE=0
+if [ "$1" = "--update" ]; then
+   UPDATE=1
+elif [ $# -ne 0 ]; then
+   echo "Usage: $0 [--update]" 1>&2
+   exit 1
+fi
+mkdir -p "$WORKDIR" "$GOLDENDIR" || exit 1
+if [ $UPDATE -eq 1 ]; then
+   echo "# case seconds peak_memory_kb" > "$BASELINE.new" || exit 1
+elif [ ! -f "$BASELINE" ]; then
+   echo "$0: No baseline $BASELINE; run 'make check-baseline' first." 1>&2
+   exit 1
+fi
+FAILED=0
+
+# field <name> <file>: value of the number |"name": value| of the stats
+field() {
+   tr -d '\n' < "$2" | sed -n "s/.*\"$1\": \([-+0-9.eE]*\).*/\1/p"
+}
+
+# content <file>: the MetaPost code of <file>, without its creation time
+content() {
+   sed '/^% Creation time:/d' "$1"
+}
+
+# check_content <case> <golden>: compares the code of the case to <golden>
+check_content() {
+   mp="$WORKDIR/$1.mp"
+   case $2 in
+      *.mp)
+         if [ $UPDATE -eq 1 ]; then
+            cp "$mp" "$2"
+            return 0
+         fi
+         content "$mp" > "$WORKDIR/$1.new"
+         content "$2" > "$WORKDIR/$1.old"
+         if ! cmp -s "$WORKDIR/$1.old" "$WORKDIR/$1.new"; then
+            echo "$1: FAIL: MetaPost code differs from $2:"
+            diff "$WORKDIR/$1.old" "$WORKDIR/$1.new" | head -20
+            return 1
+         fi
+         rm -f "$WORKDIR/$1.old" "$WORKDIR/$1.new" ;;
+      *.cksum)
+         if [ $UPDATE -eq 1 ]; then
+            content "$mp" | cksum > "$2"
+         elif [ "`content "$mp" | cksum`" != "`cat "$2"`" ]; then
+            echo "$1: FAIL: MetaPost code differs from the checksum in $2."
+            return 1
+         fi ;;
+   esac
+   return 0
+}
+
+# best <a> <b>: the smaller of the numbers <a> and <b>, or <b> if <a> is empty
+best() {
+   echo "$1 $2" | awk '{print ((NF==1)||($2<$1))?$NF:$1}'
+}
+
+# run_case <case> <golden> <input> [<options> ...]: maps the trajectories of
+# the file <input> by the options, and checks the content and performance;
+# an <input> of the form '|<file>' is instead piped to the standard input
+run_case() {
+   name=$1
+   golden=$GOLDENDIR/$1.$2
+   input=$3
+   shift 3
+   stats="$WORKDIR/$name.json"
+   if [ $UPDATE -eq 0 ] && [ ! -f "$golden" ]; then
+      echo "$name: FAIL: No golden file $golden."
+      FAILED=1
+      return
+   fi
+   best_s=
+   best_kb=
+   r=1
+   while [ $r -le $REPEAT ]; do
+      case $input in
+         \|*) cat "${input#|}" | $POINCARE --stats json --inputfile - \
+                  --outputfile "$WORKDIR/$name.mp" "$@" 2> "$stats" ;;
+         *) $POINCARE --stats json --inputfile "$input" \
+               --outputfile "$WORKDIR/$name.mp" "$@" 2> "$stats" ;;
+      esac
+      if [ $? -ne 0 ]; then
+         echo "$name: FAIL: poincare exited with an error:"
+         cat "$stats"
+         FAILED=1
+         return
+      fi
+      best_s=`best "$best_s" \`field total_seconds "$stats"\``
+      best_kb=`best "$best_kb" \`field peak_memory_kb "$stats"\``
+      r=`expr $r + 1`
+   done
+   check_content "$name" "$golden" || FAILED=1
+   if [ $UPDATE -eq 1 ]; then
+      echo "$name $best_s $best_kb" >> "$BASELINE.new"
+      echo "$name: updated ($best_s s, $best_kb kB)"
+      return
+   fi
+   base=`awk -v name=$name '$1==name {print $2, $3}' "$BASELINE"`
+   if [ -z "$base" ]; then
+      echo "$name: FAIL: No baseline for the case in $BASELINE."
+      FAILED=1
+      return
+   fi
+   echo "$best_s $best_kb $base" | awk -v name=$name \
+      -v tt=$TIME_TOLERANCE -v ts=$TIME_SLACK \
+      -v mt=$MEMORY_TOLERANCE -v ms=$MEMORY_SLACK \
+      '{
+         fail=0;
+         if ($1>$3*tt+ts) fail=1;
+         if (($2!="")&&($4!="")&&($2>$4*mt+ms)) fail=1;
+         printf("%s: %s (%.6f s vs %.6f s, %s kB vs %s kB)\n",
+            name,fail?"FAIL: performance regression":"ok",$1,$3,$2,$4);
+         exit(fail);
+      }' || FAILED=1
+}
+
+#
+# The corpus: the figures of the examples of the Makefile, with the inputs
+# as generated by make example-data, example-c-data-solid,
+# example-c-data-chopped and example-d-data, also with the sphere shaded by
+# --precompute_shading, as a density map by --density, and as streamed by
+# -s, and
+# large synthetic trajectories generated by bench/gentraj, of which a single
+# huge trajectory is piped, so that its memory is bounded as a stream.
+#
+set -- --axislengths 0.3 1.7 0.3 2.4 0.3 1.5 \
+   --axislabels "s_1(t)" bot "s_2(t)" bot "s_3(t)" rt \
+   --rotatephi 15.0 --rotatepsi -60.0 --shading 0.75 0.99 \
+   --rhodivisor 50 --phidivisor 80 --scalefactor 20.0 \
+   --paththickness 0.8 --arrowthickness 0.4
+run_case example mp example.dat --normalize --draw_hidden_dashed "$@"
+run_case example-shaded mp example.dat --normalize --draw_hidden_dashed \
+   "$@" --precompute_shading
+run_case example-density mp example-cc.dat --normalize "$@" --density 24
+run_case example-cs mp example-cs.dat --normalize --bezier "$@" \
+   --arrowheadangle 20.0 --draw_paths_as_arrows
+run_case example-cc mp example-cc.dat --normalize --bezier "$@" \
+   --arrowheadangle 20.0 --draw_paths_as_arrows
+run_case example-cc-stream mp example-cc.dat --save_memory \
+   --normalize --bezier "$@" --arrowheadangle 20.0 --draw_paths_as_arrows
+run_case example-ccr mp example-cc.dat --normalize --bezier "$@" \
+   --arrowheadangle 20.0 --draw_paths_as_arrows --reverse_arrow_paths
+run_case example-cd mp example-cc.dat --normalize --bezier \
+   --draw_hidden_dashed "$@" --arrowheadangle 20.0 --draw_paths_as_arrows
+run_case example-d mp example-d.dat --normalize --bezier "$@" \
+   --arrowheadangle 30.0 --draw_paths_as_arrows \
+   --arrow 1.0 0.7 -0.58 1.0 0.7 0.15 0 0.9 \
+   --arrow 0.28 0.9 0.52 0.3 0.9 1.5 0 0.9
+
+$GENTRAJ --points 100000 --trajectories 10 --crossings 8 \
+   --tickdensity 0.01 --labeldensity 0.001 > "$WORKDIR/synth-1m.dat" || exit 1
+$GENTRAJ --points 2000000 --trajectories 1 --crossings 40 \
+   --tickdensity 0.001 > "$WORKDIR/synth-single.dat" || exit 1
+run_case synth-1m cksum "$WORKDIR/synth-1m.dat" --rotatepsi -40.0 \
+   --rotatephi 15.0 --draw_hidden_dashed
+run_case synth-1m-bezier cksum "$WORKDIR/synth-1m.dat" --rotatepsi -40.0 \
+   --rotatephi 15.0 --bezier --draw_paths_as_arrows --tickevery 0.05
+run_case synth-single-stream cksum "|$WORKDIR/synth-single.dat" \
+   --rotatepsi -40.0 --rotatephi 15.0 --draw_hidden_dashed
+rm -f "$WORKDIR/synth-1m.dat" "$WORKDIR/synth-single.dat" "$WORKDIR"/synth-*.mp
+
+if [ $UPDATE -eq 1 ]; then
+   mv "$BASELINE.new" "$BASELINE"
+elif [ $FAILED -ne 0 ]; then
+   echo "$0: Regression tests failed."
+   exit 1
+fi
+exit 0